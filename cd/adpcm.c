@@ -1,6 +1,10 @@
 #include <stdint.h>
+#include <string.h>
 #include "pcm.h"
 #include "adpcm.h"
+#include "adpcm_iml.h"
+#include "adpcm_sb.h"
+#include "adpcm_dp4.h"
 
 #ifndef likely
 #define likely(x)       __builtin_expect(!!(x),1)
@@ -29,6 +33,11 @@ int16_t adpcm_ima_indices[89*16];
 int32_t adpcm_ima_deltas[89*16];
 
 int32_t adpcm_sb4_steps_indices[16*4]; // deltas interleaved with indices
+int32_t adpcm_sb3_steps_indices[8*4];
+int32_t adpcm_sb3_last_steps_indices[4*4]; // for the 2-bit code in the top bits of a byte
+int32_t adpcm_sb2_steps_indices[4*4];
+
+int32_t adpcm_iml_table[ADPCM_IML_NUM_STEPS*16]; // deltas interleaved with indices
 
 void adcpm_load_bytes_slow_ima(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
 void adpcm_load_bytes_fast_ima(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
@@ -36,6 +45,124 @@ void adpcm_load_bytes_fast_ima(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
 void adcpm_load_bytes_slow_sb4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
 void adpcm_load_bytes_fast_sb4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
 
+void adcpm_load_bytes_slow_iml(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+void adpcm_load_bytes_fast_iml(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+
+void adpcm_load_bytes_fast_sb3(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+void adpcm_load_bytes_fast_sb2(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+
+void adcpm_load_bytes_slow_dp4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+void adpcm_load_bytes_fast_dp4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+
+void adpcm_load_bytes_slow_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+void adpcm_load_bytes_fast_ima_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+void adpcm_load_bytes_fast_sb4_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+void adpcm_load_bytes_fast_iml_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+
+#ifdef ADPCM_VERIFY_DECODERS
+typedef void (*sfx_adpcm_load_t)(sfx_adpcm_t *, uint8_t *, uint32_t);
+
+static void adpcm_load_bytes_fast_sbx(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+void adcpm_load_bytes_slow_sbx(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+static void adpcm_load_bytes_fast_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+
+uint32_t adpcm_verify_errors;
+uint32_t adpcm_verify_samples;
+uint32_t adpcm_verify_ticks;
+
+static int adpcm_state_differs(const sfx_adpcm_t *a, const sfx_adpcm_t *b)
+{
+    return a->data != b->data || a->nibble != b->nibble
+        || a->index != b->index || a->value != b->value
+        || a->index2 != b->index2 || a->value2 != b->value2;
+}
+
+static int adpcm_output_differs(const uint8_t *out, const uint8_t *ref, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        if (out[i << 1] != ref[i << 1]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void adpcm_verify_copy(uint8_t *wptr, const uint8_t *out, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        wptr[i << 1] = out[i << 1];
+    }
+}
+
+// runs the slow decoder over the same input as the fast one, counting chunks that
+// decode differently, the output of the fast decoder ends up at wptr
+static void adpcm_verify(sfx_adpcm_load_t fast, sfx_adpcm_load_t slow, sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+    static uint8_t out[ADPCM_VERIFY_CHUNK*2], ref[ADPCM_VERIFY_CHUNK*2];
+
+    while (wblen > 0) {
+        uint32_t start, len = wblen > ADPCM_VERIFY_CHUNK ? ADPCM_VERIFY_CHUNK : wblen;
+        sfx_adpcm_t state = *adpcm;
+
+        slow(&state, ref, len);
+
+        start = pcm_clock;
+        fast(adpcm, out, len);
+        adpcm_verify_ticks += pcm_clock - start;
+
+        if (adpcm_output_differs(out, ref, len) || adpcm_state_differs(adpcm, &state)) {
+            adpcm_verify_errors++;
+        }
+
+        adpcm_verify_copy(wptr, out, len);
+        adpcm_verify_samples += len;
+        wptr += len << 1;
+        wblen -= len;
+    }
+}
+
+static void adpcm_verify_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t wblen)
+{
+    static uint8_t out[2][ADPCM_VERIFY_CHUNK*2], ref[2][ADPCM_VERIFY_CHUNK*2];
+
+    while (wblen > 0) {
+        uint32_t start, len = wblen > ADPCM_VERIFY_CHUNK ? ADPCM_VERIFY_CHUNK : wblen;
+        sfx_adpcm_t state = *adpcm;
+
+        adpcm_load_bytes_slow_stereo(&state, ref[0], ref[1], len);
+
+        start = pcm_clock;
+        adpcm_load_bytes_fast_stereo(adpcm, out[0], out[1], len);
+        adpcm_verify_ticks += pcm_clock - start;
+
+        if (adpcm_output_differs(out[0], ref[0], len) || adpcm_output_differs(out[1], ref[1], len)
+            || adpcm_state_differs(adpcm, &state)) {
+            adpcm_verify_errors++;
+        }
+
+        adpcm_verify_copy(wptr, out[0], len);
+        adpcm_verify_copy(wptr2, out[1], len);
+        adpcm_verify_samples += len;
+        wptr += len << 1;
+        wptr2 += len << 1;
+        wblen -= len;
+    }
+}
+#endif
+
+#ifndef PCM_HOST
+#define ADPCM_WRITE_IMA_SAMPLE(val,wptr) do { \
+        uint8_t tempub; \
+        __asm volatile("move.w %1,-(%%sp)\n\tmoveq #0,%0\n\tmove.b (%%sp)+,%0\n\tmove.b (%2,%0.w),(%3)" : "=&d"(tempub) : "d"(val), "a"(pcm_u8_to_sm_lut), "a"(wptr)); \
+    } while(0)
+#else
+#define ADPCM_WRITE_IMA_SAMPLE(val,wptr) (*(wptr) = pcm_u8_to_sm_lut[(uint16_t)(val) >> 8])
+#endif
+
 #define ADPCM_READ_IMA_NIBBLE(index,nibble,val,wptr) do { \
         uint8_t input_ = nibble; \
         uint8_t input2 = input_ + input_; \
@@ -49,10 +176,7 @@ void adpcm_load_bytes_fast_sb4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
         if (unlikely(newval > 65535)) newval = 65535; \
         val = newval/* - 32768*/; \
         \
-        uint8_t tempub; \
-        __asm volatile("move.w %1,-(%%sp)\n\tmoveq #0,%0\n\tmove.b (%%sp)+,%0\n\tmove.b (%2,%0.w),(%3)" : "=&d"(tempub) : "d"(val), "a"(pcm_u8_to_sm_lut), "a"(wptr)); \
-        /*tempub = val >> 8;*/ \
-        /**(wptr) = pcm_u8_to_sm_lut[tempub];*/ \
+        ADPCM_WRITE_IMA_SAMPLE(val, wptr); \
     } while(0)
 
 static void adcpm_load_byte_ima(sfx_adpcm_t *adpcm, uint8_t *wptr)
@@ -94,8 +218,10 @@ void adcpm_load_bytes_slow_ima(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen
 
 static void adcpm_load_bytes_ima(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
 {
-#ifdef ADPCM_USE_SLOW_DECODERS
+#if defined(ADPCM_USE_SLOW_DECODERS)
     adcpm_load_bytes_slow_ima(adpcm, wptr, wblen);
+#elif defined(ADPCM_VERIFY_DECODERS)
+    adpcm_verify(adpcm_load_bytes_fast_ima, adcpm_load_bytes_slow_ima, adpcm, wptr, wblen);
 #else
     adpcm_load_bytes_fast_ima(adpcm, wptr, wblen);
 #endif
@@ -181,15 +307,23 @@ check:
     return owblen - wblen;
 }
 
+#ifndef PCM_HOST
+#define ADPCM_CLAMP_SB4_NEGATIVE(s) do { \
+        int16_t tempsw; \
+        __asm volatile("spl %0\n\text.w %0\n\t" : "=&d"(tempsw)); \
+        s &= tempsw; \
+    } while(0)
+#else
+#define ADPCM_CLAMP_SB4_NEGATIVE(s) do { if (s < 0) s = 0; } while(0)
+#endif
+
 #define ADPCM_READ_SB4_NIBBLE(code,value,index,wptr) do { \
         int16_t s; \
         int16_t ind = (uint16_t)(code)*16+index; \
         \
-        int16_t tempsw; \
         int16_t *delta_index = ((int16_t *)((uint8_t *)&adpcm_sb4_steps_indices[0] + ind)); \
         s = (value) + delta_index[0]; \
-        __asm volatile("spl %0\n\text.w %0\n\t" : "=&d"(tempsw)); \
-        s &= tempsw; \
+        ADPCM_CLAMP_SB4_NEGATIVE(s); \
         if (unlikely(s > 255)) s = 255; \
         \
         (value) = s; \
@@ -236,8 +370,10 @@ void adcpm_load_bytes_slow_sb4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen
 
 static void adcpm_load_bytes_sb4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
 {
-#ifdef ADPCM_USE_SLOW_DECODERS
+#if defined(ADPCM_USE_SLOW_DECODERS)
     adcpm_load_bytes_slow_sb4(adpcm, wptr, wblen);
+#elif defined(ADPCM_VERIFY_DECODERS)
+    adpcm_verify(adpcm_load_bytes_fast_sb4, adcpm_load_bytes_slow_sb4, adpcm, wptr, wblen);
 #else
     adpcm_load_bytes_fast_sb4(adpcm, wptr, wblen);
 #endif
@@ -302,17 +438,606 @@ check:
     return owblen - wblen;
 }
 
+#define ADPCM_READ_IML_NIBBLE(code,value,index,wptr) do { \
+        int16_t *delta_index = ((int16_t *)((uint8_t *)&adpcm_iml_table[0] + (index) + ((code) << 2))); \
+        \
+        (value) = (uint8_t)((value) + delta_index[0]); /* wraps around, the encoder keeps it in range */ \
+        index = delta_index[1]; \
+        *(wptr) = pcm_u8_to_sm_lut[(value)]; \
+    } while(0)
+
+static void adcpm_load_byte_iml(sfx_adpcm_t *adpcm, uint8_t *wptr)
+{
+    uint8_t input = *adpcm->data;
+    uint8_t value = adpcm->value;
+    int16_t index = adpcm->index;
+
+    if (adpcm->nibble) {
+        input >>= 4;
+    } else {
+        input &= 15;
+    }
+
+    ADPCM_READ_IML_NIBBLE(input, value, index, wptr);
+
+    adpcm->index = index;
+    adpcm->value = value;
+    adpcm->data += adpcm->nibble;
+    adpcm->nibble ^= 1;
+}
+
+void adcpm_load_bytes_slow_iml(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+    uint8_t value = adpcm->value;
+    int16_t index = adpcm->index;
+
+    wblen >>= 1;
+    do {
+        uint8_t input = *adpcm->data++;
+        ADPCM_READ_IML_NIBBLE(input & 15, value, index, wptr);
+        ADPCM_READ_IML_NIBBLE(input >> 4, value, index, wptr+2);
+        wptr += 4;
+    } while (--wblen);
+
+    adpcm->index = index;
+    adpcm->value = value;
+}
+
+static void adcpm_load_bytes_iml(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+#if defined(ADPCM_USE_SLOW_DECODERS)
+    adcpm_load_bytes_slow_iml(adpcm, wptr, wblen);
+#elif defined(ADPCM_VERIFY_DECODERS)
+    adpcm_verify(adpcm_load_bytes_fast_iml, adcpm_load_bytes_slow_iml, adpcm, wptr, wblen);
+#else
+    adpcm_load_bytes_fast_iml(adpcm, wptr, wblen);
+#endif
+}
+
+static uint16_t adcpm_decode_iml(sfx_adpcm_t *adpcm, uint8_t *wptr, uint16_t wblen)
+{
+    uint32_t len, rem;
+    uint16_t owblen = wblen;
+
+check:
+    if (!wblen) {
+        return owblen - wblen;
+    }
+
+    if (adpcm->data >= adpcm->data_end) {
+        // advance to the next block
+        if (!adcpm_advance_block(adpcm, 0)) {
+            return owblen - wblen;
+        }
+
+        adpcm->value &= 0xFF;
+        if (adpcm->index < 0)  adpcm->index = 0;
+        if (adpcm->index > ADPCM_IML_NUM_STEPS-1) adpcm->index = ADPCM_IML_NUM_STEPS-1;
+        adpcm->index *= 64;
+
+        // output of initial predictor
+        *wptr = pcm_u8_to_sm_lut[(uint8_t)adpcm->value];
+        wptr += 2;
+        wblen--;
+    }
+
+    // output the trailing nibble first, which enables
+    // us to operate on pairs of samples in the main loop
+    if (wblen > 0 && adpcm->nibble) {
+        adcpm_load_byte_iml(adpcm, wptr);
+        wptr += 2;
+        wblen--;
+        goto check;  // we may have just hit the end pointer
+    }
+
+    // the number of bytes we need to read from the stream
+    len = wblen >> 1;
+    rem = wblen & 1; // if 1 - we need to read a nibble at the end
+    if (len >= adpcm->data_end - adpcm->data) {
+        len = adpcm->data_end - adpcm->data;
+        rem = 0;
+    }
+
+    if (len > 0) {
+        len <<= 1;
+        adcpm_load_bytes_iml(adpcm, wptr, len);
+        wptr += (len << 1);
+        wblen -= len;
+    }
+
+    if (rem) {
+        adcpm_load_byte_iml(adpcm, wptr);
+        wptr += 2;
+        wblen--;
+    }
+
+    return owblen - wblen;
+}
+
+#define ADPCM_READ_SBX_CODE(table,code,value,index,wptr) do { \
+        int16_t s; \
+        int16_t *delta_index = ((int16_t *)((uint8_t *)&(table)[0] + (code)*16 + (index))); \
+        \
+        s = (value) + delta_index[0]; \
+        if (unlikely(s < 0)) s = 0; \
+        if (unlikely(s > 255)) s = 255; \
+        \
+        (value) = s; \
+        index = delta_index[1]; \
+        *(wptr) = pcm_u8_to_sm_lut[(uint8_t)s];\
+    } while(0)
+
+// decodes a single sample of a SB3 or SB2 stream,
+// adpcm->nibble is the number of the sample within the byte
+static void adcpm_load_sample_sbx(sfx_adpcm_t *adpcm, uint8_t *wptr)
+{
+    uint8_t input = *adpcm->data;
+    uint8_t pos = adpcm->nibble;
+    int16_t value = adpcm->value;
+    int16_t index = adpcm->index;
+
+    if (adpcm->codec == ADPCM_CODEC_SB2) {
+        ADPCM_READ_SBX_CODE(adpcm_sb2_steps_indices, (input >> (pos << 1)) & 3, value, index, wptr);
+        pos = (pos + 1) & 3;
+    } else if (pos == 2) {
+        ADPCM_READ_SBX_CODE(adpcm_sb3_last_steps_indices, input >> 6, value, index, wptr);
+        pos = 0;
+    } else {
+        ADPCM_READ_SBX_CODE(adpcm_sb3_steps_indices, (input >> (pos * 3)) & 7, value, index, wptr);
+        pos++;
+    }
+
+    adpcm->index = index;
+    adpcm->value = value;
+    adpcm->data += (pos == 0);
+    adpcm->nibble = pos;
+}
+
+void adcpm_load_bytes_slow_sbx(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+    do {
+        adcpm_load_sample_sbx(adpcm, wptr);
+        wptr += 2;
+    } while (--wblen);
+}
+
+#ifndef ADPCM_USE_SLOW_DECODERS
+static void adpcm_load_bytes_fast_sbx(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+    if (adpcm->codec == ADPCM_CODEC_SB2) {
+        adpcm_load_bytes_fast_sb2(adpcm, wptr, wblen);
+    } else {
+        adpcm_load_bytes_fast_sb3(adpcm, wptr, wblen);
+    }
+}
+#endif
+
+static void adcpm_load_bytes_sbx(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+#if defined(ADPCM_USE_SLOW_DECODERS)
+    adcpm_load_bytes_slow_sbx(adpcm, wptr, wblen);
+#elif defined(ADPCM_VERIFY_DECODERS)
+    adpcm_verify(adpcm_load_bytes_fast_sbx, adcpm_load_bytes_slow_sbx, adpcm, wptr, wblen);
+#else
+    adpcm_load_bytes_fast_sbx(adpcm, wptr, wblen);
+#endif
+}
+
+// SB3 and SB2 streams, which pack 3 or 4 samples into a byte
+static uint16_t adcpm_decode_sbx(sfx_adpcm_t *adpcm, uint8_t *wptr, uint16_t wblen)
+{
+    uint32_t len;
+    uint16_t owblen = wblen;
+    uint16_t per_byte = adpcm->codec == ADPCM_CODEC_SB2 ? 4 : 3;
+
+check:
+    if (!wblen) {
+        return owblen - wblen;
+    }
+
+    if (adpcm->data >= adpcm->data_end) {
+        // advance to the next block
+        if (!adcpm_advance_block(adpcm, 0)) {
+            return owblen - wblen;
+        }
+
+        if (adpcm->index < 0)  adpcm->index = 0;
+        if (adpcm->index > ADPCM_SB_MAX_STEP) adpcm->index = ADPCM_SB_MAX_STEP;
+        adpcm->index <<= 2;
+
+        // output of initial predictor
+        *wptr = pcm_u8_to_sm_lut[(uint8_t)adpcm->value];
+        wptr += 2;
+        wblen--;
+    }
+
+    // finish the current byte first, which enables
+    // us to operate on whole bytes in the main loop
+    if (adpcm->nibble || wblen < per_byte) {
+        adcpm_load_sample_sbx(adpcm, wptr);
+        wptr += 2;
+        wblen--;
+        goto check;  // we may have just hit the end pointer
+    }
+
+    // the number of bytes we need to read from the stream
+    len = wblen / per_byte;
+    if (len > adpcm->data_end - adpcm->data) {
+        len = adpcm->data_end - adpcm->data;
+    }
+
+    len *= per_byte;
+    adcpm_load_bytes_sbx(adpcm, wptr, len);
+    wptr += (len << 1);
+    wblen -= len;
+    goto check;
+}
+
+// decodes the next nibble of a DP4 stream, the change after the high nibble
+// alone is the difference between the pair and the low nibble entries
+static void adcpm_load_byte_dp4(sfx_adpcm_t *adpcm, uint8_t *wptr)
+{
+    uint8_t input = *adpcm->data;
+    const uint8_t *table = adpcm->table;
+    uint8_t value = adpcm->value;
+
+    if (adpcm->nibble) {
+        value += table[input + 256] - table[input];
+    } else {
+        value += table[input];
+    }
+    *wptr = pcm_u8_to_sm_lut[value];
+
+    adpcm->value = value;
+    adpcm->data += adpcm->nibble;
+    adpcm->nibble ^= 1;
+}
+
+void adcpm_load_bytes_slow_dp4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+    const uint8_t *table = adpcm->table;
+    uint8_t value = adpcm->value;
+
+    wblen >>= 1;
+    do {
+        uint8_t input = *adpcm->data++;
+        wptr[0] = pcm_u8_to_sm_lut[(uint8_t)(value + table[input])];
+        value += table[input + 256];
+        wptr[2] = pcm_u8_to_sm_lut[value];
+        wptr += 4;
+    } while (--wblen);
+
+    adpcm->value = value;
+}
+
+static void adcpm_load_bytes_dp4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t wblen)
+{
+#if defined(ADPCM_USE_SLOW_DECODERS)
+    adcpm_load_bytes_slow_dp4(adpcm, wptr, wblen);
+#elif defined(ADPCM_VERIFY_DECODERS)
+    adpcm_verify(adpcm_load_bytes_fast_dp4, adcpm_load_bytes_slow_dp4, adpcm, wptr, wblen);
+#else
+    adpcm_load_bytes_fast_dp4(adpcm, wptr, wblen);
+#endif
+}
+
+static uint16_t adcpm_decode_dp4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint16_t wblen)
+{
+    uint32_t len, rem;
+    uint16_t owblen = wblen;
+
+check:
+    if (!wblen) {
+        return owblen - wblen;
+    }
+
+    if (adpcm->data >= adpcm->data_end) {
+        // advance to the next block
+        if (!adcpm_advance_block(adpcm, 0)) {
+            return owblen - wblen;
+        }
+
+        adpcm->value &= 0xFF;
+
+        // output of initial predictor
+        *wptr = pcm_u8_to_sm_lut[(uint8_t)adpcm->value];
+        wptr += 2;
+        wblen--;
+    }
+
+    // output the trailing nibble first, which enables
+    // us to operate on pairs of samples in the main loop
+    if (wblen > 0 && adpcm->nibble) {
+        adcpm_load_byte_dp4(adpcm, wptr);
+        wptr += 2;
+        wblen--;
+        goto check;  // we may have just hit the end pointer
+    }
+
+    // the number of bytes we need to read from the stream
+    len = wblen >> 1;
+    rem = wblen & 1; // if 1 - we need to read a nibble at the end
+    if (len >= adpcm->data_end - adpcm->data) {
+        len = adpcm->data_end - adpcm->data;
+        rem = 0;
+    }
+
+    if (len > 0) {
+        len <<= 1;
+        adcpm_load_bytes_dp4(adpcm, wptr, len);
+        wptr += (len << 1);
+        wblen -= len;
+    }
+
+    if (rem) {
+        adcpm_load_byte_dp4(adpcm, wptr);
+        wptr += 2;
+        wblen--;
+    }
+
+    return owblen - wblen;
+}
+
+static void adpcm_load_stereo_sample(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2)
+{
+    uint8_t offset = adpcm->nibble;
+    uint8_t *data = adpcm->data + (offset >> 1);
+    uint8_t inl = data[0], inr = data[ADPCM_STEREO_GROUP/2];
+    int16_t index;
+
+    if (offset & 1) {
+        inl >>= 4;
+        inr >>= 4;
+    } else {
+        inl &= 15;
+        inr &= 15;
+    }
+
+    if (adpcm->codec == ADPCM_CODEC_SB4) {
+        int16_t value;
+
+        value = adpcm->value;
+        index = adpcm->index;
+        ADPCM_READ_SB4_NIBBLE(inl, value, index, wptr);
+        adpcm->index = index;
+        adpcm->value = value;
+
+        value = adpcm->value2;
+        index = adpcm->index2;
+        ADPCM_READ_SB4_NIBBLE(inr, value, index, wptr2);
+        adpcm->index2 = index;
+        adpcm->value2 = value;
+    } else if (adpcm->codec == ADPCM_CODEC_IML) {
+        uint8_t value;
+
+        value = adpcm->value;
+        index = adpcm->index;
+        ADPCM_READ_IML_NIBBLE(inl, value, index, wptr);
+        adpcm->index = index;
+        adpcm->value = value;
+
+        value = adpcm->value2;
+        index = adpcm->index2;
+        ADPCM_READ_IML_NIBBLE(inr, value, index, wptr2);
+        adpcm->index2 = index;
+        adpcm->value2 = value;
+    } else {
+        int32_t value;
+
+        value = adpcm->value;
+        index = adpcm->index;
+        ADPCM_READ_IMA_NIBBLE(index, inl, value, wptr);
+        adpcm->index = index;
+        adpcm->value = value;
+
+        value = adpcm->value2;
+        index = adpcm->index2;
+        ADPCM_READ_IMA_NIBBLE(index, inr, value, wptr2);
+        adpcm->index2 = index;
+        adpcm->value2 = value;
+    }
+
+    if (++offset == ADPCM_STEREO_GROUP) {
+        offset = 0;
+        adpcm->data += ADPCM_STEREO_GROUP;
+    }
+    adpcm->nibble = offset;
+}
+
+void adpcm_load_bytes_slow_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t wblen)
+{
+    do {
+        adpcm_load_stereo_sample(adpcm, wptr, wptr2);
+        wptr += 2;
+        wptr2 += 2;
+    } while (--wblen);
+}
+
+#ifndef ADPCM_USE_SLOW_DECODERS
+static void adpcm_load_bytes_fast_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t wblen)
+{
+    if (adpcm->codec == ADPCM_CODEC_SB4) {
+        adpcm_load_bytes_fast_sb4_stereo(adpcm, wptr, wptr2, wblen);
+    } else if (adpcm->codec == ADPCM_CODEC_IML) {
+        adpcm_load_bytes_fast_iml_stereo(adpcm, wptr, wptr2, wblen);
+    } else {
+        adpcm_load_bytes_fast_ima_stereo(adpcm, wptr, wptr2, wblen);
+    }
+}
+#endif
+
+static void adpcm_load_bytes_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t wblen)
+{
+#if defined(ADPCM_USE_SLOW_DECODERS)
+    adpcm_load_bytes_slow_stereo(adpcm, wptr, wptr2, wblen);
+#elif defined(ADPCM_VERIFY_DECODERS)
+    adpcm_verify_stereo(adpcm, wptr, wptr2, wblen);
+#else
+    adpcm_load_bytes_fast_stereo(adpcm, wptr, wptr2, wblen);
+#endif
+}
+
+static int16_t adpcm_clamp_index(sfx_adpcm_t *adpcm, int16_t index)
+{
+    if (adpcm->codec == ADPCM_CODEC_SB4) {
+        if (index > 3) index = 3;
+        return index << 2;
+    }
+    if (adpcm->codec == ADPCM_CODEC_IML) {
+        if (index > ADPCM_IML_NUM_STEPS-1) index = ADPCM_IML_NUM_STEPS-1;
+        return index * 64;
+    }
+    if (index > 88) index = 88;
+    return index * 32;
+}
+
+static int adpcm_advance_stereo_block(sfx_adpcm_t *adpcm)
+{
+    // advance to next block
+    uint8_t *block = adpcm->data_end;
+    int block_size = adpcm->block_size;
+    int bias = adpcm->codec == ADPCM_CODEC_IMA ? 32768 : 0;
+
+    if (block_size > adpcm->remaining_bytes)
+        block_size = adpcm->remaining_bytes;
+    if (block_size < 8 + ADPCM_STEREO_GROUP)
+        return 0; // EOF
+
+    adpcm->value = (int16_t)(((int16_t)block[1] << 8) | block[0] << 0) + bias;
+    adpcm->index = adpcm_clamp_index(adpcm, block[2]);
+    adpcm->value2 = (int16_t)(((int16_t)block[5] << 8) | block[4] << 0) + bias;
+    adpcm->index2 = adpcm_clamp_index(adpcm, block[6]);
+    if (adpcm->codec == ADPCM_CODEC_IML) {
+        adpcm->value &= 0xFF;
+        adpcm->value2 &= 0xFF;
+    }
+    adpcm->data = block + 8;
+    adpcm->data_end = block + block_size;
+    adpcm->remaining_bytes -= block_size;
+    adpcm->nibble = 0;
+    return 1;
+}
+
+static uint16_t adpcm_decode_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint16_t wblen)
+{
+    uint32_t len;
+    uint16_t owblen = wblen;
+
+check:
+    if (!wblen) {
+        return owblen - wblen;
+    }
+
+    if (adpcm->data + ADPCM_STEREO_GROUP > adpcm->data_end) {
+        // advance to the next block, a trailing partial group is dropped
+        if (!adpcm_advance_stereo_block(adpcm)) {
+            return owblen - wblen;
+        }
+
+        // output of initial predictors
+        if (adpcm->codec != ADPCM_CODEC_IMA) {
+            *wptr = pcm_u8_to_sm_lut[(uint8_t)adpcm->value];
+            *wptr2 = pcm_u8_to_sm_lut[(uint8_t)adpcm->value2];
+        } else {
+            *wptr = pcm_u8_to_sm_lut[(uint16_t)adpcm->value>>8];
+            *wptr2 = pcm_u8_to_sm_lut[(uint16_t)adpcm->value2>>8];
+        }
+        wptr += 2;
+        wptr2 += 2;
+        wblen--;
+        goto check;
+    }
+
+    // finish the current group first, which enables
+    // us to operate on whole groups in the main loop
+    if (adpcm->nibble || wblen < ADPCM_STEREO_GROUP) {
+        adpcm_load_stereo_sample(adpcm, wptr, wptr2);
+        wptr += 2;
+        wptr2 += 2;
+        wblen--;
+        goto check;
+    }
+
+    // the number of groups we need to read from the stream
+    len = wblen / ADPCM_STEREO_GROUP;
+    if (len > (adpcm->data_end - adpcm->data) / ADPCM_STEREO_GROUP) {
+        len = (adpcm->data_end - adpcm->data) / ADPCM_STEREO_GROUP;
+    }
+
+    len *= ADPCM_STEREO_GROUP;
+    adpcm_load_bytes_stereo(adpcm, wptr, wptr2, len);
+    wptr += (len << 1);
+    wptr2 += (len << 1);
+    wblen -= len;
+    goto check;
+}
+
 sfx_adpcm_dec_t adpcm_decoder(sfx_adpcm_t *adpcm)
 {
     switch (adpcm->codec) {
         case ADPCM_CODEC_SB4:
             return adcpm_decode_sb4;
+        case ADPCM_CODEC_IML:
+            return adcpm_decode_iml;
+        case ADPCM_CODEC_SB3:
+        case ADPCM_CODEC_SB2:
+            return adcpm_decode_sbx;
+        case ADPCM_CODEC_DP4:
+            return adcpm_decode_dp4;
         case ADPCM_CODEC_IMA:
         default:
             return adcpm_decode_ima;
     }
 }
 
+uint32_t adpcm_skip_samples(sfx_adpcm_t *adpcm, uint32_t len)
+{
+    uint32_t skipped = 0;
+    uint16_t block_samples = ADPCM_BLOCK_SAMPLES(adpcm->block_size);
+    sfx_adpcm_dec_t decode = adpcm_decoder(adpcm);
+    static uint8_t scratch[ADPCM_SKIP_CHUNK*2];
+
+    if (adpcm->channels == 2) {
+        block_samples = ADPCM_STEREO_BLOCK_SAMPLES(adpcm->block_size);
+    } else if (adpcm->codec == ADPCM_CODEC_SB3) {
+        block_samples = ADPCM_SB3_BLOCK_SAMPLES(adpcm->block_size);
+    } else if (adpcm->codec == ADPCM_CODEC_SB2) {
+        block_samples = ADPCM_SB2_BLOCK_SAMPLES(adpcm->block_size);
+    }
+
+    // whole blocks carry their own predictor state and can be stepped over:
+    // they're all of the same size, so the target block is found directly
+    if (adpcm->data >= adpcm->data_end && len >= block_samples) {
+        uint32_t blocks = len / block_samples;
+        uint32_t avail = adpcm->remaining_bytes / adpcm->block_size;
+        if (blocks > avail) {
+            blocks = avail;
+        }
+        adpcm->data_end += blocks * adpcm->block_size;
+        adpcm->data = adpcm->data_end;
+        adpcm->remaining_bytes -= blocks * adpcm->block_size;
+        skipped = blocks * block_samples;
+        len -= skipped;
+    }
+
+    // decode the rest into scratch memory to keep the predictor in sync
+    while (len > 0) {
+        uint16_t wr, wblen = len > ADPCM_SKIP_CHUNK ? ADPCM_SKIP_CHUNK : len;
+        if (adpcm->channels == 2) {
+            wr = adpcm_decode_stereo(adpcm, scratch, scratch, wblen);
+        } else {
+            wr = decode(adpcm, scratch, wblen);
+        }
+        if (!wr) {
+            break;
+        }
+        skipped += wr;
+        len -= wr;
+    }
+
+    return skipped;
+}
+
 uint16_t adpcm_load_samples(sfx_adpcm_t *adpcm, uint16_t doff, uint16_t len)
 {
     uint16_t written = 0;
@@ -347,6 +1072,55 @@ uint16_t adpcm_load_samples(sfx_adpcm_t *adpcm, uint16_t doff, uint16_t len)
     return written;
 }
 
+uint16_t adpcm_load_stereo_samples(sfx_adpcm_t *adpcm, uint16_t doff, uint16_t doff2, uint16_t len)
+{
+    uint16_t written = 0;
+    static uint8_t scratch[ADPCM_STEREO_CHUNK*2];
+
+    while (len > 0)
+    {
+        uint16_t wr;
+        uint8_t *wptr = (uint8_t *)&PCM_WAVE;
+        uint8_t *wptr2 = (uint8_t *)&PCM_WAVE;
+        uint16_t woff = doff & 0x0FFF;
+        uint16_t woff2 = doff2 & 0x0FFF;
+        uint16_t wblen = 0x1000 - woff;
+        if (wblen > 0x1000 - woff2)
+            wblen = 0x1000 - woff2;
+        wptr += (woff << 1);
+        wptr2 += (woff2 << 1);
+
+        PCM_CTRL = 0x80 + (doff >> 12); // make sure PCM chip is ON to write wave memory, and set wave bank
+        pcm_delay();
+
+        if ((doff ^ doff2) & 0xF000) {
+            // the right channel is in another bank, decode
+            // it to scratch memory and copy it over later
+            if (wblen > ADPCM_STEREO_CHUNK)
+                wblen = ADPCM_STEREO_CHUNK;
+            wptr2 = scratch;
+        }
+
+        if (wblen > len)
+            wblen = len;
+
+        wr = adpcm_decode_stereo(adpcm, wptr, wptr2, wblen);
+        if (wptr2 == scratch && wr > 0) {
+            pcm_load_samples_interleaved(doff2, scratch, wr);
+        }
+
+        doff += wr;
+        doff2 += wr;
+        len -= wr;
+        written += wr;
+        if (wr < wblen) {
+            break; // EOF
+        }
+    }
+
+    return written;
+}
+
 static void adpcm_init_ima(void)
 {
     int i, j;
@@ -383,32 +1157,46 @@ static void adpcm_init_ima(void)
     }
 }
 
-// As per https://wiki.multimedia.cx/index.php/Creative_8_bits_ADPCM
-static void adpcm_init_sb4(void)
+// the decoders read the delta as the first word of a table entry and the index as the
+// second one, which is the same as the high and low words of a long on the 68000
+static void adpcm_set_delta_index(int32_t *entry, int16_t delta, int16_t index)
+{
+    ((int16_t *)entry)[0] = delta;
+    ((int16_t *)entry)[1] = index;
+}
+
+// fills a table of deltas interleaved with steps, indexed by code*16 + step*4
+static void adpcm_init_sb_table(int32_t *table, int bits, int shift)
 {
     int i, j;
 
-    for (i = 0; i < 16; i++) {
-        for (j = 0; j < 4; j++) {
-            int delta = (i & 0x7) << j;
-            if (i & 0x8) {
-                delta = -delta;
-            }
+    for (i = 0; i < (1 << bits); i++) {
+        for (j = 0; j <= ADPCM_SB_MAX_STEP; j++) {
+            int32_t delta = adpcm_sb_delta(bits, shift, j, i);
+            int newstep = adpcm_sb_next_step(bits, j, i);
+            adpcm_set_delta_index(&table[i*4+j], delta, newstep << 2);
+        }
+    }
+}
 
-            int value = i & 0x7;
-            int newstep = j;
-            if (value >= 5) {
-                newstep++;
-            } else if (value == 0) {
-                newstep--;
-            }
-            if (newstep > 3) {
-                newstep = 3;
-            }
-            if (newstep < 0) {
-                newstep = 0;
-            }
-            adpcm_sb4_steps_indices[i*4+j] = (delta << 16) | (newstep << 2);
+// As per https://wiki.multimedia.cx/index.php/Creative_8_bits_ADPCM
+static void adpcm_init_sb(void)
+{
+    adpcm_init_sb_table(adpcm_sb4_steps_indices, ADPCM_SB4_BITS, ADPCM_SB4_SHIFT);
+    adpcm_init_sb_table(adpcm_sb3_steps_indices, ADPCM_SB3_BITS, ADPCM_SB3_SHIFT);
+    adpcm_init_sb_table(adpcm_sb3_last_steps_indices, ADPCM_SB3_LAST_BITS, ADPCM_SB3_SHIFT);
+    adpcm_init_sb_table(adpcm_sb2_steps_indices, ADPCM_SB2_BITS, ADPCM_SB2_SHIFT);
+}
+
+static void adpcm_init_iml(void)
+{
+    int i, j;
+
+    for (i = 0; i < ADPCM_IML_NUM_STEPS; i++) {
+        for (j = 0; j < 16; j++) {
+            int32_t delta = adpcm_iml_delta(i, j);
+            int newindex = adpcm_iml_next_index(i, j);
+            adpcm_set_delta_index(&adpcm_iml_table[i*16+j], delta, newindex << 6);
         }
     }
 }
@@ -417,5 +1205,107 @@ void adpcm_init(void)
 {
     adpcm_init_ima();
 
-    adpcm_init_sb4();
+    adpcm_init_sb();
+
+    adpcm_init_iml();
+}
+
+#ifdef ADPCM_VERIFY_DECODERS
+void adpcm_verify_reset(void)
+{
+    adpcm_verify_errors = 0;
+    adpcm_verify_samples = 0;
+    adpcm_verify_ticks = 0;
+}
+
+// decodes the whole stream through the checks, the samples are thrown away
+void adpcm_verify_stream(sfx_adpcm_t *adpcm)
+{
+    static uint8_t scratch[2][ADPCM_VERIFY_CHUNK*2];
+    sfx_adpcm_dec_t decode = adpcm_decoder(adpcm);
+    uint16_t wr;
+
+    do {
+        if (adpcm->channels == 2) {
+            wr = adpcm_decode_stereo(adpcm, scratch[0], scratch[1], ADPCM_VERIFY_CHUNK);
+        } else {
+            wr = decode(adpcm, scratch[0], ADPCM_VERIFY_CHUNK);
+        }
+    } while (wr > 0);
+}
+
+static uint32_t adpcm_verify_rand(uint32_t *seed)
+{
+    uint32_t x = *seed;
+
+    // xorshift32
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *seed = x;
+}
+
+// verifies streams of ADPCM_VERIFY_RANDOM_BLOCKS blocks of random codes, the headers
+// carry random step indices, out of range ones included, and predictors an encoder
+// could have written, the same seed always produces the same streams
+void adpcm_verify_random(uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed)
+{
+    static uint8_t stream[ADPCM_DP4_TABLE_SIZE + ADPCM_VERIFY_RANDOM_BLOCKS*ADPCM_VERIFY_RANDOM_BLOCK_SIZE];
+    uint8_t *blocks = stream;
+    sfx_adpcm_t adpcm;
+    int8_t levels[ADPCM_DP4_NUM_LEVELS];
+    uint32_t i;
+    int b, c;
+
+    if (codec == ADPCM_CODEC_NONE || codec >= ADPCM_NUM_CODECS) {
+        return;
+    }
+    if (channels == 2 && codec != ADPCM_CODEC_IMA && codec != ADPCM_CODEC_SB4 && codec != ADPCM_CODEC_IML) {
+        return; // no stereo decoder for the codec
+    }
+    if (seed == 0) {
+        seed = 1; // xorshift never leaves 0
+    }
+
+    memset(&adpcm, 0, sizeof(adpcm));
+    adpcm.codec = codec;
+    adpcm.channels = channels == 2 ? 2 : 1;
+    adpcm.block_size = ADPCM_VERIFY_RANDOM_BLOCK_SIZE;
+
+    if (codec == ADPCM_CODEC_DP4) {
+        blocks += ADPCM_DP4_TABLE_SIZE;
+        adpcm.table = stream;
+    }
+
+    while (streams-- > 0) {
+        for (i = 0; i < ADPCM_VERIFY_RANDOM_BLOCKS*ADPCM_VERIFY_RANDOM_BLOCK_SIZE; i += 4) {
+            uint32_t r = adpcm_verify_rand(&seed);
+            blocks[i] = r;
+            blocks[i+1] = r >> 8;
+            blocks[i+2] = r >> 16;
+            blocks[i+3] = r >> 24;
+        }
+
+        // only IMA has 16-bit predictors
+        if (codec != ADPCM_CODEC_IMA) {
+            for (b = 0; b < ADPCM_VERIFY_RANDOM_BLOCKS; b++) {
+                for (c = 0; c < adpcm.channels; c++) {
+                    blocks[b*ADPCM_VERIFY_RANDOM_BLOCK_SIZE + c*4 + 1] = 0;
+                }
+            }
+        }
+
+        if (codec == ADPCM_CODEC_DP4) {
+            for (b = 0; b < ADPCM_DP4_NUM_LEVELS; b++) {
+                levels[b] = (int8_t)adpcm_verify_rand(&seed);
+            }
+            adpcm_dp4_build_table(levels, stream);
+        }
+
+        adpcm.data = blocks;
+        adpcm.data_end = blocks; // force block read
+        adpcm.remaining_bytes = ADPCM_VERIFY_RANDOM_BLOCKS*ADPCM_VERIFY_RANDOM_BLOCK_SIZE;
+        adpcm_verify_stream(&adpcm);
+    }
 }
+#endif
@@ -9,11 +9,34 @@ extern "C" {
 
 //#define ADPCM_USE_SLOW_DECODERS
 
+#ifdef PCM_HOST
+#define ADPCM_USE_SLOW_DECODERS // the asm decoders only run on the 68000
+#endif
+
+// checks the asm decoders against the C ones, chunk by chunk, as the samples are decoded,
+// counting mismatches in adpcm_verify_errors and the time spent in the asm decoders
+// in adpcm_verify_ticks, in pcm_clock ticks (384 CPU cycles each), over adpcm_verify_samples,
+// the clock only moves on timer interrupts, so the ticks are only meaningful over many chunks
+//
+// also enabled by "make VERIFY=1" in cd/, scd_verify_bufs and scd_verify_random run
+// the checks over the uploaded buffers and random streams and read the counters back,
+// the host build always uses the C decoders, so the checks only run on the 68000
+//#define ADPCM_VERIFY_DECODERS
+
+#define ADPCM_VERIFY_CHUNK 192 // a multiple of the samples per call of every asm decoder
+
+#define ADPCM_VERIFY_RANDOM_BLOCK_SIZE 256
+#define ADPCM_VERIFY_RANDOM_BLOCKS 8
+
 enum
 {
     ADPCM_CODEC_NONE,
     ADPCM_CODEC_IMA,
     ADPCM_CODEC_SB4,
+    ADPCM_CODEC_IML, // IMA-lite, see adpcm_iml.h
+    ADPCM_CODEC_SB3, // 2.6 bits per sample, see adpcm_sb.h
+    ADPCM_CODEC_SB2, // 2 bits per sample
+    ADPCM_CODEC_DP4, // fixed step DPCM, see adpcm_dp4.h
     ADPCM_NUM_CODECS
 };
 
@@ -26,14 +49,44 @@ typedef struct
     uint32_t remaining_bytes;
     uint16_t block_size;
     uint8_t codec;
-    uint8_t nibble;
+    uint8_t nibble; // sample offset within the current group for stereo streams
+    int16_t index2; // right channel state for stereo streams
+    uint16_t value2;
+    const uint8_t *table; // delta pairs for DP4 streams
+    uint8_t channels;
 } sfx_adpcm_t;
 
+// the number of samples in a full block: the initial predictor plus two per byte
+#define ADPCM_BLOCK_SAMPLES(block_size) ((((block_size) - 3) << 1) + 1)
+#define ADPCM_SB3_BLOCK_SAMPLES(block_size) (((block_size) - 3) * 3 + 1)
+#define ADPCM_SB2_BLOCK_SAMPLES(block_size) ((((block_size) - 3) << 2) + 1)
+
+// stereo blocks start with a 4-byte header per channel, followed by groups
+// of 4 bytes of left channel data and 4 bytes of right channel data
+#define ADPCM_STEREO_GROUP 8 // bytes per group and samples per channel in a group
+#define ADPCM_STEREO_BLOCK_SAMPLES(block_size) ((block_size) - 7)
+
+#define ADPCM_SKIP_CHUNK 64
+
+#define ADPCM_STEREO_CHUNK 256
+
 typedef uint16_t (*sfx_adpcm_dec_t)(sfx_adpcm_t *, uint8_t *, uint16_t);
 
 /* from pcm.c */
 extern void adpcm_init(void);
 extern uint16_t adpcm_load_samples(sfx_adpcm_t *adpcm, uint16_t start, uint16_t length);
+extern uint16_t adpcm_load_stereo_samples(sfx_adpcm_t *adpcm, uint16_t start, uint16_t start2, uint16_t length);
+extern uint32_t adpcm_skip_samples(sfx_adpcm_t *adpcm, uint32_t length);
+
+#ifdef ADPCM_VERIFY_DECODERS
+extern uint32_t adpcm_verify_errors;
+extern uint32_t adpcm_verify_samples;
+extern uint32_t adpcm_verify_ticks;
+
+extern void adpcm_verify_reset(void);
+extern void adpcm_verify_stream(sfx_adpcm_t *adpcm);
+extern void adpcm_verify_random(uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed);
+#endif
 
 #ifdef __cplusplus
 }
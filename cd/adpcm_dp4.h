@@ -0,0 +1,33 @@
+#ifndef _ADPCM_DP4_H
+#define _ADPCM_DP4_H
+
+#include <stdint.h>
+
+// DP4 is a fixed step 4-bit DPCM codec, the cheapest of the compressed formats to decode:
+// each code selects one of 16 deltas, which the encoder picks for every sound, so there's
+// no step adaptation at all
+//
+// the deltas are expanded into a table of 512 bytes that precedes the first block in the
+// data chunk: for each input byte, the first 256 entries hold the change of the predictor
+// after the first sample (low nibble) and the next 256 ones the change after both samples,
+// so a byte decodes with two table lookups
+//
+// the predictor is 8 bits wide and wraps around, so the encoder never picks a pair of
+// codes that would take it outside of [0, 255]
+//
+// this header is shared by the decoder and the host encoder, which have to agree on it
+
+#define ADPCM_DP4_NUM_LEVELS 16
+#define ADPCM_DP4_TABLE_SIZE 512
+
+static inline void adpcm_dp4_build_table(const int8_t *levels, uint8_t *table)
+{
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        table[i] = (uint8_t)levels[i & 15];
+        table[i + 256] = (uint8_t)(levels[i & 15] + levels[i >> 4]);
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+    .text
+
+| DP4 decode routines optimized for 68000
+| They take in a datastream encoded to 4-bit entries, and output a stream of sign/magnitude 8-bit samples.
+|
+| There's no step adaptation: each input byte indexes two tables of 256 entries, the first
+| one holds the change of the predictor after the low nibble and the second one the change
+| after both nibbles. The predictor is 8 bits wide and wraps around, so there's no clamping.
+| See adpcm_dp4.h for details.
+
+| Decodes an input byte into two samples
+| d0 and d1 must be clear in their upper bytes
+.macro DP4_BYTE off
+		move.b	(a3)+,d0		| 8
+		move.b	d5,d1			| 4
+		add.b	0(a2,d0.w),d1		| 14	| first sample
+		add.b	0(a5,d0.w),d5		| 14	| second sample
+		move.b	0(a4,d1.w),\off(a1)	| 22
+		move.b	0(a4,d5.w),\off+2(a1)	| 22
+.endm
+
+| void adpcm_load_bytes_fast_dp4(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+|------------------------------------------------------------------------------------
+| This will decode a number of samples from the input stream, to the output stream.
+|
+| The input should be length/2 bytes large.
+|
+.global adpcm_load_bytes_fast_dp4
+adpcm_load_bytes_fast_dp4:
+		movem.l	d4-d6/a2-a5,-(sp)
+
+		move.l  sp@(32),a0  | adpcm state pointer
+		move.l	sp@(36),a1  | write pointer
+		move.l  sp@(40),d4  | length
+
+		lsr.l	#1,d4
+		move.w	d4,d6
+		andi.w	#3,d6		| bytes left over after groups of 4
+		lsr.l	#2,d4
+
+		move.l	0(a0),a3  | read pointer
+		moveq	#0,d5
+		move.w	6(a0),d5  | value
+		move.l	24(a0),a2 | delta table
+		lea	256(a2),a5  | delta pairs table
+
+		lea pcm_u8_to_sm_lut,a4
+
+		moveq   #0,d0
+		moveq   #0,d1
+		bra.s	sampleDP4GroupNext
+
+sampleDP4Group:
+		DP4_BYTE 0
+		DP4_BYTE 4
+		DP4_BYTE 8
+		DP4_BYTE 12
+
+		lea		16(a1),a1		| 8
+
+								| = 42 per sample approx
+sampleDP4GroupNext:
+		dbf	d4, sampleDP4Group	| 10
+
+		bra.s	sampleDP4PairNext
+
+sampleDP4Pair:
+		DP4_BYTE 0
+		addq	#4,a1
+sampleDP4PairNext:
+		dbf	d6, sampleDP4Pair
+
+		move.l	a3,0(a0)
+		move.w	d5,6(a0)
+
+		movem.l	(sp)+,d4-d6/a2-a5
+
+		rts
@@ -128,3 +128,102 @@ clamp1Done:
 		movem.l	(sp)+,d2-d7/a2-a5
 		
 		rts
+
+| Decodes a single sample of a stereo stream
+| \idx, \val: channel state, \code: nibble*2, \out: output location
+.macro IMA_STEREO_SAMPLE idx, val, code, out
+		move.w  \idx,d3			| 4
+		add.w   \code,d3		| 4
+		move.w	(a3,d3.w),\idx	| 14	| update index
+
+		add.w   d3,d3			| 4
+		add.l	(a2,d3.w),\val	| 18
+		btst.l  #16,\val		| 6
+		beq.s	1f				| 10 or 16
+		spl		d3				| 4
+		ext.w	d3				| 4     | d3 is now either 0 or 0xffff
+		move.l  d3,\val			| 4
+1:
+		move.w	\val,-(sp)		| 8
+		move.b	(sp)+,d0		| 8
+		move.b  (a4,d0.w),\out  | 18
+.endm
+
+| Decodes an input byte of a stereo stream into two samples
+.macro IMA_STEREO_BYTE idx, val, out, off1, off2
+		move.b	(a5)+,d1		| 8
+		move.b	d1,d0			| 4
+
+		andi.w	#0x0F,d0		| 8
+		andi.w	#0xF0,d1		| 8
+
+		lsr.b	#3,d1			| 12
+		add.b	d0,d0			| 4
+
+		IMA_STEREO_SAMPLE \idx, \val, d0, \off1(\out)
+		IMA_STEREO_SAMPLE \idx, \val, d1, \off2(\out)
+.endm
+
+| void adpcm_load_bytes_fast_ima_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+|------------------------------------------------------------------------------------
+| This will decode a number of samples from an interleaved stereo stream, writing
+| the left channel to the first output stream and the right one to the second.
+|
+| The input should be length bytes large: groups of 4 bytes of left channel data,
+| followed by 4 bytes of right channel data, the length must be a multiple of 8.
+|
+.global adpcm_load_bytes_fast_ima_stereo
+adpcm_load_bytes_fast_ima_stereo:
+		movem.l	d2-d7/a2-a6,-(sp)
+
+		move.l  sp@(48),a0  | adpcm state pointer
+		move.l	sp@(52),a1  | left channel write pointer
+		move.l	sp@(56),a6  | right channel write pointer
+		move.l  sp@(60),d7  | length
+
+		lsr.l	#3,d7
+		subq.l	#1,d7
+
+		move.l	0(a0),a5  | read pointer
+		moveq	#0,d2
+		move.w	4(a0),d2  | left index
+		moveq   #0,d6
+		move.w	6(a0),d6  | left value
+		moveq	#0,d4
+		move.w	20(a0),d4 | right index
+		moveq   #0,d5
+		move.w	22(a0),d5 | right value
+
+		lea	adpcm_ima_indices,a3
+		lea	adpcm_ima_deltas,a2
+		lea pcm_u8_to_sm_lut,a4
+
+		moveq	#0,d0
+		moveq   #0,d1
+		moveq   #0,d3
+
+sampleStereoGroup:
+		IMA_STEREO_BYTE d2, d6, a1, 0, 2
+		IMA_STEREO_BYTE d2, d6, a1, 4, 6
+		IMA_STEREO_BYTE d2, d6, a1, 8, 10
+		IMA_STEREO_BYTE d2, d6, a1, 12, 14
+
+		IMA_STEREO_BYTE d4, d5, a6, 0, 2
+		IMA_STEREO_BYTE d4, d5, a6, 4, 6
+		IMA_STEREO_BYTE d4, d5, a6, 8, 10
+		IMA_STEREO_BYTE d4, d5, a6, 12, 14
+
+		lea		16(a1),a1		| 8
+		lea		16(a6),a6		| 8
+
+		dbf	d7, sampleStereoGroup	| 12
+
+		move.l	a5,0(a0)
+		move.w	d2,4(a0)
+		move.w	d6,6(a0)
+		move.w	d4,20(a0)
+		move.w	d5,22(a0)
+
+		movem.l	(sp)+,d2-d7/a2-a6
+
+		rts
@@ -0,0 +1,55 @@
+#ifndef _ADPCM_IML_H
+#define _ADPCM_IML_H
+
+#include <stdint.h>
+
+// IMA-lite is a driver specific derivative of IMA ADPCM, cheaper to decode on the 68000:
+// the predictor is 8 bits wide, so the output byte is the predictor itself, and the step
+// table is scaled down to 8-bit samples, so that a single table lookup yields both the
+// delta and the next step index
+//
+// the predictor wraps around instead of being clamped, so the encoder never picks a code
+// that would take it outside of [0, 255]
+//
+// this header is shared by the decoder and the host encoder, which have to agree on it
+
+#define ADPCM_IML_NUM_STEPS 64
+
+// in quarters of an 8-bit sample step, each about 8% larger than the previous one
+static const uint16_t adpcm_iml_steps[ADPCM_IML_NUM_STEPS] = {
+    4, 4, 5, 5, 5, 6, 6, 7,
+    7, 8, 9, 9, 10, 11, 12, 13,
+    14, 15, 16, 18, 19, 21, 22, 24,
+    26, 28, 30, 33, 35, 38, 41, 45,
+    48, 52, 57, 61, 66, 71, 77, 83,
+    90, 97, 105, 114, 123, 133, 144, 156,
+    168, 182, 196, 212, 230, 248, 268, 290,
+    314, 339, 366, 396, 428, 463, 500, 541
+};
+
+// step index adjustment for the magnitude part of a code, same as in IMA ADPCM
+static const int8_t adpcm_iml_index_adjust[8] = {
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// signed change of the predictor for a 4-bit code, bit 3 of the code is the sign
+static inline int adpcm_iml_delta(int index, int code)
+{
+    int delta = (((code & 7) * 2 + 1) * adpcm_iml_steps[index] + 16) >> 5;
+    return (code & 8) ? -delta : delta;
+}
+
+// step index after a 4-bit code
+static inline int adpcm_iml_next_index(int index, int code)
+{
+    index += adpcm_iml_index_adjust[code & 7];
+    if (index < 0) {
+        index = 0;
+    }
+    if (index > ADPCM_IML_NUM_STEPS - 1) {
+        index = ADPCM_IML_NUM_STEPS - 1;
+    }
+    return index;
+}
+
+#endif
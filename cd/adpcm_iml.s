@@ -0,0 +1,140 @@
+    .text
+
+| IMA-lite ADPCM decode routines optimized for 68000
+| They take in a datastream encoded to 4-bit entries, and output a stream of sign/magnitude 8-bit samples.
+|
+| The predictor is 8 bits wide and wraps around, so there's no clamping, and the output
+| byte is the low byte of the predictor register. A single long read from adpcm_iml_table
+| yields both the delta in the upper word and the next step index * 64 in the lower word.
+| See adpcm_iml.h for details.
+
+| Decodes a single sample
+| \idx: delta+index, \val: value, \code: nibble*4, trashed, \out: output location
+.macro IML_SAMPLE idx, val, code, out
+		add.w	\code,\idx		| 4
+		move.l  (a2,\idx\().w),\idx	| 18	| load delta+index
+		move.l  \idx,\code		| 4
+		swap    \code			| 4		| update delta
+		add.b	\code,\val		| 4
+		move.b  (a4,\val\().w),\out	| 18 or 22
+.endm
+
+| Decodes an input byte into two samples, d3 must hold 0x3C
+.macro IML_BYTE idx, val, out, off1, off2
+		move.b	(a3)+,d1		| 8
+		move.w	d1,d0			| 4
+		lsl.b	#2,d0			| 10
+		and.w	d3,d0			| 4		| low nibble*4
+		lsr.b	#2,d1			| 10
+		and.w	d3,d1			| 4		| high nibble*4
+
+		IML_SAMPLE \idx, \val, d0, \off1(\out)
+		IML_SAMPLE \idx, \val, d1, \off2(\out)
+.endm
+
+| void adpcm_load_bytes_fast_iml(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+|------------------------------------------------------------------------------------
+| This will decode a number of samples from the input stream, to the output stream.
+|
+| The input should be length/2 bytes large.
+|
+.global adpcm_load_bytes_fast_iml
+adpcm_load_bytes_fast_iml:
+		movem.l	d2-d5/a2-a4,-(sp)
+
+		move.l  sp@(32),a0  | adpcm state pointer
+		move.l	sp@(36),a1  | write pointer
+		move.l  sp@(40),d4  | length
+
+		lsr.l	#1,d4
+		subq.l	#1,d4
+
+		move.l	0(a0),a3  | read pointer
+		moveq	#0,d2
+		move.w	4(a0),d2  | index
+		moveq	#0,d5
+		move.w	6(a0),d5  | value
+
+		lea	adpcm_iml_table,a2
+		lea pcm_u8_to_sm_lut,a4
+
+		moveq   #0,d1
+		moveq   #0x3C,d3
+sampleIMLPair:
+		IML_BYTE d2, d5, a1, 0, 2	| 40 + 2 * 52
+
+		addq	#4,a1			| 8
+
+								| = 152 approx
+
+		dbf	d4, sampleIMLPair	| 10
+
+		move.l	a3,0(a0)
+		move.w	d2,4(a0)
+		move.w	d5,6(a0)
+
+		movem.l	(sp)+,d2-d5/a2-a4
+
+		rts
+
+| void adpcm_load_bytes_fast_iml_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+|------------------------------------------------------------------------------------
+| This will decode a number of samples from an interleaved stereo stream, writing
+| the left channel to the first output stream and the right one to the second.
+|
+| The input should be length bytes large: groups of 4 bytes of left channel data,
+| followed by 4 bytes of right channel data, the length must be a multiple of 8.
+|
+.global adpcm_load_bytes_fast_iml_stereo
+adpcm_load_bytes_fast_iml_stereo:
+		movem.l	d2-d7/a2-a4/a6,-(sp)
+
+		move.l  sp@(44),a0  | adpcm state pointer
+		move.l	sp@(48),a1  | left channel write pointer
+		move.l	sp@(52),a6  | right channel write pointer
+		move.l  sp@(56),d7  | length
+
+		lsr.l	#3,d7
+		subq.l	#1,d7
+
+		move.l	0(a0),a3  | read pointer
+		moveq	#0,d2
+		move.w	4(a0),d2  | left index
+		moveq	#0,d5
+		move.w	6(a0),d5  | left value
+		moveq	#0,d4
+		move.w	20(a0),d4 | right index
+		moveq	#0,d6
+		move.w	22(a0),d6 | right value
+
+		lea	adpcm_iml_table,a2
+		lea pcm_u8_to_sm_lut,a4
+
+		moveq   #0,d1
+		moveq   #0x3C,d3
+
+sampleIMLStereoGroup:
+		IML_BYTE d2, d5, a1, 0, 2
+		IML_BYTE d2, d5, a1, 4, 6
+		IML_BYTE d2, d5, a1, 8, 10
+		IML_BYTE d2, d5, a1, 12, 14
+
+		IML_BYTE d4, d6, a6, 0, 2
+		IML_BYTE d4, d6, a6, 4, 6
+		IML_BYTE d4, d6, a6, 8, 10
+		IML_BYTE d4, d6, a6, 12, 14
+
+		lea		16(a1),a1		| 8
+		lea		16(a6),a6		| 8
+
+		dbf	d7, sampleIMLStereoGroup	| 12
+
+		move.l	a3,0(a0)
+		move.w	d2,4(a0)
+		move.w	d5,6(a0)
+		move.w	d4,20(a0)
+		move.w	d6,22(a0)
+
+		movem.l	(sp)+,d2-d7/a2-a4/a6
+
+		rts
@@ -0,0 +1,55 @@
+#ifndef _ADPCM_SB_H
+#define _ADPCM_SB_H
+
+#include <stdint.h>
+
+// Creative style ADPCM, as per https://wiki.multimedia.cx/index.php/Creative_8_bits_ADPCM
+//
+// the predictor is an unsigned 8-bit value, each code has a sign bit and a magnitude,
+// which is shifted left by the step, the step is in [0, 3] and goes up for large
+// magnitudes and down for zero ones
+//
+// SB4 stores 2 samples per byte as 4-bit codes, SB3 (2.6 bits per sample) stores 3 samples
+// per byte as two 3-bit codes and a 2-bit code, SB2 stores 4 samples per byte as 2-bit codes,
+// the first sample is always in the lowest bits of the byte
+//
+// this header is shared by the decoder and the host encoder, which have to agree on it
+
+#define ADPCM_SB_MAX_STEP 3
+
+// code size in bits and the extra left shift of the magnitude for each kind of code
+#define ADPCM_SB4_BITS 4
+#define ADPCM_SB4_SHIFT 0
+#define ADPCM_SB3_BITS 3
+#define ADPCM_SB3_LAST_BITS 2
+#define ADPCM_SB3_SHIFT 1
+#define ADPCM_SB2_BITS 2
+#define ADPCM_SB2_SHIFT 2
+
+// signed change of the predictor for a code
+static inline int adpcm_sb_delta(int bits, int shift, int step, int code)
+{
+    int delta = (code & ((1 << (bits - 1)) - 1)) << (step + shift);
+    return (code & (1 << (bits - 1))) ? -delta : delta;
+}
+
+// step after a code
+static inline int adpcm_sb_next_step(int bits, int step, int code)
+{
+    int value = code & ((1 << (bits - 1)) - 1);
+
+    if (value >= 2 * bits - 3) {
+        step++;
+    } else if (value == 0) {
+        step--;
+    }
+    if (step > ADPCM_SB_MAX_STEP) {
+        step = ADPCM_SB_MAX_STEP;
+    }
+    if (step < 0) {
+        step = 0;
+    }
+    return step;
+}
+
+#endif
@@ -0,0 +1,88 @@
+    .text
+
+| SB2 ADPCM decode routine optimized for 68000
+| It takes in a mono datastream encoded to 2-bit entries, 4 samples per byte, and
+| outputs a stream of sign/magnitude 8-bit samples. See adpcm_sb.h for details.
+
+| Decodes a single sample
+| \code: code*16, \out: output location
+.macro SB2_SAMPLE code, out
+		add.b	\code,d2		| 4
+
+		move.l  (a2,d2.w),d2    | 18	| load delta+index
+		move.l  d2,d3           | 4
+		swap    d3              | 4		| update delta
+
+		add.w	d3,d5			| 4
+		spl		d3				| 4
+		ext.w	d3				| 4
+		and.w	d3,d5			| 4		| d5 == 0 if d5 < 0
+		cmp.w	d4,d5			| 4		| d4 == 255
+		bls.s	1f				| 8 or 12
+		move.w	d4,d5
+1:
+		move.b  (a4,d5.w),\out	| 18 or 22
+.endm
+
+| void adpcm_load_bytes_fast_sb2(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+|------------------------------------------------------------------------------------
+| This will decode a number of samples from the input stream, to the output stream.
+|
+| The input should be length/4 bytes large, the length must be a multiple of 4.
+|
+.global adpcm_load_bytes_fast_sb2
+adpcm_load_bytes_fast_sb2:
+		movem.l	d2-d7/a2-a4,-(sp)
+
+		move.l  sp@(40),a0  | adpcm state pointer
+		move.l	sp@(44),a1  | write pointer
+		move.l  sp@(48),d6  | length
+
+		lsr.l	#2,d6
+		subq.l	#1,d6
+
+		move.l	0(a0),a3  | read pointer
+		moveq	#0,d2
+		move.w	4(a0),d2  | index
+		moveq	#0,d5
+		move.w	6(a0),d5  | value
+
+		lea	adpcm_sb2_steps_indices,a2
+		lea pcm_u8_to_sm_lut,a4
+
+		moveq   #0,d1
+		move.l  #255,d4
+		moveq	#0x30,d7
+sampleSB2Byte:
+		move.b	(a3)+,d1		| 8
+		move.w	d1,d0			| 4
+		lsl.b	#4,d0			| 14
+		and.w	d7,d0			| 4		| bits 0-1
+		SB2_SAMPLE d0, 0(a1)
+
+		move.w	d1,d0			| 4
+		lsl.b	#2,d0			| 10
+		and.w	d7,d0			| 4		| bits 2-3
+		SB2_SAMPLE d0, 2(a1)
+
+		move.w	d1,d0			| 4
+		and.w	d7,d0			| 4		| bits 4-5
+		SB2_SAMPLE d0, 4(a1)
+
+		lsr.b	#2,d1			| 10
+		and.w	d7,d1			| 4		| bits 6-7
+		SB2_SAMPLE d1, 6(a1)
+
+		addq	#8,a1			| 8
+
+								| = 320 approx
+
+		dbf	d6, sampleSB2Byte	| 10
+
+		move.l	a3,0(a0)
+		move.w	d2,4(a0)
+		move.w	d5,6(a0)
+
+		movem.l	(sp)+,d2-d7/a2-a4
+
+		rts
@@ -0,0 +1,86 @@
+    .text
+
+| SB3 (2.6 bits per sample) ADPCM decode routine optimized for 68000
+| It takes in a mono datastream encoded to 3 samples per byte: two 3-bit codes in
+| the low bits and a 2-bit code in the top bits, and outputs a stream of sign/magnitude
+| 8-bit samples. See adpcm_sb.h for details.
+
+| Decodes a single sample
+| \table: deltas and steps, \code: code*16, \out: output location
+.macro SB3_SAMPLE table, code, out
+		add.b	\code,d2		| 4
+
+		move.l  (\table,d2.w),d2	| 18	| load delta+index
+		move.l  d2,d3           | 4
+		swap    d3              | 4		| update delta
+
+		add.w	d3,d5			| 4
+		spl		d3				| 4
+		ext.w	d3				| 4
+		and.w	d3,d5			| 4		| d5 == 0 if d5 < 0
+		cmp.w	d4,d5			| 4		| d4 == 255
+		bls.s	1f				| 8 or 12
+		move.w	d4,d5
+1:
+		move.b  (a4,d5.w),\out	| 18 or 22
+.endm
+
+| void adpcm_load_bytes_fast_sb3(sfx_adpcm_t *adpcm, uint8_t *wptr, uint32_t len);
+|------------------------------------------------------------------------------------
+| This will decode a number of samples from the input stream, to the output stream.
+|
+| The input should be length/3 bytes large, the length must be a multiple of 3.
+|
+.global adpcm_load_bytes_fast_sb3
+adpcm_load_bytes_fast_sb3:
+		movem.l	d2-d7/a2-a5,-(sp)
+
+		move.l  sp@(44),a0  | adpcm state pointer
+		move.l	sp@(48),a1  | write pointer
+		move.l  sp@(52),d6  | length
+
+		divu.w	#3,d6
+		subq.w	#1,d6
+
+		move.l	0(a0),a3  | read pointer
+		moveq	#0,d2
+		move.w	4(a0),d2  | index
+		moveq	#0,d5
+		move.w	6(a0),d5  | value
+
+		lea	adpcm_sb3_steps_indices,a2
+		lea	adpcm_sb3_last_steps_indices,a5
+		lea pcm_u8_to_sm_lut,a4
+
+		moveq   #0,d1
+		move.l  #255,d4
+		moveq	#0x70,d7
+sampleSB3Byte:
+		move.b	(a3)+,d1		| 8
+		move.w	d1,d0			| 4
+		lsl.b	#4,d0			| 14
+		and.w	d7,d0			| 4		| bits 0-2
+		SB3_SAMPLE a2, d0, 0(a1)
+
+		move.w	d1,d0			| 4
+		add.b	d0,d0			| 4
+		and.w	d7,d0			| 4		| bits 3-5
+		SB3_SAMPLE a2, d0, 2(a1)
+
+		lsr.b	#2,d1			| 10
+		andi.w	#0x30,d1		| 8		| bits 6-7
+		SB3_SAMPLE a5, d1, 4(a1)
+
+		addq	#6,a1			| 8
+
+								| = 240 approx
+
+		dbf	d6, sampleSB3Byte	| 10
+
+		move.l	a3,0(a0)
+		move.w	d2,4(a0)
+		move.w	d5,6(a0)
+
+		movem.l	(sp)+,d2-d7/a2-a5
+
+		rts
@@ -117,3 +117,98 @@ clampSB41Done:
 		movem.l	(sp)+,d2-d6/a2-a4
 		
 		rts
+
+| Decodes a single sample of a stereo stream
+| \idx: channel delta+index, \val: channel value, \code: nibble*16, \out: output location
+.macro SB4_STEREO_SAMPLE idx, val, code, out
+		add.b	\code,\idx		| 4
+
+		move.l  (a2,\idx\().w),\idx	| 18	| load delta+index
+		move.l  \idx,d3			| 4
+		swap    d3				| 4		| update delta
+
+		add.w	d3,\val			| 4
+		spl		d3				| 4
+		ext.w	d3				| 4
+		and.w	d3,\val			| 4		| \val == 0 if \val < 0
+		cmpi.w	#255,\val		| 8
+		bls.s	1f				| 8 or 12
+		move.w	#255,\val
+1:
+		move.b  (a4,\val\().w),\out	| 22
+.endm
+
+| Decodes an input byte of a stereo stream into two samples
+.macro SB4_STEREO_BYTE idx, val, out, off1, off2
+		move.b	(a3)+,d1		| 8
+		move.w	d1,d0			| 4
+
+		andi.b	#0x0F,d0		| 8
+		andi.b  #0xF0,d1		| 8
+
+		lsl.b   #4,d0			| 14
+
+		SB4_STEREO_SAMPLE \idx, \val, d0, \off1(\out)
+		SB4_STEREO_SAMPLE \idx, \val, d1, \off2(\out)
+.endm
+
+| void adpcm_load_bytes_fast_sb4_stereo(sfx_adpcm_t *adpcm, uint8_t *wptr, uint8_t *wptr2, uint32_t len);
+|------------------------------------------------------------------------------------
+| This will decode a number of samples from an interleaved stereo stream, writing
+| the left channel to the first output stream and the right one to the second.
+|
+| The input should be length bytes large: groups of 4 bytes of left channel data,
+| followed by 4 bytes of right channel data, the length must be a multiple of 8.
+|
+.global adpcm_load_bytes_fast_sb4_stereo
+adpcm_load_bytes_fast_sb4_stereo:
+		movem.l	d2-d7/a2-a4/a6,-(sp)
+
+		move.l  sp@(44),a0  | adpcm state pointer
+		move.l	sp@(48),a1  | left channel write pointer
+		move.l	sp@(52),a6  | right channel write pointer
+		move.l  sp@(56),d7  | length
+
+		lsr.l	#3,d7
+		subq.l	#1,d7
+
+		move.l	0(a0),a3  | read pointer
+		moveq	#0,d2
+		move.w	4(a0),d2  | left index
+		moveq	#0,d5
+		move.w	6(a0),d5  | left value
+		moveq	#0,d4
+		move.w	20(a0),d4 | right index
+		moveq	#0,d6
+		move.w	22(a0),d6 | right value
+
+		lea	adpcm_sb4_steps_indices,a2
+		lea pcm_u8_to_sm_lut,a4
+
+		moveq   #0,d1
+
+sampleSB4StereoGroup:
+		SB4_STEREO_BYTE d2, d5, a1, 0, 2
+		SB4_STEREO_BYTE d2, d5, a1, 4, 6
+		SB4_STEREO_BYTE d2, d5, a1, 8, 10
+		SB4_STEREO_BYTE d2, d5, a1, 12, 14
+
+		SB4_STEREO_BYTE d4, d6, a6, 0, 2
+		SB4_STEREO_BYTE d4, d6, a6, 4, 6
+		SB4_STEREO_BYTE d4, d6, a6, 8, 10
+		SB4_STEREO_BYTE d4, d6, a6, 12, 14
+
+		lea		16(a1),a1		| 8
+		lea		16(a6),a6		| 8
+
+		dbf	d7, sampleSB4StereoGroup	| 12
+
+		move.l	a3,0(a0)
+		move.w	d2,4(a0)
+		move.w	d5,6(a0)
+		move.w	d4,20(a0)
+		move.w	d6,22(a0)
+
+		movem.l	(sp)+,d2-d7/a2-a4/a6
+
+		rts
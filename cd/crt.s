@@ -1,6 +1,26 @@
 
         .text
 
+| trace event types, same as in s_trace.h
+        .equ    TRACE_CMD, 1
+        .equ    TRACE_ACK, 2
+
+| records a trace event when built with TRACE=1, see s_trace.h, clobbers d1/a0
+.macro TRACE_EVENT type, id
+.ifdef S_TRACE
+        moveq   #0,d1
+        move.b  s_trace_head,d1
+        addq.b  #1,s_trace_head
+        lsl.w   #3,d1
+        lea     s_trace_ring,a0
+        adda.w  d1,a0
+        move.l  pcm_clock,(a0)+
+        move.b  #\type,(a0)+
+        move.b  \id,(a0)+
+        clr.w   (a0)
+.endif
+.endm
+
 | Standard MegaCD Sub-CPU Program Header (copied to 0x6000)
 
 SPHeader:
@@ -29,6 +49,121 @@ SPInit:
 | Sub-CPU Program Main Entry Point (VBlank now enabled)
 
 SPMain:
+| the drive is initialized from the command loop, a BIOS call at a time, so the
+| driver takes commands and uploads while the drive spins up
+        move.b  #1,drive_init_step
+        move.b  #0,0x800F.w             /* sub comm port = READY */
+
+| wait for command in main comm port
+WaitCmd:
+        tst.b   drive_init_step
+        beq.b   1f
+        bsr.w   DriveInitStep
+1:
+        tst.b   updates_suspend
+        bne     WaitCmdPostUpdate
+
+        jsr     S_Update
+        
+WaitCmdPostUpdate:
+        moveq   #0,d0
+        move.b  0x800E.w,d0
+        beq.b   WaitCmd
+        TRACE_EVENT TRACE_CMD,d0
+| commands are ASCII characters in the 0x40-0x7F range, looked up in CmdTable,
+| the unknown ones are answered with an error
+        subi.b  #0x40,d0
+        cmpi.b  #0x40,d0
+        bcc.w   BadCmd
+        add.w   d0,d0
+        move.w  CmdTable(pc,d0.w),d0
+        jmp     CmdTable(pc,d0.w)
+
+CmdTable:
+        .word   BadCmd-CmdTable                     /* 0x40 */
+        .word   SfxPlaySource-CmdTable              /* 'A' */
+        .word   SfxCopyBuffer-CmdTable              /* 'B' */
+        .word   CheckDisc-CmdTable                  /* 'C' */
+        .word   GetDiscInfo-CmdTable                /* 'D' */
+        .word   SfxSuspendUpdates-CmdTable          /* 'E' */
+        .word   SfxAutomateSource-CmdTable          /* 'F' */
+        .word   SfxGetSourcePosition-CmdTable       /* 'G' */
+        .word   SfxGetSourceSamplePosition-CmdTable /* 'H' */
+        .word   SfxInit-CmdTable                    /* 'I' */
+        .word   SfxCopyKosBuffer-CmdTable           /* 'J' */
+        .word   SfxSeekSource-CmdTable              /* 'K' */
+        .word   SfxClear-CmdTable                   /* 'L' */
+        .word   SfxGetLoadStats-CmdTable            /* 'M' */
+        .word   SfxPUnPSource-CmdTable              /* 'N' */
+        .word   SfxStopSource-CmdTable              /* 'O' */
+        .word   PlayTrack-CmdTable                  /* 'P' */
+        .word   SfxGetVersion-CmdTable              /* 'Q' */
+        .word   SfxPlayModule-CmdTable              /* 'R' */
+        .word   StopPlaying-CmdTable                /* 'S' */
+        .word   GetTrackInfo-CmdTable               /* 'T' */
+        .word   SfxUpdateSource-CmdTable            /* 'U' */
+        .word   SetVolume-CmdTable                  /* 'V' */
+        .word   SfxRewindSource-CmdTable            /* 'W' */
+        .word   SfxSetBuses-CmdTable                /* 'X' */
+        .word   BadCmd-CmdTable                     /* 'Y' */
+        .word   PauseResume-CmdTable                /* 'Z' */
+        .word   BadCmd-CmdTable                     /* 0x5B */
+        .word   BadCmd-CmdTable                     /* 0x5C */
+        .word   BadCmd-CmdTable                     /* 0x5D */
+        .word   BadCmd-CmdTable                     /* 0x5E */
+        .word   BadCmd-CmdTable                     /* 0x5F */
+        .word   BadCmd-CmdTable                     /* 0x60 */
+        .word   SfxPlayBufferSource-CmdTable        /* 'a' */
+        .word   SfxSetBufferDefaults-CmdTable       /* 'b' */
+        .word   BadCmd-CmdTable                     /* 'c' */
+        .word   BadCmd-CmdTable                     /* 'd' */
+        .word   BadCmd-CmdTable                     /* 'e' */
+        .word   BadCmd-CmdTable                     /* 'f' */
+        .word   BadCmd-CmdTable                     /* 'g' */
+        .word   BadCmd-CmdTable                     /* 'h' */
+        .word   BadCmd-CmdTable                     /* 'i' */
+        .word   BadCmd-CmdTable                     /* 'j' */
+        .word   BadCmd-CmdTable                     /* 'k' */
+        .word   BadCmd-CmdTable                     /* 'l' */
+        .word   SfxGetMemInfo-CmdTable              /* 'm' */
+        .word   SfxPUnPSourceSet-CmdTable           /* 'n' */
+        .word   SfxStopSourceSet-CmdTable           /* 'o' */
+        .word   BadCmd-CmdTable                     /* 'p' */
+        .word   BadCmd-CmdTable                     /* 'q' */
+        .word   SfxGetModulePosition-CmdTable       /* 'r' */
+        .word   BadCmd-CmdTable                     /* 's' */
+        .word   SfxGetTrace-CmdTable                /* 't' */
+        .word   BadCmd-CmdTable                     /* 'u' */
+        .word   SfxVerifyDecoders-CmdTable          /* 'v' */
+        .word   BadCmd-CmdTable                     /* 'w' */
+        .word   BadCmd-CmdTable                     /* 'x' */
+        .word   BadCmd-CmdTable                     /* 'y' */
+        .word   BadCmd-CmdTable                     /* 'z' */
+        .word   BadCmd-CmdTable                     /* 0x7B */
+        .word   BadCmd-CmdTable                     /* 0x7C */
+        .word   BadCmd-CmdTable                     /* 0x7D */
+        .word   BadCmd-CmdTable                     /* 0x7E */
+        .word   BadCmd-CmdTable                     /* 0x7F */
+
+BadCmd:
+        move.b  #'E,0x800F.w            /* sub comm port = ERROR */
+WaitAck:
+        tst.b   0x800E.w
+        bne.b   WaitAck                 /* wait for result acknowledged */
+        TRACE_EVENT TRACE_ACK,0x800F.w
+        move.b  #0,0x800F.w             /* sub comm port = READY */
+        bra.w   WaitCmd
+
+| runs the next step of the drive initialization, one BIOS call at a time
+DriveInitStep:
+        move.b  drive_init_step,d0
+        cmpi.b  #2,d0
+        beq.b   2f
+        cmpi.b  #3,d0
+        beq.b   3f
+        cmpi.b  #4,d0
+        beq.b   4f
+
         move.w  #0x0081,d0              /* CDBSTAT */
         jsr     0x5F22.w                /* call CDBIOS function */
         move.w  0(a0),d0                /* BIOS status word */
@@ -39,74 +174,39 @@ SPMain:
         cmpi.b  #0x10,d0
         beq.b   9f                      /* no disc */
 1:
+        move.b  #2,drive_init_step
+        rts
+2:
 | Initialize Drive
         lea     drive_init_parms(pc),a0
         move.w  #0x0010,d0              /* DRVINIT */
         jsr     0x5F22.w                /* call CDBIOS function */
-
+        move.b  #3,drive_init_step
+        rts
+3:
         move.w  #0x0085,d0              /* BIOS_FDRSET - set audio volume */
         move.w  #0x8400.w,d1            /* master volume (0 to 1024) */
         jsr     0x5F22.w                /* call CDBIOS function */
-
+        move.b  #4,drive_init_step
+        rts
+4:
         move.w  #0x0089,d0              /* CDCSTOP - stop reading data */
         jsr     0x5F22.w                /* call CDBIOS function */
 9:
-        move.b  #0,0x800F.w             /* sub comm port = READY */
-
-| wait for command in main comm port
-WaitCmd:
-        tst.b   updates_suspend
-        bne     WaitCmdPostUpdate
-
-        jsr     S_Update
-        
-WaitCmdPostUpdate:
-        tst.b   0x800E.w
-        beq.b   WaitCmd
-        cmpi.b  #'D,0x800E.w
-        beq     GetDiscInfo
-        cmpi.b  #'T,0x800E.w
-        beq     GetTrackInfo
-        cmpi.b  #'P,0x800E.w
-        beq     PlayTrack
-        cmpi.b  #'S,0x800E.w
-        beq     StopPlaying
-        cmpi.b  #'V,0x800E.w
-        beq     SetVolume
-        cmpi.b  #'Z,0x800E.w
-        beq     PauseResume
-        cmpi.b  #'C,0x800E.w
-        beq     CheckDisc
-
-        cmpi.b  #'I,0x800E.w
-        beq     SfxInit
-        cmpi.b  #'L,0x800E.w
-        beq     SfxClear
-        cmpi.b  #'B,0x800E.w
-        beq     SfxCopyBuffer
-        cmpi.b  #'A,0x800E.w
-        beq     SfxPlaySource
-        cmpi.b  #'N,0x800E.w
-        beq     SfxPUnPSource
-        cmpi.b  #'W,0x800E.w
-        beq     SfxRewindSource
-        cmpi.b  #'U,0x800E.w
-        beq     SfxUpdateSource
-        cmpi.b  #'O,0x800E.w
-        beq     SfxStopSource
-        cmpi.b  #'G,0x800E.w
-        beq     SfxGetSourcePosition
-        cmpi.b  #'E,0x800E.w
-        beq     SfxSuspendUpdates
+        move.b  #0,drive_init_step
+        rts
 
-        move.b  #'E,0x800F.w            /* sub comm port = ERROR */
-WaitAck:
-        tst.b   0x800E.w
-        bne.b   WaitAck                 /* wait for result acknowledged */
-        move.b  #0,0x800F.w             /* sub comm port = READY */
-        bra.w   WaitCmd
+| the CD commands finish the drive initialization first
+FinishDriveInit:
+        tst.b   drive_init_step
+        beq.b   1f
+        bsr.b   DriveInitStep
+        bra.b   FinishDriveInit
+1:
+        rts
 
 GetDiscInfo:
+        bsr.w   FinishDriveInit
         move.w  #0x0081,d0              /* CDBSTAT */
         jsr     0x5F22.w                /* call CDBIOS function */
         move.w  0(a0),0x8020.w          /* BIOS status word */
@@ -117,6 +217,7 @@ GetDiscInfo:
         bra     WaitAck
 
 GetTrackInfo:
+        bsr.w   FinishDriveInit
         move.w  0x8010.w,d1             /* track number */
         move.w  #0x0083,d0              /* CDBTOCREAD */
         jsr     0x5F22.w                /* call CDBIOS function */
@@ -127,6 +228,7 @@ GetTrackInfo:
         bra     WaitAck
 
 PlayTrack:
+        bsr.w   FinishDriveInit
         move.w  #0x0002,d0              /* MSCSTOP - stop playing */
         jsr     0x5F22.w                /* call CDBIOS function */
 
@@ -148,6 +250,7 @@ PlayTrack:
         bra     WaitAck
 
 StopPlaying:
+        bsr.w   FinishDriveInit
         move.w  #0x0002,d0              /* MSCSTOP - stop playing */
         jsr     0x5F22.w                /* call CDBIOS function */
 
@@ -155,6 +258,7 @@ StopPlaying:
         bra     WaitAck
 
 SetVolume:
+        bsr.w   FinishDriveInit
         move.w  #0x0085,d0              /* BIOS_FDRSET - set audio volume */
         move.w  0x8010.w,d1             /* cd volume (0 to 1024) */
         jsr     0x5F22.w                /* call CDBIOS function */
@@ -163,6 +267,7 @@ SetVolume:
         bra     WaitAck
 
 PauseResume:
+        bsr.w   FinishDriveInit
         move.w  #0x0081,d0              /* CDBSTAT */
         jsr     0x5F22.w                /* call CDBIOS function */
         move.b  (a0),d0
@@ -187,6 +292,7 @@ PauseResume:
         bra     WaitAck
 
 CheckDisc:
+        bsr.w   FinishDriveInit
         lea     drive_init_parms(pc),a0
         move.w  #0x0010,d0              /* DRVINIT */
         jsr     0x5F22.w                /* call CDBIOS function */
@@ -208,7 +314,12 @@ SfxClear:
         bra     WaitAck
 
 SfxCopyBuffer:
+| uint8_t S_ReserveBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate);
+| uint8_t S_CopyBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate);
         jsr     switch_banks
+        moveq   #0,d0
+        move.w  0x8012.w,d0             /* rate */
+        move.l  d0,-(sp)
         move.l  0x8018.w,d0             /* length */
         move.l  d0,-(sp)
         move.l  0x8014.w,d0             /* address in RAM */
@@ -216,19 +327,68 @@ SfxCopyBuffer:
         moveq   #0,d0
         move.w  0x8010.w,d0             /* buffer id */
         move.l  d0,-(sp)
+        move.l  12(sp),-(sp)            /* rate */
+        move.l  12(sp),-(sp)            /* length */
+        move.l  12(sp),-(sp)            /* address in RAM */
+        move.l  12(sp),-(sp)            /* buffer id */
+        jsr     S_ReserveBufferData     /* check the data and set aside memory for it */
+        lea     16(sp),sp               /* the callee may have changed its copy of the args */
+        move.b  d0,0x8020.w             /* result */
         move.b  #'D,0x800F.w            /* sub comm port = DONE */
 SfxCopyBufferWaitAck:
         tst.b   0x800E.w
         bne.b   SfxCopyBufferWaitAck    /* wait for result acknowledged */
+        TRACE_EVENT TRACE_ACK,0x800F.w
         move.b  #0,0x800F.w             /* sub comm port = READY */
+        tst.b   d0
+        bne.b   1f                      /* nothing to copy */
         jsr     S_CopyBufferData        /* copy the buffer data in the background */
-        lea     12(sp),sp               /* clear the stack */
+1:
+        lea     16(sp),sp               /* clear the stack */
+        bra.w   WaitCmd
+
+SfxCopyKosBuffer:
+| uint8_t S_ReserveKosBufferData(uint16_t buf_id, uint32_t unpacked_len);
+| uint8_t S_CopyKosBufferData(uint16_t buf_id, const uint8_t *data, uint32_t unpacked_len, uint16_t rate);
+        jsr     switch_banks
+        moveq   #0,d0
+        move.w  0x8012.w,d0             /* rate */
+        move.l  d0,-(sp)
+        move.l  0x8018.w,d0             /* unpacked length */
+        move.l  d0,-(sp)
+        move.l  0x8014.w,d0             /* address in RAM */
+        move.l  d0,-(sp)
+        moveq   #0,d0
+        move.w  0x8010.w,d0             /* buffer id */
+        move.l  d0,-(sp)
+        move.l  8(sp),-(sp)             /* unpacked length */
+        move.l  d0,-(sp)                /* buffer id */
+        jsr     S_ReserveKosBufferData  /* set aside memory for the data */
+        addq.l  #8,sp
+        move.b  d0,0x8020.w             /* result */
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+SfxCopyKosBufferWaitAck:
+        tst.b   0x800E.w
+        bne.b   SfxCopyKosBufferWaitAck /* wait for result acknowledged */
+        TRACE_EVENT TRACE_ACK,0x800F.w
+        move.b  #0,0x800F.w             /* sub comm port = READY */
+        tst.b   d0
+        bne.b   1f                      /* nothing to decompress */
+        jsr     S_CopyKosBufferData     /* decompress the buffer data in the background */
+1:
+        lea     16(sp),sp               /* clear the stack */
         bra.w   WaitCmd
 
 SfxPlaySource:
-| uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop);
+| uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset, uint8_t bus);
         moveq   #0,d0
 
+        move.b  0x8016.w,d0
+        move.l  d0,-(sp)                /* bus */
+        move.l  0x801c.w,-(sp)          /* offset */
+
+        move.b  0x801a.w,d0
+        move.l  d0,-(sp)                /* priority */
         move.b  0x801b.w,d0
         move.l  d0,-(sp)                /* autoloop */
         move.b  0x8019.w,d0
@@ -245,7 +405,7 @@ SfxPlaySource:
         move.l  d0,-(sp)                /* src_id */
 
         jsr     S_PlaySource
-        lea     24(sp),sp               /* clear the stack */
+        lea     36(sp),sp               /* clear the stack */
 
         move.b  d0,0x8020.w             /* src_id */
 
@@ -280,6 +440,21 @@ SfxRewindSource:
         move.b  #'D,0x800F.w            /* sub comm port = DONE */
         bra     WaitAck
 
+SfxSeekSource:
+| void S_SeekSource(uint8_t src_id, uint32_t pos);
+        move.l  0x8014.w,-(sp)          /* pos */
+
+        moveq   #0,d0
+
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* src_id */
+
+        jsr     S_SeekSource
+        lea     8(sp),sp                /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
 SfxStopSource:
 | void S_StopSource(uint8_t src_id);
         moveq   #0,d0
@@ -316,6 +491,31 @@ SfxUpdateSource:
         move.b  #'D,0x800F.w            /* sub comm port = DONE */
         bra     WaitAck
 
+SfxAutomateSource:
+| void S_AutomateSource(uint8_t src_id, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags);
+        moveq   #0,d0
+
+        move.b  0x801b.w,d0
+        move.l  d0,-(sp)                /* flags */
+        move.b  0x8019.w,d0
+        move.l  d0,-(sp)                /* curve */
+
+        move.w  0x8016.w,d0
+        move.l  d0,-(sp)                /* duration */
+        move.w  0x8014.w,d0
+        move.l  d0,-(sp)                /* target */
+
+        move.w  0x8012.w,d0
+        move.l  d0,-(sp)                /* param */
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* src_id */
+
+        jsr     S_AutomateSource
+        lea     24(sp),sp               /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
 SfxGetSourcePosition:
 | void S_GetSourcePosition(uint8_t src_id);
         moveq   #0,d0
@@ -330,6 +530,204 @@ SfxGetSourcePosition:
         move.b  #'D,0x800F.w            /* sub comm port = DONE */
         bra     WaitAck
 
+SfxGetSourceSamplePosition:
+| uint32_t S_GetSourceSamplePosition(uint8_t src_id);
+        moveq   #0,d0
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* src_id */
+
+        jsr     S_GetSourceSamplePosition
+        lea     4(sp),sp                /* clear the stack */
+
+        move.l  d0,0x8020.w             /* samples */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxGetLoadStats:
+| void S_GetLoadStats(uint8_t page, uint8_t reset);
+        moveq   #0,d0
+        move.w  0x8012.w,d0
+        move.l  d0,-(sp)                /* reset */
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* page */
+
+        jsr     S_GetLoadStats
+        lea     8(sp),sp                /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxGetMemInfo:
+| void S_GetMemInfo(uint8_t *dst);
+        move.l  0x8014.w,-(sp)          /* address in RAM, 0 for the pool stats only */
+        jsr     S_GetMemInfo
+        addq.l  #4,sp                   /* clear the stack */
+
+        tst.l   0x8014.w
+        beq.b   1f
+        jsr     switch_banks            /* hand the records over to the main CPU */
+1:
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxGetTrace:
+| void S_GetTrace(uint8_t *dst, uint8_t reset);
+        moveq   #0,d0
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* reset */
+        move.l  0x8014.w,-(sp)          /* address in RAM, 0 to only reset */
+        jsr     S_GetTrace
+        addq.l  #8,sp                   /* clear the stack */
+
+        tst.l   0x8014.w
+        beq.b   1f
+        jsr     switch_banks            /* hand the dump over to the main CPU */
+1:
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxVerifyDecoders:
+| void S_VerifyDecoders(uint8_t what, uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed);
+        move.l  0x8018.w,-(sp)          /* seed */
+        moveq   #0,d0
+        move.w  0x8016.w,d0
+        move.l  d0,-(sp)                /* streams */
+        move.w  0x8014.w,d0
+        move.l  d0,-(sp)                /* channels */
+        move.w  0x8012.w,d0
+        move.l  d0,-(sp)                /* codec */
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* what */
+        jsr     S_VerifyDecoders
+        lea     20(sp),sp               /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxSetBuses:
+| void S_SetBuses(uint8_t mask, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused);
+        moveq   #0,d0
+        move.w  0x8018.w,d0
+        move.l  d0,-(sp)                /* paused */
+        move.w  0x8016.w,d0
+        move.l  d0,-(sp)                /* duck */
+        move.w  0x8014.w,d0
+        move.l  d0,-(sp)                /* vol */
+        move.w  0x8012.w,d0
+        move.l  d0,-(sp)                /* what */
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* mask */
+
+        jsr     S_SetBuses
+        lea     20(sp),sp               /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxGetVersion:
+| void S_GetVersion(void);
+        jsr     S_GetVersion
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxSetBufferDefaults:
+| void S_SetBufferDefaults(uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint8_t bus);
+        moveq   #0,d0
+
+        move.b  0x8016.w,d0
+        move.l  d0,-(sp)                /* bus */
+        move.b  0x801a.w,d0
+        move.l  d0,-(sp)                /* priority */
+        move.b  0x801b.w,d0
+        move.l  d0,-(sp)                /* autoloop */
+        move.b  0x8019.w,d0
+        move.l  d0,-(sp)                /* vol */
+        move.b  0x8017.w,d0
+        move.l  d0,-(sp)                /* pan */
+        move.w  0x8014.w,d0
+        move.l  d0,-(sp)                /* freq */
+        move.w  0x8012.w,d0
+        move.l  d0,-(sp)                /* buf_id */
+
+        jsr     S_SetBufferDefaults
+        lea     28(sp),sp               /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxPlayBufferSource:
+| uint8_t S_PlayBufferSource(uint8_t src_id, uint16_t buf_id);
+        moveq   #0,d0
+
+        move.w  0x8012.w,d0
+        move.l  d0,-(sp)                /* buf_id */
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* src_id */
+
+        jsr     S_PlayBufferSource
+        lea     8(sp),sp                /* clear the stack */
+
+        move.b  d0,0x8020.w             /* src_id */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxPUnPSourceSet:
+| void S_PUnPSourceSet(uint32_t mask, uint8_t pause);
+        moveq   #0,d0
+
+        move.w  0x8014.w,d0
+        move.l  d0,-(sp)                /* paused */
+        move.l  0x8010.w,-(sp)          /* mask */
+
+        jsr     S_PUnPSourceSet
+        lea     8(sp),sp                /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxStopSourceSet:
+| void S_StopSourceSet(uint32_t mask);
+        move.l  0x8010.w,-(sp)          /* mask */
+
+        jsr     S_StopSourceSet
+        lea     4(sp),sp                /* clear the stack */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxPlayModule:
+| uint8_t S_PlayModule(uint16_t buf_id, uint8_t first_src, uint8_t priority, uint8_t loop);
+        moveq   #0,d0
+
+        move.w  0x8016.w,d0
+        move.l  d0,-(sp)                /* loop */
+        move.w  0x8014.w,d0
+        move.l  d0,-(sp)                /* priority */
+        move.w  0x8012.w,d0
+        move.l  d0,-(sp)                /* first_src */
+        move.w  0x8010.w,d0
+        move.l  d0,-(sp)                /* buf_id */
+
+        jsr     S_PlayModule
+        lea     16(sp),sp               /* clear the stack */
+
+        move.b  d0,0x8020.w             /* started */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
+SfxGetModulePosition:
+| uint16_t S_GetModulePosition(void);
+        jsr     S_GetModulePosition
+
+        move.w  d0,0x8020.w             /* order|row */
+
+        move.b  #'D,0x800F.w            /* sub comm port = DONE */
+        bra     WaitAck
+
 SfxSuspendUpdates:
         move.b  0x8010.w,updates_suspend
 
@@ -376,5 +774,8 @@ track_number:
 updates_suspend:
         .byte   0
 
+drive_init_step:
+        .byte   0
+
         .global _start
 _start:
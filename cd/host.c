@@ -0,0 +1,413 @@
+// native stand-ins for the asm parts of the driver, pcm-io.s and kos.s, and a
+// simulated RF5C164 for them to talk to, so that the driver can be built with
+// -DPCM_HOST and run off-target
+//
+// the simulated chip follows what the driver relies on: channels start at
+// START << 8 when switched on, advance by FD/2048 wave memory bytes per output
+// sample, jump to the loop address on a 0xFF byte, and expose the playback
+// address in the RAMPTR registers, wave memory is written through a 4K window
+// selected with CTRL, same as on the hardware
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pcm.h"
+
+#define HOST_CHANNELS 8
+#define HOST_BANK_SIZE 0x1000
+
+typedef struct
+{
+    uint8_t env, pan;
+    uint16_t fd;
+    uint16_t loop;
+    uint8_t start;
+    uint32_t addr; // 16.11 fixed point
+} host_channel_t;
+
+uint16_t pcm_host_regs[PCM_NUM_REGS] = { [0 ... PCM_NUM_REGS-1] = PCM_REG_NONE };
+uint8_t pcm_host_ramptr[32];
+uint8_t pcm_host_window[0x2000];
+uint32_t pcm_host_comm[4];
+
+volatile uint32_t pcm_clock;
+
+static uint8_t host_wave[0x10000];
+static host_channel_t host_chan[HOST_CHANNELS];
+static uint8_t host_ctrl, host_onoff = 0xFF;
+static uint8_t host_bank;
+
+static void (*host_timer_callback)(void);
+static uint8_t host_timer_on;
+static uint16_t host_timer_cntr;
+static uint16_t host_timer_div = 5;
+static uint8_t host_timer_reg = 129; // TIMER, 8 bits wide
+static uint16_t host_timer_period = 130;
+
+static void host_flush_window(void)
+{
+    int i;
+    uint8_t *wave = host_wave + host_bank * HOST_BANK_SIZE;
+
+    for (i = 0; i < HOST_BANK_SIZE; i++) {
+        wave[i] = pcm_host_window[(i << 1) + 1];
+    }
+}
+
+static void host_load_window(void)
+{
+    int i;
+    const uint8_t *wave = host_wave + host_bank * HOST_BANK_SIZE;
+
+    for (i = 0; i < HOST_BANK_SIZE; i++) {
+        pcm_host_window[(i << 1) + 1] = wave[i];
+    }
+}
+
+static void host_update_ramptr(void)
+{
+    int i;
+
+    for (i = 0; i < HOST_CHANNELS; i++) {
+        uint16_t addr = host_chan[i].addr >> 11;
+        pcm_host_ramptr[(i << 2) + 0] = addr & 0xFF;
+        pcm_host_ramptr[(i << 2) + 2] = addr >> 8;
+    }
+}
+
+// applies the latched register writes
+static void host_sync(void)
+{
+    int i;
+    uint16_t *regs = pcm_host_regs;
+    host_channel_t *chan;
+
+    if (regs[PCM_REG_CTRL] != PCM_REG_NONE) {
+        host_ctrl = regs[PCM_REG_CTRL];
+        if (!(host_ctrl & 0x40) && (host_ctrl & 0x0F) != host_bank) {
+            host_flush_window();
+            host_bank = host_ctrl & 0x0F;
+            host_load_window();
+        }
+    }
+
+    chan = &host_chan[host_ctrl & 0x07];
+    if (regs[PCM_REG_ENV] != PCM_REG_NONE)
+        chan->env = regs[PCM_REG_ENV];
+    if (regs[PCM_REG_PAN] != PCM_REG_NONE)
+        chan->pan = regs[PCM_REG_PAN];
+    if (regs[PCM_REG_FDL] != PCM_REG_NONE)
+        chan->fd = (chan->fd & 0xFF00) | regs[PCM_REG_FDL];
+    if (regs[PCM_REG_FDH] != PCM_REG_NONE)
+        chan->fd = (chan->fd & 0x00FF) | (regs[PCM_REG_FDH] << 8);
+    if (regs[PCM_REG_LSL] != PCM_REG_NONE)
+        chan->loop = (chan->loop & 0xFF00) | regs[PCM_REG_LSL];
+    if (regs[PCM_REG_LSH] != PCM_REG_NONE)
+        chan->loop = (chan->loop & 0x00FF) | (regs[PCM_REG_LSH] << 8);
+    if (regs[PCM_REG_START] != PCM_REG_NONE)
+        chan->start = regs[PCM_REG_START];
+
+    if (regs[PCM_REG_ONOFF] != PCM_REG_NONE) {
+        uint8_t onoff = regs[PCM_REG_ONOFF];
+        for (i = 0; i < HOST_CHANNELS; i++) {
+            if ((host_onoff & ~onoff) & (1 << i)) {
+                // switched on, restart from the start address
+                host_chan[i].addr = (uint32_t)host_chan[i].start << 19;
+            }
+        }
+        host_onoff = onoff;
+        host_update_ramptr();
+    }
+
+    for (i = 0; i < PCM_NUM_REGS; i++) {
+        regs[i] = PCM_REG_NONE;
+    }
+}
+
+// mixes the next samples of the running channels into interleaved 16-bit stereo
+void pcm_host_render(int16_t *out, int samples)
+{
+    int i, j;
+
+    host_sync();
+    host_flush_window();
+
+    for (i = 0; i < samples; i++) {
+        int32_t left = 0, right = 0;
+
+        for (j = 0; j < HOST_CHANNELS && (host_ctrl & 0x80); j++) {
+            host_channel_t *chan = &host_chan[j];
+            uint8_t data;
+            int32_t s;
+
+            if (host_onoff & (1 << j)) {
+                continue;
+            }
+
+            data = host_wave[(chan->addr >> 11) & 0xFFFF];
+            if (data == 0xFF) {
+                chan->addr = (uint32_t)chan->loop << 11;
+                data = host_wave[chan->loop];
+                if (data == 0xFF) {
+                    continue;
+                }
+            }
+
+            s = (data & 0x7F) * chan->env;
+            if (!(data & 0x80)) {
+                s = -s;
+            }
+            left += (s * (chan->pan & 0x0F)) >> 5;
+            right += (s * (chan->pan >> 4)) >> 5;
+
+            chan->addr = (chan->addr + chan->fd) & 0x7FFFFFF;
+        }
+
+        if (left < -32768) left = -32768;
+        if (left > 32767) left = 32767;
+        if (right < -32768) right = -32768;
+        if (right > 32767) right = 32767;
+        *out++ = left;
+        *out++ = right;
+    }
+
+    host_update_ramptr();
+}
+
+// the timer interrupt: advances the clock and calls the callback every host_timer_div ticks
+void pcm_host_tick(void)
+{
+    if (!host_timer_on) {
+        return;
+    }
+
+    pcm_clock += host_timer_period;
+    pcm_host_comm[2] = pcm_clock;
+
+    if (++host_timer_cntr < host_timer_div) {
+        return;
+    }
+    host_timer_cntr = 0;
+    if (host_timer_callback) {
+        host_timer_callback();
+    }
+}
+
+// output samples per timer tick
+uint16_t pcm_host_timer_period(void)
+{
+    return host_timer_period;
+}
+
+uint8_t pcm_lcf(uint8_t pan)
+{
+    uint8_t right = pan, left = ~pan;
+
+    if (right < 0xF8)
+        right += 8;
+    if (left < 0xF8)
+        left += 8;
+    return (right & 0xF0) | (left >> 4);
+}
+
+void pcm_delay(void)
+{
+    host_sync();
+}
+
+// selects the wave bank for the sample offset, returns the write pointer
+// and the number of samples left in the bank, capped at len
+static uint8_t *host_wave_bank(uint16_t doff, uint16_t len, uint16_t *wblen)
+{
+    uint16_t woff = doff & (HOST_BANK_SIZE - 1);
+
+    PCM_CTRL = 0x80 + (doff >> 12); // make sure PCM chip is ON to write wave memory, and set wave bank
+    pcm_delay();
+
+    *wblen = HOST_BANK_SIZE - woff;
+    if (*wblen > len)
+        *wblen = len;
+    return &PCM_WAVE + (woff << 1);
+}
+
+void pcm_cpy_stereo_u8(uint8_t *wptr, uint8_t *wptr2, uint8_t *samples, uint32_t length)
+{
+    while (length--) {
+        *wptr = pcm_u8_to_sm_lut[*samples++];
+        *wptr2 = pcm_u8_to_sm_lut[*samples++];
+        wptr += 2;
+        wptr2 += 2;
+    }
+}
+
+static void host_cpy(uint16_t doff, const uint8_t *src, uint16_t len, const uint8_t *conv, int step)
+{
+    while (len > 0) {
+        uint16_t i, wblen;
+        uint8_t *wptr = host_wave_bank(doff, len, &wblen);
+
+        for (i = 0; i < wblen; i++) {
+            wptr[i << 1] = conv ? conv[*src] : *src;
+            src += step;
+        }
+        doff += wblen;
+        len -= wblen;
+    }
+}
+
+void pcm_cpy_mono(uint16_t doff, void *src, uint16_t len, uint8_t *conv)
+{
+    host_cpy(doff, src, len, conv, 1);
+}
+
+void pcm_cpy_stereo(uint16_t doff, void *src, uint16_t len, uint8_t *conv)
+{
+    host_cpy(doff, src, len, conv, 2);
+}
+
+void pcm_load_zero(uint16_t start, uint16_t length)
+{
+    while (length > 0) {
+        uint16_t i, wblen;
+        uint8_t *wptr = host_wave_bank(start, length, &wblen);
+
+        for (i = 0; i < wblen; i++) {
+            wptr[i << 1] = 0;
+        }
+        start += wblen;
+        length -= wblen;
+    }
+}
+
+void pcm_set_period(uint32_t period)
+{
+    uint32_t incr = 65535;
+
+    if (period >= 4) {
+        incr = 446304 / (period + 1);
+        if (incr > 65535)
+            incr = 65535;
+        incr >>= 1;
+    }
+    PCM_FDL = incr & 0xFF;
+    pcm_delay();
+    PCM_FDH = incr >> 8;
+    pcm_delay();
+}
+
+void pcm_set_freq(uint32_t freq)
+{
+    uint32_t incr = 65535;
+
+    if (freq < 1041648) {
+        incr = (freq << 11) / 32552;
+    }
+    PCM_FDL = incr & 0xFF;
+    pcm_delay();
+    PCM_FDH = incr >> 8;
+    pcm_delay();
+}
+
+// same as pcm-io.s: the callback runs at 2 * bpm / 5 Hz, the period of the
+// 8-bit TIMER register only fits with 5 ticks per callback from 64 BPM up
+void pcm_set_timer(uint16_t bpm)
+{
+    uint16_t div = 5;
+
+    if (bpm == 0) {
+        return;
+    }
+    if (bpm > 255) {
+        bpm = 255;
+    }
+    if (bpm < 64) {
+        div = (81380 + 256 * bpm - 1) / (256 * bpm);
+    }
+    host_timer_reg = (81380 + bpm * div / 2) / (bpm * div) - 1;
+    host_timer_period = host_timer_reg + 1;
+    host_timer_div = div;
+}
+
+void pcm_stop_timer(void)
+{
+    host_timer_on = 0;
+}
+
+void pcm_start_timer(void (*callback)(void))
+{
+    host_timer_callback = callback;
+    host_timer_cntr = 0;
+    host_timer_div = 5;
+    host_timer_reg = 129; // 125 BPM
+    host_timer_period = host_timer_reg + 1;
+    host_timer_on = 1;
+}
+
+// stand-in for kos.s
+uint8_t *Kos_Decomp(uint8_t *src, uint8_t *dst, uint8_t *dst_end)
+{
+    uint16_t desc = src[0] | (src[1] << 8);
+    int bits = 15;
+
+    src += 2;
+
+#define KOS_BIT(b) do { \
+        b = desc & 1; \
+        desc >>= 1; \
+        if (bits-- == 0) { \
+            desc = src[0] | (src[1] << 8); \
+            src += 2; \
+            bits = 15; \
+        } \
+    } while (0)
+
+    for (;;) {
+        int bit, count;
+        int16_t offset;
+
+        KOS_BIT(bit);
+        if (bit) {
+            if (dst >= dst_end) {
+                return NULL;
+            }
+            *dst++ = *src++;
+            continue;
+        }
+
+        KOS_BIT(bit);
+        if (!bit) {
+            // inline copy, 2 to 5 bytes from up to 256 bytes back
+            KOS_BIT(bit);
+            count = bit << 1;
+            KOS_BIT(bit);
+            count = (count | bit) + 2;
+            offset = (int16_t)(0xFF00 | *src++);
+        } else {
+            uint8_t lo = *src++, hi = *src++;
+            offset = (int16_t)(0xE000 | ((hi & 0xF8) << 5) | lo);
+            count = hi & 7;
+            if (count != 0) {
+                count += 2;
+            } else {
+                count = *src++;
+                if (count == 0) {
+                    break;
+                }
+                if (count == 1) {
+                    continue;
+                }
+                count++;
+            }
+        }
+
+        if (count > dst_end - dst) {
+            return NULL;
+        }
+        while (count--) {
+            *dst = dst[offset];
+            dst++;
+        }
+    }
+
+#undef KOS_BIT
+    return dst;
+}
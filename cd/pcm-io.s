@@ -2,12 +2,19 @@
     /* PCM channel increment */
     .equ    PCM_FDL, 0xFF0005
     .equ    PCM_FDH, 0xFF0007
+    .equ    PCM_CTRL, 0xFF000F
+
+    /* Wave memory window, every other byte */
+    .equ    PCM_WAVE, 0xFF2001
 
     /* General use timer */
     .equ    TIMER,    0x8030
     .equ    INT_MASK, 0x8032
     .equ    _LEVEL3,  0x5F82        /* TIMER INTERRUPT jump vector */
 
+    /* Sub comm port the sample clock is published to */
+    .equ    COMM_CLOCK, 0x8028
+
 
     .text
     .align  2
@@ -46,6 +53,297 @@ pcm_delay:
     rts
 
 
+| void pcm_cpy_stereo_u8(uint8_t *wptr, uint8_t *wptr2, uint8_t *samples, uint32_t length);
+| Deinterleave unsigned 8-bit stereo samples, converting them to sign/magnitude
+| Left channel samples are written to every other byte at wptr, right ones - at wptr2
+    .global pcm_cpy_stereo_u8
+pcm_cpy_stereo_u8:
+    movem.l d2/a2-a3,-(sp)
+    movea.l 16(sp),a0               /* left channel write pointer */
+    movea.l 20(sp),a1               /* right channel write pointer */
+    movea.l 24(sp),a2               /* interleaved samples */
+    move.l  28(sp),d1               /* length */
+    lea     pcm_u8_to_sm_lut,a3
+    moveq   #0,d0
+
+    moveq   #3,d2
+    and.w   d1,d2                   /* leading pairs */
+    lsr.w   #2,d1                   /* groups of 4 pairs */
+    bra.b   1f
+0:
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),(a0)
+    addq.l  #2,a0
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),(a1)
+    addq.l  #2,a1
+1:
+    dbra    d2,0b
+
+    bra.b   3f
+2:
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),0(a0)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),0(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),2(a0)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),2(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),4(a0)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),4(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),6(a0)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),6(a1)
+    addq.l  #8,a0
+    addq.l  #8,a1
+3:
+    dbra    d1,2b
+
+    movem.l (sp)+,d2/a2-a3
+    rts
+
+
+| Select the wave bank for the sample offset in d2. Returns the write pointer
+| in a1 and the number of samples left in the bank, capped at d3, in d4
+| Trashes d0-d1
+wave_bank:
+    move.w  d2,d0
+    rol.w   #4,d0
+    andi.w  #0x000F,d0
+    addi.b  #0x80,d0
+    move.b  d0,PCM_CTRL.l           /* make sure PCM chip is ON to write wave memory, and set wave bank */
+    move.w  d2,d0
+    andi.w  #0x0FFF,d0              /* offset in bank */
+    move.w  #0x1000,d4
+    sub.w   d0,d4
+    cmp.w   d3,d4
+    bls.b   0f
+    move.w  d3,d4
+0:
+    lea     PCM_WAVE.l,a1
+    add.w   d0,d0
+    adda.w  d0,a1
+    bra     pcm_delay
+
+
+| void pcm_cpy_mono(uint16_t doff, void *src, uint16_t len, uint8_t *conv);
+| Copy samples to wave memory, converting them through the conv table unless it's NULL
+    .global pcm_cpy_mono
+pcm_cpy_mono:
+    movem.l d2-d4/a2-a3,-(sp)
+    move.l  24(sp),d2               /* doff */
+    movea.l 28(sp),a2               /* src */
+    move.l  32(sp),d3               /* len */
+    movea.l 36(sp),a3               /* conv */
+    tst.w   d3
+    beq     9f
+0:
+    bsr.b   wave_bank
+    add.w   d4,d2
+    sub.w   d4,d3
+
+    moveq   #7,d1
+    and.w   d4,d1                   /* trailing samples */
+    lsr.w   #3,d4                   /* groups of 8 samples */
+    moveq   #0,d0
+    cmpa.w  #0,a3
+    bne.b   4f
+
+    move.w  a2,d0
+    btst    #0,d0
+    bne.b   6f                      /* can't fetch longs from an odd address */
+    bra.b   2f
+1:
+    move.l  (a2)+,d0
+    movep.l d0,0(a1)
+    move.l  (a2)+,d0
+    movep.l d0,8(a1)
+    lea     16(a1),a1
+2:
+    dbra    d4,1b
+    bra.b   71f
+
+3:
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),0(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),2(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),4(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),6(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),8(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),10(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),12(a1)
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),14(a1)
+    lea     16(a1),a1
+4:
+    dbra    d4,3b
+    bra.b   41f
+40:
+    move.b  (a2)+,d0
+    move.b  0(a3,d0.w),(a1)
+    addq.l  #2,a1
+41:
+    dbra    d1,40b
+    bra.b   8f
+
+5:
+    move.b  (a2)+,0(a1)
+    move.b  (a2)+,2(a1)
+    move.b  (a2)+,4(a1)
+    move.b  (a2)+,6(a1)
+    move.b  (a2)+,8(a1)
+    move.b  (a2)+,10(a1)
+    move.b  (a2)+,12(a1)
+    move.b  (a2)+,14(a1)
+    lea     16(a1),a1
+6:
+    dbra    d4,5b
+    bra.b   71f
+70:
+    move.b  (a2)+,(a1)
+    addq.l  #2,a1
+71:
+    dbra    d1,70b
+
+8:
+    tst.w   d3
+    bne     0b
+9:
+    movem.l (sp)+,d2-d4/a2-a3
+    rts
+
+
+| void pcm_cpy_stereo(uint16_t doff, void *src, uint16_t len, uint8_t *conv);
+| Copy every other byte of src to wave memory, converting it through
+| the conv table unless it's NULL
+    .global pcm_cpy_stereo
+pcm_cpy_stereo:
+    movem.l d2-d4/a2-a3,-(sp)
+    move.l  24(sp),d2               /* doff */
+    movea.l 28(sp),a2               /* src */
+    move.l  32(sp),d3               /* len */
+    movea.l 36(sp),a3               /* conv */
+    tst.w   d3
+    beq     9f
+0:
+    bsr     wave_bank
+    add.w   d4,d2
+    sub.w   d4,d3
+
+    moveq   #7,d1
+    and.w   d4,d1                   /* trailing samples */
+    lsr.w   #3,d4                   /* groups of 8 samples */
+    moveq   #0,d0
+    cmpa.w  #0,a3
+    bne.b   4f
+    bra.b   2f
+1:
+    movep.l 0(a2),d0                /* movep doesn't care for alignment */
+    movep.l d0,0(a1)
+    movep.l 8(a2),d0
+    movep.l d0,8(a1)
+    lea     16(a2),a2
+    lea     16(a1),a1
+2:
+    dbra    d4,1b
+    bra.b   6f
+5:
+    move.b  (a2),(a1)
+    addq.l  #2,a2
+    addq.l  #2,a1
+6:
+    dbra    d1,5b
+    bra.b   8f
+
+3:
+    move.b  0(a2),d0
+    move.b  0(a3,d0.w),0(a1)
+    move.b  2(a2),d0
+    move.b  0(a3,d0.w),2(a1)
+    move.b  4(a2),d0
+    move.b  0(a3,d0.w),4(a1)
+    move.b  6(a2),d0
+    move.b  0(a3,d0.w),6(a1)
+    move.b  8(a2),d0
+    move.b  0(a3,d0.w),8(a1)
+    move.b  10(a2),d0
+    move.b  0(a3,d0.w),10(a1)
+    move.b  12(a2),d0
+    move.b  0(a3,d0.w),12(a1)
+    move.b  14(a2),d0
+    move.b  0(a3,d0.w),14(a1)
+    lea     16(a2),a2
+    lea     16(a1),a1
+4:
+    dbra    d4,3b
+    bra.b   71f
+70:
+    move.b  (a2),d0
+    move.b  0(a3,d0.w),(a1)
+    addq.l  #2,a2
+    addq.l  #2,a1
+71:
+    dbra    d1,70b
+
+8:
+    tst.w   d3
+    bne     0b
+9:
+    movem.l (sp)+,d2-d4/a2-a3
+    rts
+
+
+| void pcm_load_zero(uint16_t start, uint16_t length);
+| Fill wave memory with silence
+    .global pcm_load_zero
+pcm_load_zero:
+    movem.l d2-d4,-(sp)
+    move.l  16(sp),d2               /* start */
+    move.l  20(sp),d3               /* length */
+    tst.w   d3
+    beq.b   9f
+0:
+    bsr     wave_bank
+    add.w   d4,d2
+    sub.w   d4,d3
+
+    moveq   #15,d1
+    and.w   d4,d1                   /* trailing samples */
+    lsr.w   #4,d4                   /* groups of 16 samples */
+    moveq   #0,d0
+    bra.b   2f
+1:
+    movep.l d0,0(a1)
+    movep.l d0,8(a1)
+    movep.l d0,16(a1)
+    movep.l d0,24(a1)
+    lea     32(a1),a1
+2:
+    dbra    d4,1b
+    bra.b   4f
+3:
+    move.b  d0,(a1)                 /* not clr.b, that reads the location first */
+    addq.l  #2,a1
+4:
+    dbra    d1,3b
+
+    tst.w   d3
+    bne.b   0b
+9:
+    movem.l (sp)+,d2-d4
+    rts
+
+
 | void pcm_set_period(uint32_t period);
     .global pcm_set_period
 pcm_set_period:
@@ -89,19 +387,40 @@ pcm_set_freq:
 
 
 | void pcm_set_timer(uint16_t bpm);
-| TIMER = 32552 / (bpm * 2) - 1
-|   should be 32552 * 5 / (bpm * 2) - 1, but that's too big for TIMER, so
-|   we leave out the * 5 and compensate in the int handler
+| the callback runs at 2 * bpm / 5 Hz, every int3_div timer ints:
+| TIMER + 1 = 32552 * 5 / (bpm * 2 * int3_div) = 81380 / (bpm * int3_div)
+|   and timer_period is TIMER + 1, the clock ticks between two ints
+|   TIMER is 8 bits wide, so the period fits with 5 ints per callback from
+|   64 BPM up, slower tempos take as many more ints as it needs
     .global pcm_set_timer
 pcm_set_timer:
-    move.l  #32552,d0
     move.l  4(sp),d1
-    add.w   d1,d1
+    tst.w   d1
     beq.b   0f                      /* safety check... passing 0 will just exit */
-    divu.w  d1,d0
+    cmpi.w  #255,d1
+    bls.b   1f
+    move.w  #255,d1
+1:
+    moveq   #5,d0                   /* ints per callback */
+    cmpi.w  #64,d1
+    bhs.b   2f
+    andi.l  #0xFF,d1
+    lsl.l   #8,d1                   /* 256 * bpm */
+    move.l  #81380-1,d0
+    add.l   d1,d0
+    divu.w  d1,d0                   /* ceil(81380 / (256 * bpm)) */
+    lsr.l   #8,d1
+2:
+    movea.w d0,a0
+    mulu.w  d0,d1                   /* bpm * ints per callback */
+    move.l  d1,d0
+    lsr.l   #1,d0
+    addi.l  #81380,d0
+    divu.w  d1,d0                   /* clock ticks per timer int, rounded, at most 256 */
+    move.w  d0,timer_period
     subq.w  #1,d0
-    ble.b   0f                      /* safety check */
     move.w  d0,TIMER.w
+    move.w  a0,int3_div
 0:
     rts
 
@@ -127,11 +446,13 @@ pcm_start_timer:
 
     move.l  4(sp),int3_callback     /* set callback vector */
     move.w  #0,int3_cntr            /* clear int counter */
+    move.w  #5,int3_div
 
     move.w  #0x4EF9,_LEVEL3.w
     move.l  #timer_int,_LEVEL3+2.w  /* set level 3 int vector for timer */
 
     move.w  #129,TIMER.w            /* 125 BPM */
+    move.w  #130,timer_period
     move.w  INT_MASK.w,d0
     ori.w   #0x0008,d0
     move.w  d0,INT_MASK.w           /* enable General Timer interrupt */
@@ -142,15 +463,23 @@ pcm_start_timer:
 
 timer_int:
     move.l  d0,-(sp)
+    moveq   #0,d0
+    move.w  timer_period,d0
+    add.l   d0,pcm_clock            /* advance the sample clock */
+    move.l  pcm_clock,COMM_CLOCK.w    /* and publish it to the main CPU */
+
     move.w  int3_cntr,d0
     addq.w  #1,d0
-    cmpi.w  #5,d0
-    blo.b   0f                      /* once every 5 ints for actual beats per minute rate */
+    cmp.w   int3_div,d0
+    blo.b   0f                      /* once every int3_div ints for actual beats per minute rate */
 
+    tst.l   int3_callback
+    beq.b   1f                      /* the timer may run just for the clock */
     movem.l d1/a0-a1,-(sp)
     movea.l int3_callback,a1
     jsr     (a1)
     movem.l (sp)+,d1/a0-a1
+1:
     moveq   #0,d0
 0:
     move.w  d0,int3_cntr
@@ -169,3 +498,15 @@ int3_callback:
 int3_cntr:
     .word   0
 
+int3_div:
+    .word   5
+
+timer_period:
+    .word   130
+
+| uint32_t pcm_clock;
+| Free-running clock, counts at PCM_CLOCK_RATE while the timer is running
+    .global pcm_clock
+pcm_clock:
+    .long   0
+
@@ -5,6 +5,8 @@
 
 #define BLK_SHIFT 8
 
+#define STEREO_CHUNK 256 // max number of samples converted to scratch memory at once
+
 uint8_t pcm_u8_to_sm_lut[256];
 
 static uint8_t loop_markers[32] = {
@@ -16,122 +18,74 @@ static uint8_t loop_markers[32] = {
 
 static uint8_t ChanOff;
 
-static void pcm_cpy_mono(uint16_t doff, void *src, uint16_t len, uint8_t *conv)
-{
-    uint8_t *sptr = (uint8_t *)src;
-
-    while (len > 0)
-    {
-        uint8_t *wptr = (uint8_t *)&PCM_WAVE;
-        uint16_t woff = doff & 0x0FFF;
-        uint16_t wblen = 0x1000 - woff;
-        wptr += (woff << 1);
-
-        PCM_CTRL = 0x80 + (doff >> 12); // make sure PCM chip is ON to write wave memory, and set wave bank
-        pcm_delay();
-
-        if (wblen > len)
-            wblen = len;
-        doff += wblen;
-        len -= wblen;
-        while (wblen > 0)
-        {
-            uint8_t s = *sptr++;
-            if (conv)
-            {
-                // convert from 8-bit unsigned samples to sign/magnitude samples
-                s = conv[(uint8_t)s];
-            }
-            *wptr++ = s;
-            wptr++;
-            wblen--;
-        }
-    }
-}
-
-static void pcm_cpy_stereo(uint16_t doff, void *src, uint16_t len, uint8_t *conv)
-{
-    uint8_t *sptr = (uint8_t *)src;
-
-    while (len > 0)
-    {
-        uint8_t *wptr = (uint8_t *)&PCM_WAVE;
-        uint16_t woff = doff & 0x0FFF;
-        uint16_t wblen = 0x1000 - woff;
-        wptr += (woff << 1);
-
-        PCM_CTRL = 0x80 + (doff >> 12); // make sure PCM chip is ON to write wave memory, and set wave bank
-        pcm_delay();
-
-        if (wblen > len)
-            wblen = len;
-        doff += wblen;
-        len -= wblen;
-        while (wblen > 0)
-        {
-            uint8_t s = *sptr;
-            if (conv)
-            {
-                // convert from 8-bit unsigned samples to sign/magnitude samples
-                s = conv[(uint8_t)s];
-            }
-            sptr += 2;
-            *wptr++ = s;
-            wptr++;
-            wblen--;
-        }
-    }
-}
-
 uint16_t pcm_load_samples(uint16_t start, uint8_t *samples, uint16_t length)
 {
     pcm_cpy_mono(start, samples, length, NULL);
     return length;
 }
 
-uint16_t pcm_load_samples_u8(uint16_t start, uint8_t *samples, uint16_t length)
+// loads every other byte of the input
+uint16_t pcm_load_samples_interleaved(uint16_t start, uint8_t *samples, uint16_t length)
 {
-    pcm_cpy_mono(start, samples, length, pcm_u8_to_sm_lut);
+    pcm_cpy_stereo(start, samples, length, NULL);
     return length;
 }
 
-uint16_t pcm_load_stereo_samples_u8(uint16_t start, uint16_t start2, uint8_t *samples, uint16_t length)
+uint16_t pcm_load_samples_u8(uint16_t start, uint8_t *samples, uint16_t length)
 {
-    pcm_cpy_stereo(start, samples, length, pcm_u8_to_sm_lut);
-    pcm_cpy_stereo(start2, samples+1, length, pcm_u8_to_sm_lut);
+    pcm_cpy_mono(start, samples, length, pcm_u8_to_sm_lut);
     return length;
 }
 
-void pcm_loop_markers(uint16_t start)
-{
-    pcm_cpy_mono(start, loop_markers, 32, NULL);
-}
-
-void pcm_load_zero(uint16_t start, uint16_t len)
+uint16_t pcm_load_stereo_samples_u8(uint16_t start, uint16_t start2, uint8_t *samples, uint16_t length)
 {
-    uint16_t doff = start;
+    uint16_t doff = start, doff2 = start2;
+    uint16_t len = length;
+    static uint8_t scratch[STEREO_CHUNK*2];
 
     while (len > 0)
     {
         uint8_t *wptr = (uint8_t *)&PCM_WAVE;
+        uint8_t *wptr2 = (uint8_t *)&PCM_WAVE;
         uint16_t woff = doff & 0x0FFF;
+        uint16_t woff2 = doff2 & 0x0FFF;
         uint16_t wblen = 0x1000 - woff;
+        if (wblen > 0x1000 - woff2)
+            wblen = 0x1000 - woff2;
         wptr += (woff << 1);
+        wptr2 += (woff2 << 1);
 
         PCM_CTRL = 0x80 + (doff >> 12); // make sure PCM chip is ON to write wave memory, and set wave bank
         pcm_delay();
 
+        if ((doff ^ doff2) & 0xF000)
+        {
+            // the right channel is in another bank, convert
+            // it to scratch memory and copy it over later
+            if (wblen > STEREO_CHUNK)
+                wblen = STEREO_CHUNK;
+            wptr2 = scratch;
+        }
+
         if (wblen > len)
             wblen = len;
+
+        pcm_cpy_stereo_u8(wptr, wptr2, samples, wblen);
+        if (wptr2 == scratch)
+            pcm_cpy_stereo(doff2, scratch, wblen, NULL);
+
+        samples += (wblen << 1);
         doff += wblen;
+        doff2 += wblen;
         len -= wblen;
-        while (wblen > 0)
-        {
-            *wptr++ = 0;
-            wptr++;
-            wblen--;
-        }
     }
+
+    return length;
+}
+
+void pcm_loop_markers(uint16_t start)
+{
+    pcm_cpy_mono(start, loop_markers, 32, NULL);
 }
 
 void pcm_init(void)
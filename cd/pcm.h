@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#ifndef PCM_HOST
+
 // PCM chip registers
 #define PCM_ENV   *((volatile uint8_t *)0xFF0001)
 #define PCM_PAN   *((volatile uint8_t *)0xFF0003)
@@ -16,12 +18,61 @@
 #define PCM_RAMPTR ((volatile uint8_t *)0xFF0021)
 #define PCM_WAVE  *((volatile uint8_t *)0xFF2001)
 
+// sub comm registers the driver publishes results to
+#define COMM_RESULT ((volatile uint32_t *)0xFF8020)
+#define COMM_STATUS *((volatile uint32_t *)0xFF802C)
+
+#else
+
+// native build against the simulated chip in host.c: register writes are
+// latched and take effect on the pcm_delay call that follows each of them
+enum
+{
+    PCM_REG_ENV,
+    PCM_REG_PAN,
+    PCM_REG_FDL,
+    PCM_REG_FDH,
+    PCM_REG_LSL,
+    PCM_REG_LSH,
+    PCM_REG_START,
+    PCM_REG_CTRL,
+    PCM_REG_ONOFF,
+    PCM_NUM_REGS
+};
+
+#define PCM_REG_NONE 0xFFFF // not written since the last pcm_delay
+
+extern uint16_t pcm_host_regs[PCM_NUM_REGS];
+extern uint8_t pcm_host_ramptr[32];
+extern uint8_t pcm_host_window[0x2000];
+extern uint32_t pcm_host_comm[4];
+
+#define PCM_ENV   (pcm_host_regs[PCM_REG_ENV])
+#define PCM_PAN   (pcm_host_regs[PCM_REG_PAN])
+#define PCM_FDL   (pcm_host_regs[PCM_REG_FDL])
+#define PCM_FDH   (pcm_host_regs[PCM_REG_FDH])
+#define PCM_LSL   (pcm_host_regs[PCM_REG_LSL])
+#define PCM_LSH   (pcm_host_regs[PCM_REG_LSH])
+#define PCM_START (pcm_host_regs[PCM_REG_START])
+#define PCM_CTRL  (pcm_host_regs[PCM_REG_CTRL])
+#define PCM_ONOFF (pcm_host_regs[PCM_REG_ONOFF])
+#define PCM_RAMPTR ((volatile uint8_t *)pcm_host_ramptr)
+#define PCM_WAVE  (pcm_host_window[1])
+
+#define COMM_RESULT ((volatile uint32_t *)&pcm_host_comm[0])
+#define COMM_STATUS (pcm_host_comm[3])
+
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define PCM_U8_AMPLIFICATION 1
 
+// rate of both the general use timer and the PCM chip output, in Hz
+#define PCM_CLOCK_RATE 32552
+
 // convert from 8-bit signed samples to sign/magnitude samples
 #define pcm_s8_to_sm(s) (((s) < 0) ? ((s) < -127 ? 127 : -(s)) : (((s) > 126 ? 126 : (s))|128))
 
@@ -30,7 +81,7 @@ extern void pcm_init(void);
 uint16_t pcm_load_samples(uint16_t start, uint8_t *samples, uint16_t length);
 extern uint16_t pcm_load_samples_u8(uint16_t start, uint8_t *samples, uint16_t length);
 uint16_t pcm_load_stereo_samples_u8(uint16_t start, uint16_t start2, uint8_t *samples, uint16_t length);
-extern void pcm_load_zero(uint16_t start, uint16_t length);
+uint16_t pcm_load_samples_interleaved(uint16_t start, uint8_t *samples, uint16_t length);
 extern void pcm_reset(void);
 extern void pcm_set_ctrl(uint8_t val);
 extern void pcm_set_off(uint8_t index);
@@ -50,6 +101,18 @@ extern void pcm_set_freq(uint32_t freq);
 extern void pcm_set_timer(uint16_t bpm);
 extern void pcm_stop_timer(void);
 extern void pcm_start_timer(void (*callback)(void));
+extern void pcm_cpy_mono(uint16_t doff, void *src, uint16_t len, uint8_t *conv);
+extern void pcm_cpy_stereo(uint16_t doff, void *src, uint16_t len, uint8_t *conv);
+extern void pcm_load_zero(uint16_t start, uint16_t length);
+extern void pcm_cpy_stereo_u8(uint8_t *wptr, uint8_t *wptr2, uint8_t *samples, uint32_t length);
+extern volatile uint32_t pcm_clock;
+
+#ifdef PCM_HOST
+/* from host.c */
+extern void pcm_host_render(int16_t *out, int samples);
+extern void pcm_host_tick(void);
+extern uint16_t pcm_host_timer_period(void);
+#endif
 
 #ifdef __cplusplus
 }
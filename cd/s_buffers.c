@@ -3,13 +3,27 @@
 #include "s_channels.h"
 #include "pcm.h"
 #include "adpcm.h"
+#include "adpcm_dp4.h"
 
 #define S_LE_SHORT(chunk) (((chunk)[1]<<8)|(((chunk)[0]) << 0))
 #define S_LE_LONG(chunk)  (((chunk)[3]<<24)|(((chunk)[2]) << 16)|((chunk)[1]<<8)|(((chunk)[0]) << 0))
+#define S_BE_SHORT(p) (((p)[0]<<8)|(((p)[1]) << 0))
+#define S_BE_LONG(p)  (((p)[0]<<24)|(((p)[1]) << 16)|((p)[2]<<8)|(((p)[3]) << 0))
+
+// allocations are kept even, so that sample data can be copied with movep
+#define S_MEM_ALIGN(size) (((size) + 1) & ~1)
+
+extern uint8_t *Kos_Decomp(uint8_t *src, uint8_t *dst, uint8_t *dst_end);
+
+// broken Kosinski data can write this far past the end of the output before
+// Kos_Decomp notices, see kos.s, so the buffers hold as much on top of it
+#define S_BUF_KOS_SLACK 72
 
 #define S_WAV_FORMAT_PCM         0x1
 #define S_WAV_FORMAT_IMA_ADPCM   0x11
 #define S_WAV_FORMAT_CREATIVE_LABS_ADPCM   0x0200
+#define S_WAV_FORMAT_IMA_LITE    0x5C11 // private to the driver
+#define S_WAV_FORMAT_DP4         0x5C04 // private to the driver
 #define S_WAV_FORMAT_EXTENSIBLE  0xfffe
 
 static uint8_t *s_mem_start, *s_mem_end;
@@ -27,11 +41,14 @@ void S_InitBuffers(uint8_t *start_addr, uint32_t size)
 
     for (i = 0; i < S_MAX_BUFFERS; i++) {
         sfx_buffer_t *buf = s_buffers + i;
+        buf->mem = NULL;
         buf->data = NULL;
         buf->freq = 0;
         buf->num_channels = 0;
         buf->size = 0;
+        buf->bits = 8;
         buf->format = S_FORMAT_NONE;
+        buf->loop_start = 0;
     }
 }
 
@@ -54,45 +71,74 @@ int S_Buf_ParseWaveFile(sfx_buffer_t *buf, uint8_t *data, uint32_t len)
         return 0;
     }
 
-    // find the format chunk
+    if (len < 20) {
+        return -1;
+    }
+
+    // find the format chunk, walking all of the chunks before the data
     uint8_t *chunk = data + 12;
-    uint8_t *end = data + 0x40 - 4;
+    uint8_t *end = data + len - 8;
     int format = 0;
 
     // set default block size
     buf->adpcm_block_size = 256;
+    buf->bits = 8;
+
+    while (chunk <= end) {
+        // bytes of the upload past the chunk header
+        uint32_t avail = data + len - chunk - 8;
 
-    while (chunk < end) {
         // a long value in little endian format
         length = S_LE_LONG(&chunk[4]);
+        if (length < 0) {
+            return -1;
+        }
 
-        if (chunk[0] == 'd' && chunk[1] == 'a' && chunk[2] == 't' && chunk[3] == 'a')
+        if (chunk[0] == 'd' && chunk[1] == 'a' && chunk[2] == 't' && chunk[3] == 'a') {
+            if ((uint32_t)length > avail) {
+                // truncated upload, keep what's there
+                length = avail;
+            }
             break;
+        }
+
+        if ((uint32_t)length > avail) {
+            return -1;
+        }
 
         if (chunk[0] == 'f' && chunk[1] == 'm' && chunk[2] == 't' && chunk[3] == ' ') // 'fmt '
         {
+            if (length < 16) {
+                return -1;
+            }
+
             int channels = S_LE_SHORT(&chunk[10]);
             int sample_rate = S_LE_LONG(&chunk[12]);
             int block_align = S_LE_SHORT(&chunk[20]);
+            int bits = S_LE_SHORT(&chunk[22]);
 
             format = S_LE_SHORT(&chunk[8]);
-            if (format == S_WAV_FORMAT_EXTENSIBLE && length == 40) {
+            if (format == S_WAV_FORMAT_EXTENSIBLE && length >= 40) {
                 format = S_LE_LONG(&chunk[32]); // sub-format
             }
 
             buf->freq = sample_rate;
             buf->adpcm_block_size = block_align;
             buf->num_channels = channels;
+            buf->bits = bits;
         }
 
-        chunk += 8 + length;
+        chunk += 8 + length + (length & 1); // chunks are word aligned
     }
 
-    if (chunk >= end)
+    if (chunk > end)
         return -1;
 
     switch (format) {
         case S_WAV_FORMAT_PCM:
+            if (buf->bits != 8 && buf->bits != 16 && buf->bits != 24) {
+                return -1;
+            }
             buf->format = S_FORMAT_RAW_U8;
             break;
         case S_WAV_FORMAT_IMA_ADPCM:
@@ -100,7 +146,33 @@ int S_Buf_ParseWaveFile(sfx_buffer_t *buf, uint8_t *data, uint32_t len)
             buf->format = S_FORMAT_WAV_ADPCM;
             break;
         case S_WAV_FORMAT_CREATIVE_LABS_ADPCM:
-            buf->adpcm_codec = ADPCM_CODEC_SB4;
+            // the number of bits per sample tells the variants apart
+            switch (buf->bits) {
+                case 3:
+                    buf->adpcm_codec = ADPCM_CODEC_SB3;
+                    break;
+                case 2:
+                    buf->adpcm_codec = ADPCM_CODEC_SB2;
+                    break;
+                default:
+                    buf->adpcm_codec = ADPCM_CODEC_SB4;
+                    break;
+            }
+            if (buf->adpcm_codec != ADPCM_CODEC_SB4 && buf->num_channels != 1) {
+                // only mono streams are supported for the low bitrate variants
+                return -1;
+            }
+            buf->format = S_FORMAT_WAV_ADPCM;
+            break;
+        case S_WAV_FORMAT_IMA_LITE:
+            buf->adpcm_codec = ADPCM_CODEC_IML;
+            buf->format = S_FORMAT_WAV_ADPCM;
+            break;
+        case S_WAV_FORMAT_DP4:
+            if (buf->num_channels != 1 || length < ADPCM_DP4_TABLE_SIZE) {
+                return -1;
+            }
+            buf->adpcm_codec = ADPCM_CODEC_DP4;
             buf->format = S_FORMAT_WAV_ADPCM;
             break;
         default:
@@ -109,25 +181,87 @@ int S_Buf_ParseWaveFile(sfx_buffer_t *buf, uint8_t *data, uint32_t len)
 
     buf->data = &chunk[8];
     buf->data_len = length;
+
+    if (format == S_WAV_FORMAT_DP4) {
+        // the table of delta pairs comes first
+        buf->adpcm_table = buf->data;
+        buf->data += ADPCM_DP4_TABLE_SIZE;
+        buf->data_len -= ADPCM_DP4_TABLE_SIZE;
+    }
     return 1;
 }
 
-void S_Buf_SetData(sfx_buffer_t *buf, uint8_t *data, uint32_t data_len)
+// buffers pre-parsed by tools/scdpack, see S_BUF_HEADER_SIZE
+static int S_Buf_ParseHeader(sfx_buffer_t *buf, uint8_t *data, uint32_t len)
+{
+    uint32_t length;
+
+    if (len < S_BUF_HEADER_SIZE) {
+        return 0;
+    }
+    if (data[0] != 'S' || data[1] != 'C' || data[2] != 'D' || data[3] != 'B') {
+        return 0;
+    }
+
+    length = S_BE_LONG(&data[12]);
+    if (length > len - S_BUF_HEADER_SIZE) {
+        return -1;
+    }
+    if (data[6] < 1 || data[6] > 2) {
+        return -1;
+    }
+
+    switch (data[4]) {
+        case S_FORMAT_RAW_U8:
+        case S_FORMAT_RAW_SM:
+            break;
+        case S_FORMAT_WAV_ADPCM:
+            if (data[5] == ADPCM_CODEC_NONE || data[5] >= ADPCM_NUM_CODECS) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    buf->format = data[4];
+    buf->adpcm_codec = data[5];
+    buf->num_channels = data[6];
+    buf->freq = S_BE_SHORT(&data[8]);
+    buf->adpcm_block_size = S_BE_SHORT(&data[10]);
+    buf->bits = 8;
+    buf->data = data + S_BUF_HEADER_SIZE;
+    buf->data_len = length;
+
+    if (buf->format == S_FORMAT_WAV_ADPCM && buf->adpcm_codec == ADPCM_CODEC_DP4) {
+        if (length < ADPCM_DP4_TABLE_SIZE) {
+            return -1;
+        }
+        buf->adpcm_table = buf->data;
+        buf->data += ADPCM_DP4_TABLE_SIZE;
+        buf->data_len -= ADPCM_DP4_TABLE_SIZE;
+    }
+    return 1;
+}
+
+// fills in the format of the buffer from its data, returns a negative value if it's broken
+static int S_Buf_ParseData(sfx_buffer_t *buf, uint8_t *data, uint32_t data_len)
 {
     int wav;
 
-    buf->freq = 0;
-    buf->num_channels = 0;
-    if (!data) {
-error:        
-        buf->data = NULL;
-        buf->data_len = 0;
-        return;
+    wav = S_Buf_ParseHeader(buf, data, data_len);
+    if (wav != 0) {
+        return wav;
     }
 
     wav = S_Buf_ParseWaveFile(buf, data, data_len);
     if (wav < 0) { // a WAV, but borked
-        goto error;
+        return -1;
+    }
+
+    if (wav > 0 && buf->format == S_FORMAT_RAW_U8 && buf->bits != 8) {
+        // wide samples are only supported through S_Buf_CopyData
+        return -1;
     }
 
     if (wav == 0) {
@@ -136,23 +270,275 @@ error:
         buf->format = S_FORMAT_RAW_U8;
         buf->num_channels = 1;
     }
+    return 1;
+}
+
+void S_Buf_SetData(sfx_buffer_t *buf, uint8_t *data, uint32_t data_len)
+{
+    buf->freq = 0;
+    buf->num_channels = 0;
+    buf->loop_start = 0;
+    if (!data || S_Buf_ParseData(buf, data, data_len) < 0) {
+        buf->data = NULL;
+        buf->data_len = 0;
+        buf->format = S_FORMAT_NONE;
+    }
+}
+
+// reads a little endian PCM sample as a signed 16-bit value
+static int32_t S_Buf_ReadSample(const uint8_t *src, int width)
+{
+    switch (width) {
+        case 1:
+            return ((int32_t)src[0] - 128) * 256;
+        case 2:
+            return (int16_t)((src[1] << 8) | src[0]);
+        default:
+            return (int16_t)((src[2] << 8) | src[1]);
+    }
+}
+
+// reduces signed 16-bit samples to unsigned 8-bit ones, optionally resampling
+// them with linear interpolation, step is the distance between output frames
+// in input frames, in 16.16 fixed point
+static void S_Buf_ConvertSamples(uint8_t *dst, const uint8_t *src, uint32_t frames, uint32_t src_frames,
+    int channels, int width, uint32_t step)
+{
+    int c;
+    int frame_size = channels * width;
+    uint32_t idx = 0;
+    uint16_t frac = 0;
+#ifdef S_BUF_DITHER
+    uint16_t seed = 0xACE1;
+#endif
+
+    while (frames-- > 0) {
+        const uint8_t *fsrc = src + idx * frame_size;
+        int interp = frac && idx + 1 < src_frames;
+
+        for (c = 0; c < channels; c++, fsrc += width) {
+            int32_t s = S_Buf_ReadSample(fsrc, width);
+
+            if (interp) {
+                int32_t s2 = S_Buf_ReadSample(fsrc + frame_size, width);
+                s += ((s2 - s) * (frac >> 1)) >> 15;
+            }
+
+#ifdef S_BUF_DITHER
+            if (width > 1) {
+                uint16_t noise;
+
+                // triangular noise of +-1 LSB of the output from a xorshift generator
+                seed ^= seed << 7;
+                seed ^= seed >> 9;
+                seed ^= seed << 8;
+                noise = (seed & 0xff) + (seed >> 8);
+
+                s += noise - 255 + 128;
+                if (s < -32768) s = -32768;
+                if (s > 32767) s = 32767;
+            }
+#endif
+            *dst++ = (s >> 8) + 128;
+        }
+
+        idx += step >> 16;
+        if ((uint16_t)(frac + (uint16_t)step) < frac) {
+            idx++;
+        }
+        frac += (uint16_t)step;
+    }
+}
+
+// 16 and 24-bit PCM is reduced to 8 bits while being copied, and PCM
+// can be resampled to a lower rate, so that only the converted sample
+// data needs to be stored
+typedef struct
+{
+    sfx_buffer_t wav;
+    uint32_t frames, src_frames, step;
+    uint32_t size; // bytes of converted data
+    uint16_t rate;
+    int width;
+} sfx_pcm_conv_t;
+
+// works out the conversion of the data, returns 0 if it's to be copied as is
+static int S_Buf_PlanPCMData(sfx_pcm_conv_t *conv, const uint8_t *data, uint32_t data_len, uint16_t rate)
+{
+    sfx_buffer_t *wav = &conv->wav;
+
+    if (S_Buf_ParseWaveFile(wav, (uint8_t *)data, data_len) <= 0) {
+        return 0;
+    }
+    if (wav->format != S_FORMAT_RAW_U8 || !wav->num_channels || !wav->freq) {
+        return 0;
+    }
+    if (!rate || rate > wav->freq) {
+        // never upsample
+        rate = wav->freq;
+    }
+    if (wav->bits == 8 && rate == wav->freq) {
+        // can be copied as is
+        return 0;
+    }
+
+    conv->width = wav->bits >> 3;
+    conv->src_frames = wav->data_len / (conv->width * wav->num_channels);
+    if (!conv->src_frames) {
+        return 0;
+    }
+
+    // frames * rate / freq without overflowing
+    conv->frames = conv->src_frames / wav->freq * rate + (conv->src_frames % wav->freq) * rate / wav->freq;
+    conv->step = ((uint32_t)wav->freq << 16) / rate;
+    conv->size = conv->frames * wav->num_channels;
+    conv->rate = rate;
+    return 1;
+}
+
+static void S_Buf_ConvertPCMData(sfx_buffer_t *buf, uint8_t *dst, const sfx_pcm_conv_t *conv)
+{
+    S_Buf_ConvertSamples(dst, conv->wav.data, conv->frames, conv->src_frames, conv->wav.num_channels,
+        conv->width, conv->step);
+
+    buf->data = dst;
+    buf->data_len = conv->size;
+    buf->freq = conv->rate;
+    buf->num_channels = conv->wav.num_channels;
+    buf->bits = 8;
+    buf->format = S_FORMAT_RAW_U8;
+    buf->loop_start = 0;
 }
 
-void S_Buf_CopyData(sfx_buffer_t *buf, const uint8_t *data, uint32_t data_len)
+// returns the memory of the buffer if it's large enough, otherwise allocates
+// size bytes from the pool, NULL if the pool is out of memory
+static uint8_t *S_Buf_Alloc(sfx_buffer_t *buf, uint32_t size)
 {
-    if (buf->data && buf->size >= data_len) {
+    if (buf->mem && buf->size >= size) {
         // in-place update
-        memcpy(buf->data, data, data_len);
-        S_Buf_SetData(buf, buf->data, data_len);
-        return;
+        return buf->mem;
+    }
+    if (s_mem_rover + size > s_mem_end) {
+        return NULL;
+    }
+
+    buf->mem = s_mem_rover;
+    buf->size = size;
+    s_mem_rover += S_MEM_ALIGN(size);
+    return buf->mem;
+}
+
+// gives the memory past size back to the pool, if the buffer holds the end of it
+static void S_Buf_Trim(sfx_buffer_t *buf, uint32_t size)
+{
+    if (size < buf->size && buf->mem + S_MEM_ALIGN(buf->size) == s_mem_rover) {
+        buf->size = size;
+        s_mem_rover = buf->mem + S_MEM_ALIGN(size);
+    }
+}
+
+int S_Buf_Reserve(sfx_buffer_t *buf, const uint8_t *data, uint32_t data_len, uint16_t rate)
+{
+    sfx_pcm_conv_t conv;
+    uint32_t size = data_len;
+
+    if (S_Buf_PlanPCMData(&conv, data, data_len, rate)) {
+        size = conv.size;
+    } else if (S_Buf_ParseData(&conv.wav, (uint8_t *)data, data_len) < 0) {
+        return S_UPLOAD_BAD_DATA;
+    }
+
+    return S_Buf_Alloc(buf, size) ? S_UPLOAD_OK : S_UPLOAD_NO_MEMORY;
+}
+
+int S_Buf_CopyData(sfx_buffer_t *buf, const uint8_t *data, uint32_t data_len, uint16_t rate)
+{
+    sfx_pcm_conv_t conv;
+    uint8_t *dst;
+
+    if (S_Buf_PlanPCMData(&conv, data, data_len, rate)) {
+        dst = S_Buf_Alloc(buf, conv.size);
+        if (!dst) {
+            return S_UPLOAD_NO_MEMORY;
+        }
+        S_Buf_ConvertPCMData(buf, dst, &conv);
+        return S_UPLOAD_OK;
+    }
+
+    // copied to the start of the memory of the buffer, the data
+    // of an earlier upload may start past its header
+    dst = S_Buf_Alloc(buf, data_len);
+    if (!dst) {
+        return S_UPLOAD_NO_MEMORY;
+    }
+
+    memcpy(dst, data, data_len);
+    S_Buf_SetData(buf, dst, data_len);
+    return buf->data ? S_UPLOAD_OK : S_UPLOAD_BAD_DATA;
+}
+
+int S_Buf_ReserveKos(sfx_buffer_t *buf, uint32_t unpacked_len)
+{
+    return S_Buf_Alloc(buf, unpacked_len + S_BUF_KOS_SLACK) ? S_UPLOAD_OK : S_UPLOAD_NO_MEMORY;
+}
+
+int S_Buf_CopyKosData(sfx_buffer_t *buf, const uint8_t *data, uint32_t unpacked_len, uint16_t rate)
+{
+    sfx_pcm_conv_t conv;
+    uint8_t *end, *dst = S_Buf_Alloc(buf, unpacked_len + S_BUF_KOS_SLACK);
+
+    if (!dst) {
+        return S_UPLOAD_NO_MEMORY;
+    }
+
+    end = Kos_Decomp((uint8_t *)data, dst, dst + unpacked_len);
+    if (!end) {
+        // the data unpacks to more than unpacked_len
+        S_Buf_SetData(buf, NULL, 0);
+        return S_UPLOAD_BAD_DATA;
+    }
+    unpacked_len = end - dst;
+
+    // wide or resampled PCM is converted over the decompressed data: the
+    // output never gets ahead of the input, the rest is given back after
+    if (S_Buf_PlanPCMData(&conv, dst, unpacked_len, rate)) {
+        S_Buf_ConvertPCMData(buf, dst, &conv);
+        S_Buf_Trim(buf, conv.size);
+        return S_UPLOAD_OK;
     }
 
-    if (s_mem_rover + data_len > s_mem_end) {
-        return;
+    S_Buf_SetData(buf, dst, unpacked_len);
+    return buf->data ? S_UPLOAD_OK : S_UPLOAD_BAD_DATA;
+}
+
+void S_Buf_GetMemStats(sfx_mem_stats_t *stats)
+{
+    int i;
+
+    stats->total = s_mem_end - s_mem_start;
+    stats->free = s_mem_end - s_mem_rover;
+    stats->largest_free = stats->free;
+    stats->num_buffers = 0;
+    stats->reserved = 0;
+
+    for (i = 0; i < S_MAX_BUFFERS; i++) {
+        if (s_buffers[ i ].mem) {
+            stats->num_buffers++;
+        }
     }
+}
 
-    memcpy(s_mem_rover, data, data_len);
-    buf->size = data_len;
-    S_Buf_SetData(buf, s_mem_rover, data_len);
-    s_mem_rover += data_len;
+void S_Buf_GetInfo(const sfx_buffer_t *buf, sfx_buffer_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    if (buf->mem) {
+        info->size = buf->size;
+    }
+    if (buf->data) {
+        info->data_len = buf->data_len;
+        info->freq = buf->freq;
+        info->format = buf->format;
+        info->adpcm_codec = buf->format == S_FORMAT_WAV_ADPCM ? buf->adpcm_codec : ADPCM_CODEC_NONE;
+        info->num_channels = buf->num_channels;
+    }
 }
@@ -6,30 +6,94 @@
 
 #define S_MAX_BUFFERS 128
 
+// add noise when reducing 16 and 24-bit PCM to 8 bits on upload
+//#define S_BUF_DITHER
+
 enum
 {
     S_FORMAT_NONE,
     S_FORMAT_RAW_U8,
     S_FORMAT_WAV_ADPCM,
+    S_FORMAT_RAW_SM, // sign/magnitude samples, ready to be copied to wave RAM
+};
+
+// buffers pre-parsed on the host by tools/scdpack start with a header of
+// S_BUF_HEADER_SIZE bytes, all the fields are big endian:
+//
+// 0: "SCDB"
+// 4: format, one of S_FORMAT_*
+// 5: codec, one of ADPCM_CODEC_*
+// 6: number of channels
+// 7: reserved, 0
+// 8: 16-bit sample rate
+// 10: 16-bit ADPCM block size
+// 12: 32-bit length of the data following the header
+#define S_BUF_HEADER_SIZE 16
+
+// results of the uploads
+enum
+{
+    S_UPLOAD_OK,
+    S_UPLOAD_BAD_ID,
+    S_UPLOAD_NO_MEMORY,
+    S_UPLOAD_BAD_DATA, // not a supported WAV or buffer header
 };
 
 typedef struct
 {
+    uint8_t *mem; // memory of the pool held by the buffer, size bytes of it
     uint8_t *data;
     uint32_t data_len, size;
     uint16_t freq;
     uint8_t num_channels;
+    uint8_t bits; // bits per sample of the PCM data
     uint8_t format;
     uint8_t adpcm_codec;
     uint16_t adpcm_block_size;
+    uint8_t *adpcm_table; // delta pairs preceding the DP4 blocks
+    uint32_t loop_start; // sample that looping sources restart from
 } sfx_buffer_t;
 
+// a record of the buffer inventory, same as scd_buf_info_t on the main CPU
+typedef struct
+{
+    uint32_t size; // bytes of the pool held by the buffer, 0 if none
+    uint32_t data_len; // bytes of sample data, 0 if the buffer is empty
+    uint16_t freq;
+    uint8_t format; // S_FORMAT_*
+    uint8_t adpcm_codec; // ADPCM_CODEC_*
+    uint8_t num_channels;
+    uint8_t reserved[3];
+} sfx_buffer_info_t;
+
+// the state of the memory pool, the pool only grows until the driver is
+// re-initialized, so the largest free block is the tail of it
+typedef struct
+{
+    uint32_t total;
+    uint32_t free;
+    uint32_t largest_free;
+    uint16_t num_buffers; // buffers holding memory
+    uint16_t reserved;
+} sfx_mem_stats_t;
+
 extern sfx_buffer_t s_buffers [ S_MAX_BUFFERS ];
 
 void S_InitBuffers(uint8_t *start_addr, uint32_t size);
 void S_ClearBuffersMem(void);
 
 void S_Buf_SetData(sfx_buffer_t *buf, uint8_t *data, uint32_t data_len);
-void S_Buf_CopyData(sfx_buffer_t *buf, const uint8_t *data, uint32_t data_len);
+// checks the data and sets aside the memory for it, so that the upload can
+// be answered before the data is copied, returns one of S_UPLOAD_*
+int S_Buf_Reserve(sfx_buffer_t *buf, const uint8_t *data, uint32_t data_len, uint16_t rate);
+// rate: if non-zero, PCM data is resampled down to the given rate, returns one of S_UPLOAD_*
+int S_Buf_CopyData(sfx_buffer_t *buf, const uint8_t *data, uint32_t data_len, uint16_t rate);
+// same as above for Kosinski compressed data, which is decompressed straight into the pool
+// unpacked_len: the size of the decompressed data
+int S_Buf_ReserveKos(sfx_buffer_t *buf, uint32_t unpacked_len);
+int S_Buf_CopyKosData(sfx_buffer_t *buf, const uint8_t *data, uint32_t unpacked_len, uint16_t rate);
+
+void S_Buf_GetMemStats(sfx_mem_stats_t *stats);
+void S_Buf_GetInfo(const sfx_buffer_t *buf, sfx_buffer_info_t *info);
 
 #endif
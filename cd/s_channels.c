@@ -76,6 +76,7 @@ void S_Chan_Init(sfx_channel_t *chan)
         return;
     }    
     chan->freq = 0;
+    chan->silent = 0; // wave memory contents are unknown
     pcm_loop_markers(CHBUF_POS(S_Chan_LoopBlock(chan)));
 }
 
@@ -99,6 +100,28 @@ uint8_t S_Chan_MidiPan(uint8_t pan)
     return right | left;
 }
 
+// updates the parameters of a running channel right away,
+// unlike S_Chan_Update it never kicks off playback
+void S_Chan_Refresh(sfx_channel_t *chan)
+{
+    if (chan->id == 0 || chan->freq == 0) {
+        return;
+    }
+
+    pcm_set_ctrl(0xC0 + chan->realid);
+
+    if (pcm_is_off(chan->realid)) {
+        return;
+    }
+
+    pcm_set_freq(chan->freq);
+
+    pcm_set_env(chan->env);
+
+    PCM_PAN = chan->pan;
+    pcm_delay();
+}
+
 void S_Chan_Update(sfx_channel_t *chan)
 {
     uint8_t startblock = S_Chan_StartBlock(chan);
@@ -152,6 +175,18 @@ int S_AllocChannel(void)
     return 0;
 }
 
+int S_NumFreeChannels(void)
+{
+    int i, num = 0;
+
+    for (i = 0; i < S_MAX_CHANNELS; i++) {
+        if (!s_channels[ i + 1 ].freq) {
+            num++;
+        }
+    }
+    return num;
+}
+
 void S_InitChannels(void)
 {
     int i;
@@ -10,6 +10,8 @@
 #define CHBUF_SIZE (1<<CHBUF_SHIFT)
 #define CHBUF_POS(b) ((b)<<CHBUF_SHIFT)
 
+#define CHBUF_SILENT_ALL 3 // both halves of the double buffer are silent
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -21,6 +23,7 @@ typedef struct
     uint16_t freq;
     uint8_t pan, env;
     int8_t backbuf;
+    uint8_t silent;     // mask of double buffer blocks known to hold only silence
 } sfx_channel_t;
 
 extern sfx_channel_t s_channels[ S_MAX_CHANNELS+1 ]; // 0 is a dummy channel
@@ -32,12 +35,14 @@ void S_Chan_Init(sfx_channel_t *src);
 void S_Chan_Clear(sfx_channel_t *src);
 void S_Chan_Paint(sfx_channel_t *src);
 void S_Chan_Update(sfx_channel_t *chan);
+void S_Chan_Refresh(sfx_channel_t *chan);
 uint16_t S_Chan_GetPosition(sfx_channel_t *src);
 int8_t S_Chan_BackBuffer(sfx_channel_t *chan);
 int8_t S_Chan_StartBlock(sfx_channel_t *chan);
 uint8_t S_Chan_MidiPan(uint8_t pan);
 
 int S_AllocChannel(void);
+int S_NumFreeChannels(void);
 
 #ifdef __cplusplus
 }
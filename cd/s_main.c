@@ -1,14 +1,37 @@
+#include <string.h>
 #include "s_sources.h"
 #include "s_channels.h"
 #include "s_buffers.h"
+#include "s_module.h"
+#include "s_trace.h"
 #include "s_main.h"
 
 #define S_MEMBANK_ADDR 0xC000 // assumed to be greater than __bss_end
-#define S_MEMBANK_PTR ((uint8_t *)S_MEMBANK_ADDR)
 #define S_MEMBANK_SIZE (0x80000 - S_MEMBANK_ADDR) // 512K - addr
 
+#ifndef PCM_HOST
+#define S_MEMBANK_PTR ((uint8_t *)S_MEMBANK_ADDR)
+#else
+static uint8_t s_membank[S_MEMBANK_SIZE];
+#define S_MEMBANK_PTR s_membank
+#endif
+
+// playback parameters for S_PlayBufferSource
+typedef struct
+{
+    uint16_t freq;
+    uint8_t pan, vol;
+    uint8_t autoloop;
+    uint8_t priority;
+    uint8_t bus;
+} sfx_play_defaults_t;
+
+static sfx_play_defaults_t s_play_defaults[ S_MAX_BUFFERS ];
+
 void S_Init(void)
 {
+    int i;
+
     pcm_init ();
     
     adpcm_init();
@@ -17,27 +40,158 @@ void S_Init(void)
 
     S_InitSources();
 
+    S_Mod_Init(&s_module);
+
     S_InitBuffers(S_MEMBANK_PTR, S_MEMBANK_SIZE);
+
+    for (i = 0; i < S_MAX_BUFFERS; i++) {
+        S_SetBufferDefaults(i + 1, 0, 255, 255, 0, S_DEFAULT_PRIORITY, S_BUS_SFX);
+    }
+
+    // the clock drives virtual sources
+    pcm_start_timer(NULL);
 }
 
 void S_Clear(void)
 {
+    S_Mod_Stop(&s_module);
+
     S_StopSources();
 
     S_ClearChannels();
 }
 
+static uint32_t s_load_start = 0;
+static sfx_load_stats_t s_load_snap;
+
+// every source that holds hardware channels is painted on each call, so that
+// refills don't wait for a turn behind idle sources, virtual ones only follow
+// the clock and take turns, one per call
 void S_Update(void)
 {
     static int s_upd = 0;
+    int i;
     sfx_source_t *src;
+    uint32_t start, busy;
+
+    // the clock only moves on timer interrupts, so single calls mostly measure
+    // as 0 or a whole timer period, but the sum is right on average
+    start = pcm_clock;
+    S_TRACE_TICKS();
+
+    S_Mod_Update(&s_module);
+
+    for (i = 0; i < S_MAX_SOURCES; i++) {
+        src = &s_sources[ i ];
+        if (src->num_channels) {
+            S_Src_Paint(src);
+        }
+    }
 
     if (s_upd >= S_MAX_SOURCES) {
         s_upd = 0;
     }
-
     src = &s_sources[ s_upd++ ];
-    S_Src_Paint(src);
+    if (!src->num_channels) {
+        S_Src_Paint(src);
+    }
+
+    S_BindVirtualSources();
+
+    busy = pcm_clock - start;
+    s_load.busy += busy;
+    if (busy > s_load.peak) {
+        s_load.peak = busy;
+    }
+}
+
+// page 0 takes a snapshot of the load counters, resetting them if requested,
+// and publishes its first 8 bytes, page 1 publishes the next 8 bytes of it
+void S_GetLoadStats(uint8_t page, uint8_t reset)
+{
+    volatile uint32_t *result = COMM_RESULT;
+
+    if (page != 0) {
+        result[0] = ((uint32_t)s_load_snap.refills << 16) | s_load_snap.underruns;
+        result[1] = ((uint32_t)s_load_snap.min_slack << 16) | s_load_snap.peak;
+        return;
+    }
+
+    s_load_snap = s_load;
+    s_load_snap.elapsed = pcm_clock - s_load_start;
+
+    if (reset) {
+        s_load_start += s_load_snap.elapsed;
+        s_load.busy = 0;
+        s_load.refills = 0;
+        s_load.underruns = 0;
+        s_load.min_slack = 0xFFFF;
+        s_load.peak = 0;
+    }
+
+    result[0] = s_load_snap.elapsed;
+    result[1] = s_load_snap.busy;
+}
+
+void S_GetVersion(void)
+{
+    COMM_RESULT[0] = S_PROTOCOL_VERSION;
+}
+
+// publishes the size of the trace dump, 0 if the driver was built without tracing
+void S_GetTrace(uint8_t *dst, uint8_t reset)
+{
+    COMM_RESULT[0] = S_Trace_Dump(dst, reset);
+}
+
+// runs the checks of ADPCM_VERIFY_DECODERS, see S_VERIFY_, and publishes the decoded
+// samples and the pcm_clock ticks spent in the asm decoders, or the mismatches for
+// S_VERIFY_ERRORS, everything reads as 0 when the driver was built without the checks
+void S_VerifyDecoders(uint8_t what, uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed)
+{
+#ifdef ADPCM_VERIFY_DECODERS
+    int i;
+
+    switch (what) {
+        case S_VERIFY_ERRORS:
+            COMM_RESULT[0] = adpcm_verify_errors;
+            COMM_RESULT[1] = 0;
+            return;
+        case S_VERIFY_BUFFERS:
+            adpcm_verify_reset();
+            for (i = 0; i < S_MAX_BUFFERS; i++) {
+                sfx_buffer_t *buf = &s_buffers[ i ];
+                sfx_adpcm_t adpcm;
+
+                if (buf->format != S_FORMAT_WAV_ADPCM || !buf->data) {
+                    continue;
+                }
+
+                memset(&adpcm, 0, sizeof(adpcm));
+                adpcm.codec = buf->adpcm_codec;
+                adpcm.block_size = buf->adpcm_block_size;
+                adpcm.channels = buf->num_channels;
+                adpcm.table = buf->adpcm_table;
+                adpcm.data = buf->data;
+                adpcm.data_end = buf->data; // force block read
+                adpcm.remaining_bytes = buf->data_len;
+                adpcm_verify_stream(&adpcm);
+            }
+            break;
+        case S_VERIFY_RANDOM:
+            adpcm_verify_reset();
+            adpcm_verify_random(codec, channels, streams, seed);
+            break;
+        default:
+            break;
+    }
+
+    COMM_RESULT[0] = adpcm_verify_samples;
+    COMM_RESULT[1] = adpcm_verify_ticks;
+#else
+    COMM_RESULT[0] = 0;
+    COMM_RESULT[1] = 0;
+#endif
 }
 
 void S_SetBufferData(uint16_t buf_id, uint8_t *data, uint32_t data_len)
@@ -48,15 +202,74 @@ void S_SetBufferData(uint16_t buf_id, uint8_t *data, uint32_t data_len)
     S_Buf_SetData(&s_buffers[ buf_id - 1 ], data, data_len);
 }
 
-void S_CopyBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len)
+// the uploads are checked and their memory set aside before they're acknowledged,
+// the data is copied after that, while the main CPU goes on
+uint8_t S_ReserveBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate)
 {
     if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        return S_UPLOAD_BAD_ID;
+    }
+    return S_Buf_Reserve(&s_buffers[ buf_id - 1 ], data, data_len, rate);
+}
+
+uint8_t S_CopyBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate)
+{
+    uint8_t res;
+
+    if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        return S_UPLOAD_BAD_ID;
+    }
+    S_TRACE_EVENT(S_TRACE_UPLOAD_BEGIN, 0, buf_id);
+    res = S_Buf_CopyData(&s_buffers[ buf_id - 1 ], data, data_len, rate);
+    S_TRACE_EVENT(S_TRACE_UPLOAD_END, res, buf_id);
+    return res;
+}
+
+uint8_t S_ReserveKosBufferData(uint16_t buf_id, uint32_t unpacked_len)
+{
+    if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        return S_UPLOAD_BAD_ID;
+    }
+    return S_Buf_ReserveKos(&s_buffers[ buf_id - 1 ], unpacked_len);
+}
+
+uint8_t S_CopyKosBufferData(uint16_t buf_id, const uint8_t *data, uint32_t unpacked_len, uint16_t rate)
+{
+    uint8_t res;
+
+    if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        return S_UPLOAD_BAD_ID;
+    }
+    S_TRACE_EVENT(S_TRACE_UPLOAD_BEGIN, 1, buf_id);
+    res = S_Buf_CopyKosData(&s_buffers[ buf_id - 1 ], data, unpacked_len, rate);
+    S_TRACE_EVENT(S_TRACE_UPLOAD_END, res, buf_id);
+    return res;
+}
+
+// publishes the free bytes of the memory pool and the largest free block, and
+// if dst isn't NULL, writes the pool stats followed by a record of every buffer
+void S_GetMemInfo(uint8_t *dst)
+{
+    int i;
+    sfx_mem_stats_t stats;
+    sfx_buffer_info_t *info;
+
+    S_Buf_GetMemStats(&stats);
+    COMM_RESULT[0] = stats.free;
+    COMM_RESULT[1] = stats.largest_free;
+
+    if (!dst) {
         return;
     }
-    S_Buf_CopyData(&s_buffers[ buf_id - 1 ], data, data_len);
+
+    memcpy(dst, &stats, sizeof(stats));
+    info = (sfx_buffer_info_t *)(dst + sizeof(stats));
+    for (i = 0; i < S_MAX_BUFFERS; i++) {
+        S_Buf_GetInfo(&s_buffers[ i ], &info[ i ]);
+    }
 }
 
-uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop)
+uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset, uint8_t bus)
 {
     sfx_source_t *src;
     sfx_buffer_t *buf;
@@ -78,7 +291,7 @@ uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan
 
     S_Src_Stop(src);
 
-    S_Src_Play(src, buf, freq, pan, vol, autoloop);
+    S_Src_Play(src, buf, freq, pan, vol, autoloop, priority, offset, bus);
 
     if (!src->buf) {
         // refused to start
@@ -87,6 +300,55 @@ uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan
     return src_id;
 }
 
+void S_SetBufferDefaults(uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint8_t bus)
+{
+    sfx_play_defaults_t *def;
+
+    if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        return;
+    }
+
+    def = &s_play_defaults[ buf_id - 1 ];
+    def->freq = freq;
+    def->pan = pan;
+    def->vol = vol;
+    def->autoloop = autoloop;
+    def->priority = priority;
+    def->bus = bus;
+}
+
+// S_PlaySource with the parameters set for the buffer with S_SetBufferDefaults
+uint8_t S_PlayBufferSource(uint8_t src_id, uint16_t buf_id)
+{
+    sfx_play_defaults_t *def;
+
+    if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        return 0;
+    }
+
+    def = &s_play_defaults[ buf_id - 1 ];
+    return S_PlaySource(src_id, buf_id, def->freq, def->pan, def->vol, def->autoloop, def->priority, 0, def->bus);
+}
+
+// stops the running module if buf_id is 0, returns 0 if the module can't be played
+uint8_t S_PlayModule(uint16_t buf_id, uint8_t first_src, uint8_t priority, uint8_t loop)
+{
+    sfx_buffer_t *buf;
+
+    if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        S_Mod_Stop(&s_module);
+        return 0;
+    }
+
+    buf = &s_buffers[ buf_id - 1 ];
+    return S_Mod_Play(&s_module, buf->data, buf->data_len, first_src, priority, loop);
+}
+
+uint16_t S_GetModulePosition(void)
+{
+    return S_Mod_GetPosition(&s_module);
+}
+
 void S_UpdateSource(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop)
 {
     sfx_source_t *src = &s_sources[ src_id - 1 ];
@@ -97,6 +359,16 @@ void S_UpdateSource(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vol, uin
     S_Src_Update(src, freq, pan, vol, autoloop);
 }
 
+void S_AutomateSource(uint8_t src_id, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags)
+{
+    sfx_source_t *src = &s_sources[ src_id - 1 ];
+
+    if (src_id == 0 || src_id > S_MAX_SOURCES) {
+        return;
+    }
+    S_Src_Automate(src, param, target, duration, curve, flags);
+}
+
 void S_RewindSource(uint8_t src_id)
 {
     sfx_source_t *src = &s_sources[ src_id - 1 ];
@@ -107,6 +379,16 @@ void S_RewindSource(uint8_t src_id)
     S_Src_Rewind(src);
 }
 
+void S_SeekSource(uint8_t src_id, uint32_t pos)
+{
+    sfx_source_t *src = &s_sources[ src_id - 1 ];
+
+    if (src_id == 0 || src_id > S_MAX_SOURCES) {
+        return;
+    }
+    S_Src_Seek(src, pos);
+}
+
 void S_PUnPSource(uint8_t src_id, uint8_t pause)
 {
     sfx_source_t *src = &s_sources[ src_id - 1 ];
@@ -117,6 +399,29 @@ void S_PUnPSource(uint8_t src_id, uint8_t pause)
     S_Src_SetPause(src, pause);
 }
 
+// bit N of the mask stands for source N+1
+void S_PUnPSourceSet(uint32_t mask, uint8_t pause)
+{
+    int i;
+
+    for (i = 0; i < S_MAX_SOURCES; i++) {
+        if (mask & ((uint32_t)1 << i)) {
+            S_Src_SetPause(&s_sources[ i ], pause);
+        }
+    }
+}
+
+void S_StopSourceSet(uint32_t mask)
+{
+    int i;
+
+    for (i = 0; i < S_MAX_SOURCES; i++) {
+        if (mask & ((uint32_t)1 << i)) {
+            S_Src_Stop(&s_sources[ i ]);
+        }
+    }
+}
+
 void S_StopSource(uint8_t src_id)
 {
     sfx_source_t *src = &s_sources[ src_id - 1 ];
@@ -136,3 +441,25 @@ uint16_t S_GetSourcePosition(uint8_t src_id)
     }
     return S_Src_GetPosition(src);
 }
+
+uint32_t S_GetSourceSamplePosition(uint8_t src_id)
+{
+    sfx_source_t *src = &s_sources[ src_id - 1 ];
+
+    if (src_id == 0 || src_id > S_MAX_SOURCES) {
+        return 0;
+    }
+    return S_Src_GetSamplePosition(src);
+}
+
+// applies the same change to every bus in the mask, bit N standing for bus N
+void S_SetBuses(uint8_t mask, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused)
+{
+    int i;
+
+    for (i = 0; i < S_MAX_BUSES; i++) {
+        if (mask & (1 << i)) {
+            S_SetBus(&s_buses[ i ], what, vol, duck, paused);
+        }
+    }
+}
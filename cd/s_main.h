@@ -3,6 +3,18 @@
 
 #include <stdint.h>
 
+// bumped on every change to the command set, see S_GetVersion
+#define S_PROTOCOL_VERSION 5
+
+// S_VerifyDecoders requests
+enum
+{
+    S_VERIFY_STATS,     // the counters as they are, decoding sources updates them
+    S_VERIFY_ERRORS,    // the mismatches counted so far
+    S_VERIFY_BUFFERS,   // reset the counters and check every ADPCM buffer
+    S_VERIFY_RANDOM,    // reset the counters and check random streams of a codec
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -13,15 +25,34 @@ void S_Clear(void);
 
 void S_Update(void);
 
-void S_SetBufferData(uint16_t buf_id, uint8_t *data, uint32_t data_len);
-void S_CopyBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len);
+void S_GetLoadStats(uint8_t page, uint8_t reset);
+void S_GetVersion(void);
+void S_GetTrace(uint8_t *dst, uint8_t reset);
+void S_VerifyDecoders(uint8_t what, uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed);
 
-uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop);
+void S_SetBufferData(uint16_t buf_id, uint8_t *data, uint32_t data_len);
+uint8_t S_ReserveBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate);
+uint8_t S_CopyBufferData(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate);
+uint8_t S_ReserveKosBufferData(uint16_t buf_id, uint32_t unpacked_len);
+uint8_t S_CopyKosBufferData(uint16_t buf_id, const uint8_t *data, uint32_t unpacked_len, uint16_t rate);
+void S_GetMemInfo(uint8_t *dst);
+
+uint8_t S_PlaySource(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset, uint8_t bus);
+uint8_t S_PlayBufferSource(uint8_t src_id, uint16_t buf_id);
+void S_SetBufferDefaults(uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint8_t bus);
+uint8_t S_PlayModule(uint16_t buf_id, uint8_t first_src, uint8_t priority, uint8_t loop);
+uint16_t S_GetModulePosition(void);
 void S_UpdateSource(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop);
+void S_AutomateSource(uint8_t src_id, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags);
 void S_RewindSource(uint8_t src_id);
+void S_SeekSource(uint8_t src_id, uint32_t pos);
 void S_StopSource(uint8_t src_id);
 void S_PUnPSource(uint8_t src_id, uint8_t pause);
+void S_PUnPSourceSet(uint32_t mask, uint8_t pause);
+void S_StopSourceSet(uint32_t mask);
 uint16_t S_GetSourcePosition(uint8_t src_id);
+uint32_t S_GetSourceSamplePosition(uint8_t src_id);
+void S_SetBuses(uint8_t mask, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,624 @@
+#include "s_module.h"
+#include "s_sources.h"
+#include "s_buffers.h"
+#include "pcm.h"
+
+// timer ticks that can pile up while the main loop is busy, e.g. with an upload,
+// older ones are dropped so that the module slows down rather than rushes ahead
+#define S_MOD_MAX_LAG 4
+
+#define S_Mod_Word(p) (((uint16_t)(p)[0] << 8) | (p)[1])
+#define S_Mod_Long(p) (((uint32_t)S_Mod_Word(p) << 16) | S_Mod_Word((p) + 2))
+
+#define S_Mod_Inst(mod, n) ((mod)->insts + ((n) - 1) * S_MOD_INST_SIZE)
+
+// the number of bytes that follow the field mask of a cell
+#define S_Mod_CellSize(fields) ( \
+    (((fields) & S_MOD_CELL_NOTE) ? 2 : 0) + \
+    (((fields) & S_MOD_CELL_INST) ? 1 : 0) + \
+    (((fields) & S_MOD_CELL_VOL) ? 1 : 0) + \
+    (((fields) & S_MOD_CELL_FX) ? 2 : 0))
+
+sfx_module_t s_module = { 0 };
+
+// bumped by the timer interrupt, which leaves the rest to S_Mod_Update
+static volatile uint8_t s_mod_ticks = 0;
+
+// 2^(n/12) in 4.12 fixed point, for arpeggios
+static const uint16_t s_mod_semitones[16] = {
+    4096, 4340, 4598, 4871, 5161, 5468, 5793, 6137,
+    6502, 6889, 7298, 7732, 8192, 8679, 9195, 9742
+};
+
+static const uint8_t s_mod_sine[32] = {
+    0, 24, 49, 74, 97, 120, 141, 161, 180, 197, 212, 224, 235, 244, 250, 253,
+    255, 253, 250, 244, 235, 224, 212, 197, 180, 161, 141, 120, 97, 74, 49, 24
+};
+
+static void S_Mod_TimerTick(void)
+{
+    s_mod_ticks++;
+}
+
+static uint16_t S_Mod_ClampPeriod(int32_t period)
+{
+    if (period < S_MOD_MIN_PERIOD) {
+        return S_MOD_MIN_PERIOD;
+    }
+    if (period > S_MOD_MAX_PERIOD) {
+        return S_MOD_MAX_PERIOD;
+    }
+    return period;
+}
+
+static uint8_t S_Mod_ClampVolume(int16_t vol)
+{
+    if (vol < 0) {
+        return 0;
+    }
+    if (vol > 64) {
+        return 64;
+    }
+    return vol;
+}
+
+// 0-64 to 0-255
+#define S_Mod_Env(vol) (((vol) << 2) - ((vol) >> 6))
+
+static uint16_t S_Mod_Freq(uint16_t period, uint8_t semitones)
+{
+    uint32_t freq;
+
+    if (period < S_MOD_MIN_PERIOD / 2) {
+        period = S_MOD_MIN_PERIOD / 2;
+    }
+    freq = S_MOD_PAULA_CLOCK / period;
+    if (semitones) {
+        freq = (freq * s_mod_semitones[semitones]) >> 12;
+    }
+    return freq > 0xFFFF ? 0xFFFF : freq;
+}
+
+// restarts the instrument of the channel at the given sample
+static void S_Mod_Trigger(sfx_module_t *mod, sfx_mod_channel_t *ch, uint32_t offset)
+{
+    const uint8_t *inst;
+    uint8_t buf_id;
+
+    if (ch->inst == 0) {
+        return;
+    }
+
+    inst = S_Mod_Inst(mod, ch->inst);
+    buf_id = inst[0];
+    if (buf_id == 0 || buf_id > S_MAX_BUFFERS) {
+        return;
+    }
+
+    S_Src_Stop(ch->src);
+    S_Src_Play(ch->src, &s_buffers[ buf_id - 1 ], S_Mod_Freq(ch->period, 0), ch->pan, S_Mod_Env(ch->vol),
+        inst[2] & S_MOD_INST_LOOP, mod->priority, offset, S_BUS_MUSIC);
+
+    // start painting right away, rather than on the next turn of the source
+    S_Src_Paint(ch->src);
+}
+
+// applies the pitch and the volume of the channel to the chip
+static void S_Mod_Apply(sfx_mod_channel_t *ch, uint16_t period, uint8_t semitones)
+{
+    sfx_source_t *src = ch->src;
+
+    if (!src->buf) {
+        return;
+    }
+    S_Src_Update(src, S_Mod_Freq(period, semitones), ch->pan, S_Mod_Env(ch->vol), src->autoloop);
+    S_Src_Refresh(src);
+}
+
+static void S_Mod_Porta(sfx_mod_channel_t *ch)
+{
+    if (ch->target == 0) {
+        return;
+    }
+    if (ch->period < ch->target) {
+        ch->period += ch->porta_speed;
+        if (ch->period > ch->target) {
+            ch->period = ch->target;
+        }
+    } else if (ch->period > ch->target) {
+        ch->period = ch->period > ch->target + ch->porta_speed ? ch->period - ch->porta_speed : ch->target;
+    }
+}
+
+static void S_Mod_VolSlide(sfx_mod_channel_t *ch)
+{
+    if (ch->param & 0xF0) {
+        ch->vol = S_Mod_ClampVolume(ch->vol + (ch->param >> 4));
+    } else {
+        ch->vol = S_Mod_ClampVolume(ch->vol - (ch->param & 0x0F));
+    }
+}
+
+static uint16_t S_Mod_Vibrato(sfx_mod_channel_t *ch)
+{
+    int16_t delta = (s_mod_sine[ ch->vib_pos & 31 ] * ch->vib_depth) >> 7;
+
+    if (ch->vib_pos & 32) {
+        delta = -delta;
+    }
+    ch->vib_pos = (ch->vib_pos + ch->vib_speed) & 63;
+    return S_Mod_ClampPeriod(ch->period + delta);
+}
+
+// returns the start of the row that follows the one at p,
+// or NULL if the row runs past the end of the module
+static const uint8_t *S_Mod_SkipRow(sfx_module_t *mod, const uint8_t *p)
+{
+    const uint8_t *end = mod->data + mod->data_len;
+    uint8_t mask, fields;
+    int j;
+
+    if (p >= end) {
+        return NULL;
+    }
+    mask = *p++;
+    for (j = 0; j < mod->num_channels; j++) {
+        if (!(mask & (1 << j))) {
+            continue;
+        }
+        if (p >= end) {
+            return NULL;
+        }
+        fields = *p++;
+        if (end - p < S_Mod_CellSize(fields)) {
+            return NULL;
+        }
+        p += S_Mod_CellSize(fields);
+    }
+    return p;
+}
+
+// positions the module at the given row of the given order list entry,
+// returns 0 if the pattern runs past the end of the module before that
+static int S_Mod_Seek(sfx_module_t *mod, uint8_t order, uint8_t rownum)
+{
+    const uint8_t *p;
+    uint8_t pattern;
+    int i;
+
+    pattern = mod->orders[ order ];
+    if (pattern >= mod->num_patterns) {
+        pattern = 0;
+    }
+    p = mod->data + S_Mod_Long(mod->patterns + pattern * 4);
+
+    if (rownum >= S_MOD_ROWS) {
+        rownum = 0;
+    }
+    for (i = 0; i < rownum; i++) {
+        p = S_Mod_SkipRow(mod, p);
+        if (!p) {
+            return 0;
+        }
+    }
+
+    mod->order = order;
+    mod->rownum = rownum;
+    mod->row = p;
+    return 1;
+}
+
+// the first tick of a row
+static void S_Mod_Cell(sfx_module_t *mod, sfx_mod_channel_t *ch, uint8_t fields, const uint8_t *p)
+{
+    uint16_t note = 0;
+    uint8_t trigger = 0;
+    uint32_t offset = 0;
+    uint8_t x, y;
+
+    ch->fx = 0;
+    ch->param = 0;
+
+    if (fields & S_MOD_CELL_NOTE) {
+        note = S_Mod_Word(p);
+        p += 2;
+    }
+    if (fields & S_MOD_CELL_INST) {
+        uint8_t inst = *p++;
+        if (inst > 0 && inst <= mod->num_insts) {
+            ch->inst = inst;
+            ch->vol = S_Mod_ClampVolume(S_Mod_Inst(mod, inst)[1]);
+        }
+    }
+    if (fields & S_MOD_CELL_VOL) {
+        ch->vol = S_Mod_ClampVolume(*p++);
+    }
+    if (fields & S_MOD_CELL_FX) {
+        ch->fx = p[0];
+        ch->param = p[1];
+    }
+
+    x = ch->param >> 4;
+    y = ch->param & 0x0F;
+
+    if (note) {
+        if (ch->fx == 0x3 || ch->fx == 0x5) {
+            ch->target = note;
+        } else if (ch->fx == 0xE && x == 0xD && y != 0) {
+            ch->delayed = note;
+        } else {
+            ch->period = note;
+            ch->vib_pos = 0;
+            trigger = 1;
+        }
+    }
+
+    switch (ch->fx) {
+        case 0x3:
+            if (ch->param) {
+                ch->porta_speed = ch->param;
+            }
+            break;
+        case 0x4:
+            if (x) {
+                ch->vib_speed = x;
+            }
+            if (y) {
+                ch->vib_depth = y;
+            }
+            break;
+        case 0x8:
+            ch->pan = ch->param == 255 ? 254 : ch->param;
+            break;
+        case 0x9:
+            if (ch->param) {
+                ch->offset = ch->param;
+            }
+            offset = (uint32_t)ch->offset << 8;
+            break;
+        case 0xB:
+            mod->jump = ch->param;
+            break;
+        case 0xC:
+            ch->vol = S_Mod_ClampVolume(ch->param);
+            break;
+        case 0xD:
+            mod->brk = x * 10 + y;
+            break;
+        case 0xE:
+            switch (x) {
+                case 0x1:
+                    ch->period = S_Mod_ClampPeriod(ch->period - y);
+                    break;
+                case 0x2:
+                    ch->period = S_Mod_ClampPeriod(ch->period + y);
+                    break;
+                case 0xA:
+                    ch->vol = S_Mod_ClampVolume(ch->vol + y);
+                    break;
+                case 0xB:
+                    ch->vol = S_Mod_ClampVolume(ch->vol - y);
+                    break;
+                case 0xC:
+                    if (y == 0) {
+                        ch->vol = 0;
+                    }
+                    break;
+            }
+            break;
+        case 0xF:
+            if (ch->param == 0) {
+                break;
+            }
+            if (ch->param < 32) {
+                mod->speed = ch->param;
+            } else {
+                mod->tempo = ch->param;
+                pcm_set_timer(mod->tempo);
+            }
+            break;
+    }
+
+    if (trigger) {
+        S_Mod_Trigger(mod, ch, offset);
+    } else {
+        S_Mod_Apply(ch, ch->period, 0);
+    }
+}
+
+static void S_Mod_Row(sfx_module_t *mod)
+{
+    const uint8_t *p = mod->row;
+    const uint8_t *next = S_Mod_SkipRow(mod, p);
+    uint8_t mask;
+    int i;
+
+    if (!next) {
+        // a broken module, stop rather than play whatever follows it
+        S_Mod_Stop(mod);
+        return;
+    }
+
+    mask = *p++;
+
+    for (i = 0; i < mod->num_channels; i++) {
+        sfx_mod_channel_t *ch = &mod->chan[ i ];
+        uint8_t fields = 0;
+
+        if (mask & (1 << i)) {
+            fields = *p++;
+        }
+        S_Mod_Cell(mod, ch, fields, p);
+
+        p += S_Mod_CellSize(fields);
+    }
+
+    mod->row = next;
+}
+
+// the other ticks of a row
+static void S_Mod_Effects(sfx_module_t *mod)
+{
+    int i;
+
+    for (i = 0; i < mod->num_channels; i++) {
+        sfx_mod_channel_t *ch = &mod->chan[ i ];
+        uint16_t period = ch->period;
+        uint8_t semitones = 0;
+        uint8_t x = ch->param >> 4, y = ch->param & 0x0F;
+
+        switch (ch->fx) {
+            case 0x0:
+                if (ch->param == 0) {
+                    continue;
+                }
+                switch (mod->tick % 3) {
+                    case 1:
+                        semitones = x;
+                        break;
+                    case 2:
+                        semitones = y;
+                        break;
+                }
+                break;
+            case 0x1:
+                ch->period = period = S_Mod_ClampPeriod(ch->period - ch->param);
+                break;
+            case 0x2:
+                ch->period = period = S_Mod_ClampPeriod(ch->period + ch->param);
+                break;
+            case 0x3:
+                S_Mod_Porta(ch);
+                period = ch->period;
+                break;
+            case 0x4:
+                period = S_Mod_Vibrato(ch);
+                break;
+            case 0x5:
+                S_Mod_Porta(ch);
+                S_Mod_VolSlide(ch);
+                period = ch->period;
+                break;
+            case 0x6:
+                period = S_Mod_Vibrato(ch);
+                S_Mod_VolSlide(ch);
+                break;
+            case 0xA:
+                S_Mod_VolSlide(ch);
+                break;
+            case 0xE:
+                if (x == 0x9 && y != 0 && mod->tick % y == 0) {
+                    S_Mod_Trigger(mod, ch, 0);
+                    continue;
+                }
+                if (x == 0xC && mod->tick == y) {
+                    ch->vol = 0;
+                    break;
+                }
+                if (x == 0xD && mod->tick == y && ch->delayed) {
+                    ch->period = ch->delayed;
+                    ch->delayed = 0;
+                    ch->vib_pos = 0;
+                    S_Mod_Trigger(mod, ch, 0);
+                }
+                continue;
+            default:
+                continue;
+        }
+
+        S_Mod_Apply(ch, period, semitones);
+    }
+}
+
+static void S_Mod_NextRow(sfx_module_t *mod)
+{
+    int order = mod->order;
+    int rownum = mod->rownum + 1;
+
+    if (mod->jump >= 0 || mod->brk >= 0) {
+        order = mod->jump >= 0 ? mod->jump : order + 1;
+        rownum = mod->brk >= 0 ? mod->brk : 0;
+        mod->jump = mod->brk = -1;
+    } else if (rownum < S_MOD_ROWS) {
+        mod->rownum = rownum;
+        return;
+    } else {
+        order++;
+        rownum = 0;
+    }
+
+    if (order >= mod->num_orders) {
+        if (!mod->loop) {
+            S_Mod_Stop(mod);
+            return;
+        }
+        order = mod->restart < mod->num_orders ? mod->restart : 0;
+    }
+
+    if (!S_Mod_Seek(mod, order, rownum)) {
+        S_Mod_Stop(mod);
+    }
+}
+
+static void S_Mod_Tick(sfx_module_t *mod)
+{
+    if (mod->tick == 0) {
+        S_Mod_Row(mod);
+        if (!mod->playing) {
+            return;
+        }
+    } else {
+        S_Mod_Effects(mod);
+    }
+
+    if (++mod->tick >= mod->speed) {
+        mod->tick = 0;
+        S_Mod_NextRow(mod);
+    }
+}
+
+void S_Mod_Init(sfx_module_t *mod)
+{
+    mod->playing = 0;
+    mod->num_channels = 0;
+}
+
+// channels play on sources first_src and up, returns 0 if the module is broken
+int S_Mod_Play(sfx_module_t *mod, const uint8_t *data, uint32_t data_len, uint8_t first_src, uint8_t priority, uint8_t loop)
+{
+    const uint8_t *p;
+    uint32_t size;
+    int i;
+
+    S_Mod_Stop(mod);
+
+    if (!data || data_len < S_MOD_HEADER_SIZE) {
+        return 0;
+    }
+    if (data[0] != 'S' || data[1] != 'C' || data[2] != 'D' || data[3] != 'M') {
+        return 0;
+    }
+
+    mod->num_channels = data[4];
+    mod->num_insts = data[5];
+    mod->num_orders = data[6];
+    mod->restart = data[7];
+    mod->num_patterns = data[8];
+    mod->speed = data[9] ? data[9] : 6;
+    mod->tempo = data[10] >= 32 ? data[10] : 125;
+
+    if (mod->num_channels == 0 || mod->num_channels > S_MOD_MAX_CHANNELS) {
+        return 0;
+    }
+    if (first_src == 0 || first_src + mod->num_channels - 1 > S_MAX_SOURCES) {
+        return 0;
+    }
+    if (mod->num_orders == 0 || mod->num_patterns == 0) {
+        return 0;
+    }
+
+    size = S_MOD_HEADER_SIZE + mod->num_insts * S_MOD_INST_SIZE + ((mod->num_orders + 1) & ~1) + mod->num_patterns * 4;
+    if (size > data_len) {
+        return 0;
+    }
+
+    mod->data = data;
+    mod->data_len = data_len;
+    mod->insts = data + S_MOD_HEADER_SIZE;
+    mod->orders = mod->insts + mod->num_insts * S_MOD_INST_SIZE;
+    mod->patterns = mod->orders + ((mod->num_orders + 1) & ~1);
+
+    for (i = 0; i < mod->num_patterns; i++) {
+        // the smallest pattern has a byte for each of its empty rows
+        if (S_Mod_Long(mod->patterns + i * 4) + S_MOD_ROWS > data_len) {
+            return 0;
+        }
+    }
+
+    // the loops of the instruments are set on their buffers
+    for (i = 1, p = mod->insts; i <= mod->num_insts; i++, p += S_MOD_INST_SIZE) {
+        if (p[0] == 0 || p[0] > S_MAX_BUFFERS) {
+            continue;
+        }
+        s_buffers[ p[0] - 1 ].loop_start = (p[2] & S_MOD_INST_LOOP) ? S_Mod_Long(p + 4) : 0;
+    }
+
+    for (i = 0; i < mod->num_channels; i++) {
+        sfx_mod_channel_t *ch = &mod->chan[ i ];
+
+        ch->src = &s_sources[ first_src - 1 + i ];
+        ch->inst = 0;
+        ch->vol = 64;
+        ch->pan = ((i + 1) & 2) ? 192 : 64; // LRRL, like on the Amiga
+        ch->fx = ch->param = 0;
+        ch->period = ch->target = ch->delayed = 0;
+        ch->porta_speed = 0;
+        ch->vib_speed = ch->vib_depth = ch->vib_pos = 0;
+        ch->offset = 0;
+    }
+
+    mod->priority = priority;
+    mod->loop = loop;
+    mod->tick = 0;
+    mod->jump = mod->brk = -1;
+    if (!S_Mod_Seek(mod, 0, 0)) {
+        return 0;
+    }
+
+    mod->done = s_mod_ticks;
+    mod->playing = 1;
+
+    // the timer ticks at 2 * tempo / 5 Hz, same as on the Amiga
+    pcm_start_timer(S_Mod_TimerTick);
+    pcm_set_timer(mod->tempo);
+    return 1;
+}
+
+void S_Mod_Stop(sfx_module_t *mod)
+{
+    int i;
+
+    if (!mod->playing) {
+        return;
+    }
+
+    mod->playing = 0;
+
+    // keep the timer running for the clock
+    pcm_start_timer(NULL);
+
+    for (i = 0; i < mod->num_channels; i++) {
+        S_Src_Stop(mod->chan[ i ].src);
+    }
+}
+
+// catches up with the timer, called from the main loop so that
+// the interrupt handler never has to touch the PCM chip
+void S_Mod_Update(sfx_module_t *mod)
+{
+    uint8_t ticks;
+
+    if (!mod->playing) {
+        return;
+    }
+
+    ticks = s_mod_ticks - mod->done;
+    if (ticks > S_MOD_MAX_LAG) {
+        mod->done += ticks - S_MOD_MAX_LAG;
+        ticks = S_MOD_MAX_LAG;
+    }
+
+    while (ticks-- > 0 && mod->playing) {
+        S_Mod_Tick(mod);
+        mod->done++;
+    }
+}
+
+// order list entry in the high byte, row in the low one, 0xFFFF if stopped
+uint16_t S_Mod_GetPosition(sfx_module_t *mod)
+{
+    if (!mod->playing) {
+        return 0xFFFF;
+    }
+    return ((uint16_t)mod->order << 8) | mod->rownum;
+}
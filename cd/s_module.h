@@ -0,0 +1,106 @@
+#ifndef _S_MODULE_H
+#define _S_MODULE_H
+
+#include <stdint.h>
+
+#include "s_sources.h"
+
+// a tracker module, converted from a ProTracker MOD by tools/modconv and uploaded
+// as a buffer, the instruments are uploaded as buffers of their own, all the fields
+// are big endian:
+//
+// 0: "SCDM"
+// 4: number of channels, [1, S_MOD_MAX_CHANNELS]
+// 5: number of instruments
+// 6: number of entries in the order list
+// 7: order list entry to restart from at the end of the list
+// 8: number of patterns
+// 9: initial speed, in ticks per row
+// 10: initial tempo, in BPM
+// 11: reserved, 0
+// 12: instruments, S_MOD_INST_SIZE bytes each:
+//     0: buffer id, 0 for none
+//     1: default volume, [0, 64]
+//     2: S_MOD_INST_LOOP if the sample loops
+//     3: reserved, 0
+//     4: 32-bit loop start, in samples, the loop runs to the end of the buffer
+// then: the order list, one pattern number per entry, padded to an even length
+// then: 32-bit offsets of the patterns from the start of the module
+//
+// a pattern has S_MOD_ROWS rows, each row starts with a mask of the channels that
+// have a cell on it, then come the cells of these channels, lowest first: a mask
+// of the fields present, followed by the fields in the order of their bits:
+//
+// S_MOD_CELL_NOTE: 16-bit Amiga period, with the finetune of the instrument applied
+// S_MOD_CELL_INST: instrument number, starting from 1
+// S_MOD_CELL_VOL: volume, [0, 64]
+// S_MOD_CELL_FX: ProTracker effect number and its parameter
+
+#define S_MOD_HEADER_SIZE   12
+#define S_MOD_INST_SIZE     8
+#define S_MOD_MAX_CHANNELS  8
+#define S_MOD_ROWS          64
+
+#define S_MOD_INST_LOOP     1
+
+#define S_MOD_CELL_NOTE     1
+#define S_MOD_CELL_INST     2
+#define S_MOD_CELL_VOL      4
+#define S_MOD_CELL_FX       8
+
+#define S_MOD_MIN_PERIOD    113
+#define S_MOD_MAX_PERIOD    856
+#define S_MOD_PAULA_CLOCK   3546895 // PAL Amiga, sample rate = clock / period
+
+typedef struct
+{
+    sfx_source_t *src;
+    uint8_t inst;
+    uint8_t vol;
+    uint8_t pan;
+    uint8_t fx, param;
+    uint16_t period;
+    uint16_t target;    // tone portamento target
+    uint16_t delayed;   // note held back by EDx
+    uint8_t porta_speed;
+    uint8_t vib_speed, vib_depth, vib_pos;
+    uint8_t offset;     // last 9xx parameter
+} sfx_mod_channel_t;
+
+typedef struct
+{
+    const uint8_t *data;
+    uint32_t data_len;
+    const uint8_t *insts;
+    const uint8_t *orders;
+    const uint8_t *patterns;
+    const uint8_t *row; // next row to read
+    uint8_t num_channels, num_insts, num_orders, num_patterns;
+    uint8_t restart;
+    uint8_t speed, tempo;
+    uint8_t order, rownum, tick;
+    int16_t jump, brk; // position change at the end of the row, -1 if none
+    uint8_t priority;
+    uint8_t loop;
+    uint8_t playing;
+    uint8_t done; // timer ticks processed
+    sfx_mod_channel_t chan[S_MOD_MAX_CHANNELS];
+} sfx_module_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern sfx_module_t s_module;
+
+void S_Mod_Init(sfx_module_t *mod);
+int S_Mod_Play(sfx_module_t *mod, const uint8_t *data, uint32_t data_len, uint8_t first_src, uint8_t priority, uint8_t loop);
+void S_Mod_Stop(sfx_module_t *mod);
+void S_Mod_Update(sfx_module_t *mod);
+uint16_t S_Mod_GetPosition(sfx_module_t *mod);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
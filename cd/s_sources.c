@@ -1,21 +1,46 @@
 #include "s_sources.h"
 #include "s_channels.h"
 #include "s_buffers.h"
+#include "s_trace.h"
 #include "pcm.h"
 
 #define S_PAINT_CHUNK   CHBUF_SIZE // the number of samples to paint in a single call of S_Src_Paint
 
+#define S_Src_Bus(src) (&s_buses[ (src)->bus ])
+
+// paused on its own or along with its bus
+#define S_Src_IsPaused(src) ((src)->paused || S_Src_Bus(src)->paused)
+
+// the env written to the channels, scaled by the gain of the bus
+#define S_Src_Env(src) (((uint16_t)(src)->env * (S_Src_Bus(src)->gain + 1)) >> 8)
+
+// sources with higher priority win, ties are broken by volume
+#define S_Src_Audibility(src) (((uint16_t)(src)->priority << 8) | (S_Src_IsPaused(src) ? 0 : S_Src_Env(src)))
+
 sfx_source_t s_sources[ S_MAX_SOURCES ] = { { 0 } };
 
+sfx_bus_t s_buses[ S_MAX_BUSES ];
+
+sfx_load_stats_t s_load = { 0, 0, 0, 0, 0xFFFF, 0 };
+
+static int s_num_virtual = 0;
+
 void S_Src_Init(sfx_source_t *src)
 {
     src->buf = NULL;
     src->num_channels = 0;
+    src->channels[0] = 0;
+    src->pending = 0;
+    src->handover = 0;
+    src->priority = S_DEFAULT_PRIORITY;
     src->rem = 0;
     src->eof = 0;
     src->backbuf = -1;
 }
 
+static void S_Src_DropPending(sfx_source_t *src);
+static void S_Src_HandOver(sfx_source_t *src);
+
 void S_Src_Stop(sfx_source_t *src)
 {
     int i;
@@ -24,6 +49,13 @@ void S_Src_Stop(sfx_source_t *src)
         return;
     }
 
+    S_TRACE_EVENT(S_TRACE_STOP, src->id, 0);
+
+    S_Src_DropPending(src);
+    if (src->handover) {
+        S_Src_HandOver(src);
+    }
+
     for (i = 0; i < src->num_channels; i++) {
         S_Chan_Clear( &s_channels[ src->channels[ i ] ] );
     }
@@ -31,6 +63,7 @@ void S_Src_Stop(sfx_source_t *src)
     src->buf = NULL;
     src->freq = 0;
     src->painted = 0;
+    src->automated = 0;
     src->num_channels = 0;
     src->rem = 0;
     src->eof = 1;
@@ -58,6 +91,414 @@ void S_Src_Rewind(sfx_source_t *src)
     }
 }
 
+// interpolated value of an automated parameter at the given time
+static uint16_t S_Auto_Value(sfx_automation_t *a, uint32_t now)
+{
+    uint32_t elapsed = now - a->start;
+    int32_t delta = (int32_t)a->to - a->from;
+    uint16_t t;
+
+    if (elapsed >= a->length) {
+        return a->to;
+    }
+
+    t = (elapsed << 8) / a->length; // [0, 256)
+    if (a->curve == S_CURVE_EXP) {
+        if (delta < 0) {
+            // fast attack for fade outs
+            t = 256 - t;
+            t = 256 - ((t * t) >> 8);
+        } else {
+            t = (t * t) >> 8;
+        }
+    }
+
+    return a->from + ((delta * t) >> 8);
+}
+
+// steps parameter automation for the source, returns 0 if the source has been stopped
+static int S_Src_RunAutomation(sfx_source_t *src)
+{
+    int i;
+    uint16_t value;
+    uint32_t now;
+    sfx_automation_t *a;
+
+    if (!src->automated) {
+        return 1;
+    }
+
+    now = pcm_clock;
+    for (i = 0, a = src->automation; i < S_NUM_AUTO_PARAMS; i++, a++) {
+        if (!(src->automated & (1<<i))) {
+            continue;
+        }
+
+        value = S_Auto_Value(a, now);
+        switch (i) {
+            case S_AUTO_ENV:
+                src->env = value;
+                break;
+            case S_AUTO_PAN:
+                src->midipan = value;
+                if (src->buf->num_channels == 1) {
+                    src->pan[0] = S_Chan_MidiPan(value);
+                }
+                break;
+            case S_AUTO_FREQ:
+                src->freq = value;
+                break;
+        }
+
+        if (now - a->start >= a->length) {
+            src->automated &= ~(1<<i);
+            if (a->flags & S_AUTO_STOP) {
+                S_Src_Stop(src);
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// moves the source position forward without painting, returns the
+// number of samples actually skipped, which is less than len on EOF
+uint32_t S_Src_Skip(sfx_source_t *src, uint32_t len)
+{
+    sfx_buffer_t *buf = src->buf;
+    uint32_t avail;
+
+    switch (buf->format) {
+        case S_FORMAT_RAW_U8:
+        case S_FORMAT_RAW_SM:
+            avail = buf->data_len - src->data_pos;
+            if (buf->num_channels == 2) {
+                avail >>= 1;
+            }
+            if (len > avail) {
+                len = avail;
+            }
+            src->data_pos += buf->num_channels == 2 ? len*2 : len;
+            return len;
+
+        case S_FORMAT_WAV_ADPCM:
+            return adpcm_skip_samples(&src->adpcm, len);
+    }
+
+    return 0;
+}
+
+// moves the source to the given sample, the new position
+// is heard starting from the next refilled block
+void S_Src_Seek(sfx_source_t *src, uint32_t pos)
+{
+    if (!src->buf) {
+        return;
+    }
+
+    S_Src_Rewind(src);
+    src->painted = pos ? S_Src_Skip(src, pos) : 0;
+    src->cursor = src->painted;
+    if (src->eof == 1) {
+        // not yet padded to the end, resume painting
+        src->eof = 0;
+    }
+}
+
+// restarts the source from the loop point of its buffer
+static void S_Src_Loop(sfx_source_t *src)
+{
+    src->painted = 0;
+    S_Src_Rewind(src);
+    if (src->buf->loop_start) {
+        S_Src_Skip(src, src->buf->loop_start);
+    }
+}
+
+// advances a virtual source by the amount of time that has passed
+// since the previous call, so that it resumes at the right position
+// once it gets hardware channels back
+static void S_Src_Advance(sfx_source_t *src)
+{
+    uint32_t now = pcm_clock;
+    uint32_t ticks = now - src->vclock;
+    uint32_t len, skipped;
+
+    src->vclock = now;
+    if (!S_Src_RunAutomation(src)) {
+        return;
+    }
+    if (S_Src_IsPaused(src)) {
+        return;
+    }
+
+    if (ticks > 0xffff) {
+        ticks = 0xffff;
+    }
+    src->vacc += ticks * src->freq;
+    len = src->vacc / PCM_CLOCK_RATE;
+    src->vacc -= len * PCM_CLOCK_RATE;
+
+    while (len > 0) {
+        skipped = S_Src_Skip(src, len);
+        src->painted += skipped;
+        src->cursor += skipped;
+        len -= skipped;
+        if (len == 0) {
+            break;
+        }
+
+        // auto-restart only if we have previously played at least 1 sample
+        if (!src->autoloop || !src->painted) {
+            S_Src_Stop(src);
+            return;
+        }
+        S_Src_Loop(src);
+    }
+}
+
+// nothing of the source has been painted to its channels yet
+static void S_Src_ResetBlocks(sfx_source_t *src)
+{
+    src->blkpos[0] = src->blkpos[1] = src->cursor;
+    src->blklen[0] = src->blklen[1] = 0;
+}
+
+// turns the source into a virtual one, the channels are expected
+// to have been either released or handed over to another source
+static void S_Src_Virtualize(sfx_source_t *src)
+{
+    src->num_channels = 0;
+    src->channels[0] = 0;
+    src->backbuf = -1;
+    src->rem = 0;
+    src->vclock = pcm_clock;
+    src->vacc = 0;
+    src->flipclock = 0;
+}
+
+// binds free hardware channels to the source,
+// returns 0 if there aren't enough of them
+static int S_Src_BindChannels(sfx_source_t *src)
+{
+    int i;
+    int num_channels = src->buf->num_channels;
+    sfx_channel_t *chan;
+
+    for (i = 0; i < num_channels; i++) {
+        src->channels[ i ] = S_AllocChannel();
+        if (!src->channels[ i ]) {
+            // out of free channels
+            break;
+        }
+        chan = &s_channels[ src->channels[ i ] ];
+        chan->freq = src->freq;
+    }
+
+    if (i < num_channels) {
+        // deallocate channels
+        while (i-- > 0) {
+            chan = &s_channels[ src->channels[ i ] ];
+            chan->freq = 0;
+        }
+        src->channels[0] = 0;
+        return 0;
+    }
+
+    src->num_channels = num_channels;
+    src->backbuf = -1;
+    src->flipclock = 0;
+    S_Src_ResetBlocks(src);
+    return 1;
+}
+
+// the most audible virtual source that's waiting for hardware channels, needs
+// no more than max_channels of them and is more audible than min_audibility,
+// so that a source that doesn't fit doesn't hold back the ones after it
+static sfx_source_t *S_BestVirtualSource(int max_channels, int min_audibility)
+{
+    int i;
+    sfx_source_t *best = NULL;
+
+    for (i = 0; i < S_MAX_SOURCES; i++) {
+        sfx_source_t *src = &s_sources[ i ];
+        if (!src->buf || src->num_channels || src->pending || S_Src_IsPaused(src)) {
+            continue;
+        }
+        if (src->buf->num_channels > max_channels || S_Src_Audibility(src) <= min_audibility) {
+            continue;
+        }
+        if (!best || S_Src_Audibility(src) > S_Src_Audibility(best)) {
+            best = src;
+        }
+    }
+    return best;
+}
+
+// the least audible source bound to hardware channels, other than the given one
+// and the ones whose channels have been promised to another source already
+static sfx_source_t *S_WorstBoundSource(sfx_source_t *except)
+{
+    int i;
+    sfx_source_t *worst = NULL;
+
+    for (i = 0; i < S_MAX_SOURCES; i++) {
+        sfx_source_t *src = &s_sources[ i ];
+        if (!src->buf || !src->num_channels || src->handover || src == except) {
+            continue;
+        }
+        if (!worst || S_Src_Audibility(src) < S_Src_Audibility(worst)) {
+            worst = src;
+        }
+    }
+    return worst;
+}
+
+// releases the channels of the source and turns it into a virtual one
+static void S_Src_Unbind(sfx_source_t *src)
+{
+    int i;
+
+    for (i = 0; i < src->num_channels; i++) {
+        S_Chan_Clear( &s_channels[ src->channels[ i ] ] );
+    }
+    S_Src_Virtualize(src);
+}
+
+// frees the channels handed over to a source that no longer waits for them
+static void S_Src_DropPending(sfx_source_t *src)
+{
+    int i;
+
+    for (i = 0; i < src->pending; i++) {
+        s_channels[ src->channels[ i ] ].freq = 0;
+    }
+    if (src->pending) {
+        src->pending = 0;
+        src->channels[0] = 0;
+    }
+}
+
+// gives the channels of the source to the virtual source waiting for them and starts
+// that one once it has all of them, meant to be called on block boundaries, same
+// as S_Src_Yield, so that nothing is cut off in the middle of a block
+static void S_Src_HandOver(sfx_source_t *src)
+{
+    int i, ready = 0;
+    sfx_source_t *dst = &s_sources[ src->handover - 1 ];
+    sfx_channel_t *chan;
+
+    src->handover = 0;
+    for (i = 0; i < src->num_channels; i++) {
+        chan = &s_channels[ src->channels[ i ] ];
+        S_Chan_Clear(chan);
+        if (dst->pending && dst->pending < dst->buf->num_channels) {
+            // keep the channel allocated, silent, until the source starts
+            chan->freq = dst->freq;
+            dst->channels[ dst->pending++ ] = src->channels[ i ];
+        }
+    }
+    S_Src_Virtualize(src);
+
+    if (dst->pending && dst->pending == dst->buf->num_channels) {
+        dst->num_channels = dst->pending;
+        dst->pending = 0;
+        dst->backbuf = -1;
+        dst->flipclock = 0;
+        S_Src_ResetBlocks(dst);
+        ready = 1;
+    }
+
+    S_UpdateSourcesStatus();
+
+    if (ready) {
+        S_Src_Paint(dst);
+    }
+}
+
+// a stereo source in place of a mono one: the channels of both halves have to start
+// together, so they are restarted, with a free channel or the one of the least
+// audible other source as the second one, the latter is handed over once that
+// source reaches its own block boundary and the channel of this one waits for it
+static int S_Src_YieldStereo(sfx_source_t *src, sfx_source_t *cand)
+{
+    int bound;
+    sfx_source_t *victim;
+    sfx_channel_t *chan;
+
+    if (S_NumFreeChannels()) {
+        S_Src_Unbind(src);
+        bound = S_Src_BindChannels(cand);
+
+        S_UpdateSourcesStatus();
+
+        if (bound) {
+            S_Src_Paint(cand);
+        }
+        return 1;
+    }
+
+    victim = S_WorstBoundSource(src);
+    if (!victim || S_Src_Audibility(victim) >= S_Src_Audibility(cand)) {
+        return 0;
+    }
+
+    chan = &s_channels[ src->channels[ 0 ] ];
+    S_Chan_Clear(chan);
+    chan->freq = cand->freq;
+    cand->channels[ 0 ] = src->channels[ 0 ];
+    cand->pending = 1;
+    victim->handover = cand->id;
+
+    S_Src_Virtualize(src);
+
+    S_UpdateSourcesStatus();
+    return 1;
+}
+
+// hands the channels of the source over to a more audible virtual source,
+// meant to be called on block boundaries, so that the channels keep running
+// and the front buffer plays out before the new data kicks in
+static int S_Src_Yield(sfx_source_t *src)
+{
+    int i;
+    int audibility = S_Src_Audibility(src);
+    sfx_source_t *cand = S_BestVirtualSource(2, audibility);
+
+    if (!cand) {
+        return 0;
+    }
+    if (cand->buf->num_channels > src->num_channels) {
+        if (S_Src_YieldStereo(src, cand)) {
+            return 1;
+        }
+        // fall back to the most audible mono source
+        cand = S_BestVirtualSource(src->num_channels, audibility);
+        if (!cand) {
+            return 0;
+        }
+    }
+
+    for (i = 0; i < cand->buf->num_channels; i++) {
+        cand->channels[ i ] = src->channels[ i ];
+    }
+    for ( ; i < src->num_channels; i++) {
+        S_Chan_Clear( &s_channels[ src->channels[ i ] ] );
+    }
+    cand->num_channels = cand->buf->num_channels;
+    cand->backbuf = -1;
+    cand->flipclock = 0;
+    S_Src_ResetBlocks(cand);
+
+    S_Src_Virtualize(src);
+
+    S_UpdateSourcesStatus();
+
+    S_Src_Paint(cand);
+    return 1;
+}
+
 void S_Src_SetPause(sfx_source_t *src, uint8_t paused)
 {
     sfx_buffer_t *buf = src->buf;
@@ -84,6 +525,17 @@ uint16_t S_Buf_LoadMonoSamples(sfx_source_t *src, uint16_t *pos, uint16_t len)
             src->data_pos += len;
             return len;
 
+        case S_FORMAT_RAW_SM:
+            if (src->data_pos + len > buf->data_len) {
+                len = buf->data_len - src->data_pos;
+                if (len == 0) {
+                    return 0;
+                }
+            }
+            pcm_load_samples(*pos, buf->data + src->data_pos, len);
+            src->data_pos += len;
+            return len;
+
         case S_FORMAT_WAV_ADPCM:
             return adpcm_load_samples(&src->adpcm, *pos, len);
     }
@@ -107,8 +559,20 @@ uint16_t S_Buf_LoadStereoSamples(sfx_source_t *src, uint16_t *pos, uint16_t len)
             src->data_pos += len*2;
             return len;
 
+        case S_FORMAT_RAW_SM:
+            if (src->data_pos + len*2 > buf->data_len) {
+                len = (buf->data_len - src->data_pos) / 2;
+                if (len == 0) {
+                    return 0;
+                }
+            }
+            pcm_load_samples_interleaved(pos[0], buf->data + src->data_pos, len);
+            pcm_load_samples_interleaved(pos[1], buf->data + src->data_pos + 1, len);
+            src->data_pos += len*2;
+            return len;
+
         case S_FORMAT_WAV_ADPCM:
-            return 0;
+            return adpcm_load_stereo_samples(&src->adpcm, pos[0], pos[1], len);
     }
 
     return 0;
@@ -134,6 +598,75 @@ uint16_t S_Src_LoadSamples(sfx_source_t *src, uint16_t *pos, uint16_t len)
     return painted;
 }
 
+// all channel blocks of the source hold silence
+static int S_Src_IsSilent(sfx_source_t *src)
+{
+    int i;
+
+    for (i = 0; i < src->num_channels; i++) {
+        if (s_channels[ src->channels[ i ] ].silent != CHBUF_SILENT_ALL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// samples have been painted to the current back buffer block
+static void S_Src_MarkAudible(sfx_source_t *src)
+{
+    int i;
+    uint8_t mask = ~(1 << src->backbuf);
+
+    for (i = 0; i < src->num_channels; i++) {
+        s_channels[ src->channels[ i ] ].silent &= mask;
+    }
+}
+
+// the hardware has moved on to the next block: if it took much longer than a block
+// lasts, the previous flip was missed and the hardware replayed a stale block
+static void S_Src_CheckFlip(sfx_source_t *src)
+{
+    uint32_t now = pcm_clock;
+
+    if (src->flipclock && now - src->flipclock > (uint32_t)CHBUF_SIZE * PCM_CLOCK_RATE * 3 / 2 / src->freq) {
+        S_TRACE_EVENT(S_TRACE_UNDERRUN, src->id, S_TRACE_UNDERRUN_STALE);
+        s_load.underruns++;
+        s_load.min_slack = 0;
+    }
+    src->flipclock = now;
+}
+
+// the back buffer block has been fully painted: see how many samples the hardware
+// has left to play in the front block or whether it has already moved past it
+static void S_Src_MeasureSlack(sfx_source_t *src, sfx_channel_t *chan)
+{
+    uint16_t start, end, pos;
+
+    if (chan->id == 0 || pcm_is_off(chan->realid)) {
+        return;
+    }
+
+    s_load.refills++;
+    if (S_Chan_BackBuffer( chan ) != src->backbuf) {
+        S_TRACE_EVENT(S_TRACE_UNDERRUN, src->id, S_TRACE_UNDERRUN_LATE);
+        s_load.underruns++;
+        s_load.min_slack = 0;
+        return;
+    }
+
+    start = CHBUF_POS(S_Chan_StartBlock( chan ));
+    end = start + CHBUF_POS((src->backbuf ^ 1) + 1);
+    pos = S_Chan_GetPosition( chan );
+    if (pos >= start + CHBUF_POS(2)) {
+        // on the loop markers, about to jump back to the first block
+        pos = start;
+    }
+    pos = pos < end ? end - pos : 0;
+    if (pos < s_load.min_slack) {
+        s_load.min_slack = pos;
+    }
+}
+
 void S_Src_Paint(sfx_source_t *src)
 {
     int i;
@@ -142,11 +675,16 @@ void S_Src_Paint(sfx_source_t *src)
     sfx_channel_t *prichan;
 
     // stream data
-    if (!src->buf || !src->num_channels) {
+    if (!src->buf) {
         S_Src_Stop(src);
         return;
     }
 
+    if (!src->num_channels) {
+        S_Src_Advance(src);
+        return;
+    }
+
     // use position of the primary channel to determine backbuffer id
     prichan = &s_channels[ src->channels[ 0 ] ];
 
@@ -156,8 +694,24 @@ void S_Src_Paint(sfx_source_t *src)
             S_Src_Stop(src);
             return;
         }
-        
+
+        if (src->handover) {
+            // the channels have been promised to a source waiting for them
+            S_Src_HandOver(src);
+            return;
+        }
+
+        if (s_num_virtual > 0 && S_Src_Yield(src)) {
+            // the channels now belong to a more audible source
+            return;
+        }
+
+        S_Src_CheckFlip(src);
+        S_TRACE_EVENT(S_TRACE_FLIP, src->id, backbuf);
+
         src->backbuf = backbuf;
+        src->blkpos[ backbuf ] = src->cursor;
+        src->blklen[ backbuf ] = 0;
         src->rem = CHBUF_SIZE;
         if (src->eof)
             src->eof++;
@@ -176,66 +730,121 @@ void S_Src_Paint(sfx_source_t *src)
         }
     }
 
+    if (S_Src_IsPaused(src) && S_Src_IsSilent(src)) {
+        // nothing to paint and nothing to clear
+        src->rem = 0;
+        goto update;
+    }
+
     rem = src->rem;
     painted = 0;
     if (rem > S_PAINT_CHUNK) {
         rem = S_PAINT_CHUNK;
     }
+    S_TRACE_EVENT(S_TRACE_PAINT_BEGIN, src->id, src->rem);
 
 paint:
-    if (!src->paused) {
+    if (!S_Src_IsPaused(src)) {
         if (!src->eof) {
             int len = rem - painted;
             int newpainted = S_Src_LoadSamples(src, src->bufpos, len);
             if (newpainted != len) {
                 src->eof = 1;
             }
+            if (newpainted > 0) {
+                S_Src_MarkAudible(src);
+            }
+            src->cursor += newpainted;
+            src->blklen[ src->backbuf ] += newpainted;
+            src->painted += newpainted;
             painted += newpainted;
         }
 
         if (src->eof) {
             if (src->painted > 0 && src->autoloop) {
-                // auto-restart only if we have previously painted at least 1 sample
+                // auto-restart only if we have painted at least 1 sample since the
+                // last restart, loops shorter than a chunk can wrap more than once
                 src->eof = 0;
-                src->painted = 0;
-                S_Src_Rewind(src);
+                S_Src_Loop(src);
                 goto paint;
             }
         }
     }
 
-    src->painted += painted;
     src->rem -= painted;
+    S_TRACE_EVENT(S_TRACE_PAINT_END, src->id, painted);
 
     if (painted < S_PAINT_CHUNK) {
+        uint8_t mask = 1 << src->backbuf;
+
         for (i = 0; i < src->num_channels; i++) {
+            uint16_t startpos;
+
+            chan = &s_channels[ src->channels[ i ] ];
+            if (chan->silent & mask) {
+                // the block has held nothing but silence since it was last cleared
+                src->bufpos[ i ] += src->rem;
+                continue;
+            }
+
             // pad remaining buffer data with silence
-            int pad = src->rem;
-            pcm_load_zero(src->bufpos[ i ], pad);
+            startpos = CHBUF_POS(S_Chan_StartBlock( chan ) + src->backbuf);
+            pcm_load_zero(src->bufpos[ i ], src->rem);
+            if (src->bufpos[ i ] == startpos) {
+                chan->silent |= mask;
+            }
             src->bufpos[ i ] += src->rem;
         }
         src->rem = 0;
     }
 
+update:
     if (src->rem != 0) {
         return;
     }
 
+    S_Src_MeasureSlack(src, prichan);
+
+    if (!S_Src_RunAutomation(src)) {
+        return;
+    }
+
     // copy channel parameters from source and update
     for (i = 0; i < src->num_channels; i++) {
         chan = &s_channels[ src->channels[ i ] ];
         chan->freq = src->freq;
-        chan->env = src->env;
+        chan->env = S_Src_Env(src);
         chan->pan = src->pan[i];
         S_Chan_Update(chan);
     }
 }
 
-void S_Src_Play(sfx_source_t *src, sfx_buffer_t *buf, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop)
+// pushes the parameters of the source to its channels right away
+// instead of on the next block boundary
+void S_Src_Refresh(sfx_source_t *src)
 {
     int i;
     sfx_channel_t *chan;
 
+    for (i = 0; i < src->num_channels; i++) {
+        chan = &s_channels[ src->channels[ i ] ];
+        chan->freq = src->freq;
+        chan->env = S_Src_Env(src);
+        chan->pan = src->pan[i];
+        S_Chan_Refresh(chan);
+    }
+}
+
+void S_Src_Play(sfx_source_t *src, sfx_buffer_t *buf, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset, uint8_t bus)
+{
+    int i;
+    sfx_channel_t *chan;
+
+    S_Src_DropPending(src);
+    if (src->handover) {
+        S_Src_HandOver(src);
+    }
+
     if (src->num_channels > 0 && src->num_channels != buf->num_channels) {
         // we need to re-allocate channels for this source
         S_Src_Stop(src);
@@ -243,12 +852,19 @@ void S_Src_Play(sfx_source_t *src, sfx_buffer_t *buf, uint16_t freq, uint8_t pan
 
     src->buf = buf;
     src->pan[0] = S_Chan_MidiPan(pan);
+    src->midipan = pan;
     src->env = vol;
     src->autoloop = autoloop;
     src->freq = freq ? freq : buf->freq;
+    src->automated = 0;
     src->paused = 0;
     src->eof = 0;
     src->painted = 0;
+    src->priority = priority;
+    src->bus = bus < S_MAX_BUSES ? bus : S_BUS_SFX;
+    src->vclock = pcm_clock;
+    src->vacc = 0;
+    src->flipclock = 0;
     //src->backbuf = -1;
 
     if (!buf || !buf->num_channels || !buf->data || !src->freq) {
@@ -257,6 +873,8 @@ void S_Src_Play(sfx_source_t *src, sfx_buffer_t *buf, uint16_t freq, uint8_t pan
 
     src->adpcm.codec = buf->adpcm_codec;
     src->adpcm.block_size = buf->adpcm_block_size;
+    src->adpcm.channels = buf->num_channels;
+    src->adpcm.table = buf->adpcm_table;
 
     // hard-pan stereo channels
     if (buf->num_channels == 2) {
@@ -265,27 +883,10 @@ void S_Src_Play(sfx_source_t *src, sfx_buffer_t *buf, uint16_t freq, uint8_t pan
     }
 
     if (src->num_channels != buf->num_channels) {
-        for (i = 0; i < buf->num_channels; i++) {
-            src->channels[ i ] = S_AllocChannel();
-            if (!src->channels[ i ]) {
-                // out of free channels
-                break;
-            }
-            chan = &s_channels[ src->channels[ i ] ];
-            chan->freq = src->freq;
-        }
-
-        src->num_channels = buf->num_channels;
-
-        if (i < buf->num_channels) {
-            // deallocate channels, exit
-            while (i-- > 0) {
-                chan = &s_channels[ src->channels[ i ] ];
-                chan->freq = 0;
-            }
-noplay:
-            S_Src_Stop(src);
-            return;
+        if (!S_Src_BindChannels(src)) {
+            // out of free channels: start as a virtual source, which gets
+            // channels once they're freed or stolen from a less audible source
+            S_Src_Virtualize(src);
         }
     }
     else {
@@ -295,9 +896,15 @@ noplay:
         }
     }
 
-    S_Src_Rewind(src);
+    S_Src_Seek(src, offset);
+    S_Src_ResetBlocks(src);
+    S_TRACE_EVENT(S_TRACE_PLAY, src->id, src->freq);
 
     S_UpdateSourcesStatus();
+    return;
+
+noplay:
+    S_Src_Stop(src);
 }
 
 void S_Src_Update(sfx_source_t *src, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop)
@@ -313,27 +920,110 @@ void S_Src_Update(sfx_source_t *src, uint16_t freq, uint8_t pan, uint8_t vol, ui
     if (src->num_channels == 1) {
         src->pan[0] = S_Chan_MidiPan(pan);
     }
+    src->midipan = pan;
     src->env = vol;
     src->autoloop = autoloop;
+    // explicit updates override running automation
+    src->automated = 0;
+}
+
+// starts moving a source parameter from its current value to the target
+// over the duration given in milliseconds, the value is updated when
+// channel parameters are written on block refills
+void S_Src_Automate(sfx_source_t *src, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags)
+{
+    sfx_automation_t *a;
+
+    if (!src->buf || param >= S_NUM_AUTO_PARAMS) {
+        return;
+    }
+
+    a = &src->automation[ param ];
+    switch (param) {
+        case S_AUTO_ENV:
+            a->from = src->env;
+            if (target > 255) target = 255;
+            break;
+        case S_AUTO_PAN:
+            a->from = src->midipan;
+            if (target > 255) target = 255;
+            break;
+        case S_AUTO_FREQ:
+            a->from = src->freq;
+            if (!target) target = src->buf->freq;
+            break;
+    }
+
+    a->to = target;
+    a->curve = curve;
+    a->flags = flags;
+    a->start = pcm_clock;
+    a->length = (uint32_t)duration * PCM_CLOCK_RATE / 1000;
+    src->automated |= (1<<param);
 }
 
 uint16_t S_Src_GetPosition(sfx_source_t *src)
 {
-    if (!src || !src->channels[0] ) {
+    if (!src || !src->num_channels) {
         return 0xffff;
     }
     return S_Chan_GetPosition( &s_channels [ src->channels[0] ] );
 }
 
+// the number of samples played since the start of playback, plus the start offset
+uint32_t S_Src_GetSamplePosition(sfx_source_t *src)
+{
+    int8_t front;
+    uint16_t off;
+    sfx_channel_t *chan;
+
+    if (!src || !src->buf) {
+        return 0;
+    }
+    if (!src->num_channels) {
+        return src->cursor;
+    }
+
+    // the block the hardware is playing and how far into it it is
+    chan = &s_channels[ src->channels[0] ];
+    front = S_Chan_BackBuffer( chan ) ^ 1;
+    off = S_Chan_GetPosition( chan ) - CHBUF_POS(S_Chan_StartBlock( chan ) + front);
+    if (off > src->blklen[ front ]) {
+        // playing the padding or the loop block
+        off = src->blklen[ front ];
+    }
+    return src->blkpos[ front ] + off;
+}
+
 void S_InitSources(void)
 {
     int i;
     for (i = 0; i < S_MAX_SOURCES; i++) {
         S_Src_Init(&s_sources[ i ]);
+        s_sources[ i ].id = i + 1;
+    }
+    for (i = 0; i < S_MAX_BUSES; i++) {
+        S_SetBus(&s_buses[ i ], S_BUS_SET_VOL|S_BUS_SET_DUCK|S_BUS_SET_PAUSE, 255, 0, 0);
     }
     S_UpdateSourcesStatus();
 }
 
+// the changes reach the channels of the sources on the bus
+// at their next block boundary, same as S_Src_Update
+void S_SetBus(sfx_bus_t *bus, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused)
+{
+    if (what & S_BUS_SET_VOL) {
+        bus->vol = vol;
+    }
+    if (what & S_BUS_SET_DUCK) {
+        bus->duck = duck;
+    }
+    if (what & S_BUS_SET_PAUSE) {
+        bus->paused = paused;
+    }
+    bus->gain = ((uint16_t)bus->vol * (256 - bus->duck)) >> 8;
+}
+
 void S_StopSources(void)
 {
     int i;
@@ -360,18 +1050,43 @@ int S_AllocSource(void)
 void S_UpdateSourcesStatus(void)
 {
     int i;
-    uint8_t status, bit;
+    uint32_t status, bit;
 
     // update playback status register: for all active 
     // sources, the matching bit will be set to 1
     bit = 1;
     status = 0;
+    s_num_virtual = 0;
     for (i = 0; i < S_MAX_SOURCES; i++) {
         sfx_source_t *src = &s_sources[ i ];
         if (src->buf != NULL) {
             status |= bit;
+            if (!src->num_channels) {
+                s_num_virtual++;
+            }
         }
         bit += bit;
     }
-    *(volatile uint8_t *)0xFF802F = status;
+    COMM_STATUS = status;
+}
+
+// binds free hardware channels to the most audible virtual sources that fit them
+void S_BindVirtualSources(void)
+{
+    int bound = 0;
+    sfx_source_t *src;
+
+    if (!s_num_virtual) {
+        return;
+    }
+
+    while ((src = S_BestVirtualSource(S_NumFreeChannels(), -1)) != NULL) {
+        if (!S_Src_BindChannels(src)) {
+            break;
+        }
+        bound = 1;
+    }
+    if (bound) {
+        S_UpdateSourcesStatus();
+    }
 }
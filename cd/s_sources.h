@@ -9,17 +9,64 @@
 #include "s_channels.h"
 #include "s_buffers.h"
 
-#define S_MAX_SOURCES 8
+#define S_MAX_SOURCES 32
+
+#define S_DEFAULT_PRIORITY 128
+
+// automated source parameters
+enum
+{
+    S_AUTO_ENV,
+    S_AUTO_PAN,
+    S_AUTO_FREQ,
+    S_NUM_AUTO_PARAMS
+};
+
+enum
+{
+    S_CURVE_LINEAR,
+    S_CURVE_EXP, // squared, approximates an exponential curve
+};
+
+#define S_AUTO_STOP 1 // stop the source once the target value is reached
+
+// source buses, each source plays on one of them
+enum
+{
+    S_BUS_SFX, // the default one
+    S_BUS_MUSIC,
+    S_BUS_VOICE,
+    S_BUS_UI,
+    S_MAX_BUSES
+};
+
+// what S_SetBuses changes
+#define S_BUS_SET_VOL   1
+#define S_BUS_SET_DUCK  2
+#define S_BUS_SET_PAUSE 4
+
+typedef struct
+{
+    uint8_t curve;
+    uint8_t flags;
+    uint16_t from, to;
+    uint32_t start;  // pcm_clock value
+    uint32_t length; // in pcm_clock ticks
+} sfx_automation_t;
 
 typedef struct
 {
     sfx_buffer_t *buf;
     uint16_t freq;
     uint8_t channels[2];
-    uint8_t num_channels;
+    uint8_t num_channels; // 0 for a virtual source with no hardware channels bound
+    uint8_t pending;  // channels handed over to a virtual source that waits for the rest of them
+    uint8_t handover; // id of the source that gets the channels on the next block boundary, 0 if none
+    uint8_t priority;
     uint32_t data_pos;
     sfx_adpcm_t adpcm;
     uint8_t pan[2], env;
+    uint8_t midipan;
     int8_t backbuf;
     uint8_t autoloop;
     uint8_t paused;
@@ -27,29 +74,67 @@ typedef struct
     uint16_t rem;
     uint16_t bufpos[2];
     uint32_t painted;
+    uint32_t cursor;    // samples played since the start, counting from the start offset
+    uint32_t blkpos[2]; // cursor value at the start of each double buffer block
+    uint16_t blklen[2]; // samples painted to each block, not counting the padding
+    uint32_t vclock; // pcm_clock value at the last virtual advance
+    uint32_t flipclock; // pcm_clock value at the last back buffer flip, 0 if none yet
+    uint32_t vacc;   // fractional virtual position, in freq*clock units
+    uint8_t automated; // bit mask of automated parameters
+    sfx_automation_t automation[S_NUM_AUTO_PARAMS];
+    uint8_t bus;
+    uint8_t id;      // src_id, for the trace
 } sfx_source_t;
 
+typedef struct
+{
+    uint8_t vol;
+    uint8_t duck;   // attenuation on top of the volume, 255 mutes the bus
+    uint8_t paused;
+    uint8_t gain;   // vol scaled down by duck, applied to the env of the sources
+} sfx_bus_t;
+
+// driver load counters, see S_GetLoadStats
+typedef struct
+{
+    uint32_t elapsed;   // pcm_clock ticks since the last reset
+    uint32_t busy;      // pcm_clock ticks spent in S_Update
+    uint16_t refills;   // double buffer blocks painted on running channels
+    uint16_t underruns; // blocks played before they were fully painted or replayed stale
+    uint16_t min_slack; // fewest samples left to play in the front block when a refill completed
+    uint16_t peak;      // longest single S_Update call, in pcm_clock ticks
+} sfx_load_stats_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern sfx_source_t s_sources[ S_MAX_SOURCES ];
+extern sfx_load_stats_t s_load;
+extern sfx_bus_t s_buses[ S_MAX_BUSES ];
 
 void S_InitSources(void);
+void S_SetBus(sfx_bus_t *bus, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused);
 void S_StopSources(void);
 int S_AllocSource(void);
 
 void S_Src_Init(sfx_source_t *src);
-void S_Src_Play(sfx_source_t *src, sfx_buffer_t *buf, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop);
+void S_Src_Play(sfx_source_t *src, sfx_buffer_t *buf, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset, uint8_t bus);
 void S_Src_Stop(sfx_source_t *src);
 // returns 1 if fully painted
 // returns 0 otherwise and the function needs to be called again
 void S_Src_Paint(sfx_source_t *src);
 void S_Src_Update(sfx_source_t *src, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop);
+void S_Src_Refresh(sfx_source_t *src);
+void S_Src_Automate(sfx_source_t *src, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags);
 void S_Src_Rewind(sfx_source_t *src);
+uint32_t S_Src_Skip(sfx_source_t *src, uint32_t len);
+void S_Src_Seek(sfx_source_t *src, uint32_t pos);
 void S_Src_SetPause(sfx_source_t *src, uint8_t paused);
 uint16_t S_Src_GetPosition(sfx_source_t *src);
+uint32_t S_Src_GetSamplePosition(sfx_source_t *src);
 void S_UpdateSourcesStatus(void);
+void S_BindVirtualSources(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,63 @@
+#include <string.h>
+#include "s_trace.h"
+
+#ifdef S_TRACE
+
+sfx_trace_event_t s_trace_ring[ S_TRACE_SIZE ];
+uint8_t s_trace_head = 0;
+uint32_t s_trace_clock = 0;
+
+static uint8_t *S_Trace_PutShort(uint8_t *dst, uint16_t v)
+{
+    dst[0] = v >> 8;
+    dst[1] = v;
+    return dst + 2;
+}
+
+static uint8_t *S_Trace_PutLong(uint8_t *dst, uint32_t v)
+{
+    dst = S_Trace_PutShort(dst, v >> 16);
+    return S_Trace_PutShort(dst, v);
+}
+
+// writes the dump described in s_trace.h to dst and returns its size, the events
+// are written byte by byte so that the host build produces the same dumps
+uint32_t S_Trace_Dump(uint8_t *dst, uint8_t reset)
+{
+    int i;
+    uint8_t head = s_trace_head;
+    uint8_t *p = dst;
+
+    if (dst) {
+        memcpy(p, "SCDT", 4);
+        p = S_Trace_PutShort(p + 4, S_TRACE_VERSION);
+        p = S_Trace_PutShort(p, S_TRACE_SIZE);
+        p = S_Trace_PutLong(p, PCM_CLOCK_RATE);
+        p = S_Trace_PutLong(p, pcm_clock);
+
+        for (i = 0; i < S_TRACE_SIZE; i++) {
+            sfx_trace_event_t *ev = &s_trace_ring[ (uint8_t)(head + i) ];
+
+            p = S_Trace_PutLong(p, ev->clock);
+            *p++ = ev->type;
+            *p++ = ev->id;
+            p = S_Trace_PutShort(p, ev->val);
+        }
+    }
+
+    if (reset) {
+        memset(s_trace_ring, 0, sizeof(s_trace_ring));
+        s_trace_head = 0;
+    }
+
+    return p - dst;
+}
+
+#else
+
+uint32_t S_Trace_Dump(uint8_t *dst, uint8_t reset)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef _S_TRACE_H
+#define _S_TRACE_H
+
+#include <stdint.h>
+
+#include "pcm.h"
+
+// a ring of the last S_TRACE_SIZE driver events, recorded when the driver is built
+// with S_TRACE defined (make TRACE=1), so that glitches on the hardware can be looked
+// into after the fact, S_Trace_Dump snapshots it for the main CPU and tools/scdtrace
+// turns the dump into Chrome trace JSON
+//
+// an event takes a handful of instructions, the ring is only written from the main
+// loop, never from the timer interrupt, so that the head doesn't need any locking
+//
+// a dump is big endian:
+//
+// 0: "SCDT"
+// 4: 16-bit format version, S_TRACE_VERSION
+// 6: 16-bit number of events
+// 8: 32-bit rate of pcm_clock, in ticks per second
+// 12: 32-bit pcm_clock value at the time of the dump
+// 16: the events, oldest first, S_TRACE_EVENT_SIZE bytes each:
+//     0: 32-bit pcm_clock value, which only moves on timer interrupts
+//     4: event type, S_TRACE_NONE for slots that haven't been written yet
+//     5: id, see the event types
+//     6: 16-bit value, see the event types
+
+#define S_TRACE_VERSION     1
+#define S_TRACE_SIZE        256 // the head is a byte, so that it wraps on its own
+#define S_TRACE_HEADER_SIZE 16
+#define S_TRACE_EVENT_SIZE  8
+#define S_TRACE_DUMP_SIZE   (S_TRACE_HEADER_SIZE + S_TRACE_SIZE * S_TRACE_EVENT_SIZE)
+
+// the first two are also recorded by crt.s, which has its own copy of the values
+enum
+{
+    S_TRACE_NONE,
+    S_TRACE_CMD,            // command received, id: command
+    S_TRACE_ACK,            // command acknowledged by the main CPU, id: 'D' or 'E'
+    S_TRACE_PLAY,           // id: source, value: frequency
+    S_TRACE_STOP,           // id: source
+    S_TRACE_FLIP,           // hardware moved on to the other block, id: source, value: back buffer
+    S_TRACE_PAINT_BEGIN,    // id: source, value: samples left to paint in the block
+    S_TRACE_PAINT_END,      // id: source, value: samples painted
+    S_TRACE_UNDERRUN,       // id: source, value: S_TRACE_UNDERRUN_
+    S_TRACE_UPLOAD_BEGIN,   // id: 1 for Kosinski data, value: buffer
+    S_TRACE_UPLOAD_END,     // id: S_UPLOAD_ result, value: buffer
+    S_TRACE_TICK,           // pcm_clock moved, value: ticks since the previous event, saturated
+};
+
+#define S_TRACE_UNDERRUN_STALE  0 // the flip came late, a block was replayed
+#define S_TRACE_UNDERRUN_LATE   1 // the block was played before it was fully painted
+
+typedef struct
+{
+    uint32_t clock;
+    uint8_t type;
+    uint8_t id;
+    uint16_t val;
+} sfx_trace_event_t;
+
+#ifdef S_TRACE
+
+extern sfx_trace_event_t s_trace_ring[ S_TRACE_SIZE ];
+extern uint8_t s_trace_head;
+extern uint32_t s_trace_clock;
+
+#define S_TRACE_EVENT(t, i, v) do { \
+        sfx_trace_event_t *ev_ = &s_trace_ring[ s_trace_head++ ]; \
+        ev_->clock = pcm_clock; \
+        ev_->type = (t); \
+        ev_->id = (i); \
+        ev_->val = (v); \
+    } while (0)
+
+// records the timer ticks the main loop has seen go by since the previous call
+#define S_TRACE_TICKS() do { \
+        uint32_t dt_ = pcm_clock - s_trace_clock; \
+        if (dt_ != 0) { \
+            s_trace_clock += dt_; \
+            S_TRACE_EVENT(S_TRACE_TICK, 0, dt_ > 0xFFFF ? 0xFFFF : dt_); \
+        } \
+    } while (0)
+
+#else
+
+#define S_TRACE_EVENT(t, i, v) do { } while (0)
+#define S_TRACE_TICKS() do { } while (0)
+
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t S_Trace_Dump(uint8_t *dst, uint8_t reset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,108 +1,164 @@
 | ---------------------------------------------------------------------------
 | Kosinski decompression subroutine
-| void Kos_Decomp(uint8_t *src, uint8_t *dst)
+| uint8_t *Kos_Decomp(uint8_t *src, uint8_t *dst, uint8_t *dst_end)
 | Inputs:
 | 4(sp) = compressed data location
 | 8(sp) = destination
+| 12(sp) = end of the destination
+| Returns the end of the output, NULL if the data doesn't fit before dst_end
+|
+| the output is only checked against dst_end once per descriptor field and
+| on long matches, so broken data can write up to KOS_DST_SLACK bytes past
+| dst_end before it's caught: the 16 bits of a field make at most 8 matches
+| of up to 9 bytes on top of the checked ones
+|
+| every descriptor bit is branched on right after it's shifted out, and the
+| taken path fetches the next descriptor field when needed, so the flags don't
+| have to be saved around the fetch, literals are unrolled and matches are
+| copied by jumping into a run of byte moves
 | ---------------------------------------------------------------------------
 
+        .equ    KOS_DST_SLACK, 72
+
+| fetches the next descriptor field once the 16 bits of the current one are used
+| up, keeps the X flag
+.macro KOS_NEXT_DESC
+        dbra    d1,9f                   | 10 when taken
+        cmpa.l  a3,a1
+        bhi.w   Kos_Decomp_Overrun
+        move.b  (a0)+,1(sp)
+        move.b  (a0)+,(sp)
+        move.w  (sp),d0                 /* little endian descriptor field */
+        moveq   #15,d1
+9:
+.endm
+
+| one descriptor bit, a literal byte if set, a match otherwise
+.macro KOS_LITERAL
+        lsr.w   #1,d0                   | 8
+        bcc.b   Kos_Decomp_Match        | 8
+        KOS_NEXT_DESC                   | 10
+        move.b  (a0)+,(a1)+             | 12
+.endm
+
         .global Kos_Decomp
 Kos_Decomp:
         movea.l 4(sp),a0
         movea.l 8(sp),a1
-        movem.l d2-d6,-(sp)
+        movem.l d2-d4/a2-a3,-(sp)
+        movea.l 12+20(sp),a3
         subq.l  #2,sp                   /* make space for two bytes on the stack */
         move.b  (a0)+,1(sp)
         move.b  (a0)+,(sp)
-        move.w  (sp),d5                 /* copy first description field */
-        moveq   #15,d4                  /* 16 bits in a byte */
+        move.w  (sp),d0                 /* copy first description field */
+        moveq   #15,d1                  /* 16 bits in a field */
 
 Kos_Decomp_Loop:
-        lsr.w   #1,d5                   /* bit which is shifted out goes into C flag */
-        move    sr,d6
-        dbra    d4,Kos_Decomp_ChkBit
-        move.b  (a0)+,1(sp)
-        move.b  (a0)+,(sp)
-        move.w  (sp),d5                 /* get next description field if needed */
-        moveq   #15,d4                  /* reset bit counter */
-
-Kos_Decomp_ChkBit:
-        move    d6,ccr                  /* was the bit set? */
-        bcc.b   Kos_Decomp_RLE          /* if not, branch (C flag clear means bit was clear) */
-        move.b  (a0)+,(a1)+             /* otherwise, copy byte as-is */
+        KOS_LITERAL
+        KOS_LITERAL
+        KOS_LITERAL
+        KOS_LITERAL
         bra.b   Kos_Decomp_Loop
 
 | ---------------------------------------------------------------------------
 
-Kos_Decomp_RLE:
-        moveq   #0,d3
-        lsr.w   #1,d5                   /* get next bit */
-        move    sr,d6
-        dbra    d4,Kos_Decomp_ChkBit2
-        move.b  (a0)+,1(sp)
-        move.b  (a0)+,(sp)
-        move.w  (sp),d5
-        moveq   #15,d4
+Kos_Decomp_Match:
+        KOS_NEXT_DESC
+        lsr.w   #1,d0
+        bcs.b   Kos_Decomp_Full         /* full match if set */
+        KOS_NEXT_DESC
 
-Kos_Decomp_ChkBit2:
-        move    d6,ccr                  /* was the bit set? */
-        bcs.b   Kos_Decomp_SeparateRLE  /* if it was, branch */
-        lsr.w   #1,d5                   /* bit which is shifted out goes into X flag */
-        dbra    d4,1f
-        move.b  (a0)+,1(sp)
-        move.b  (a0)+,(sp)
-        move.w  (sp),d5
-        moveq   #15,d4
-1:
-        roxl.w  #1,d3                   /* get high repeat count bit (shift X flag in) */
-        lsr.w   #1,d5
-        dbra    d4,2f
-        move.b  (a0)+,1(sp)
-        move.b  (a0)+,(sp)
-        move.w  (sp),d5
-        moveq   #15,d4
-2:
-        roxl.w  #1,d3                   /* get low repeat count bit */
-        addq.w  #1,d3                   /* increment repeat count */
+        moveq   #0,d3
+        lsr.w   #1,d0                   /* high bit of the count into X */
+        KOS_NEXT_DESC
+        addx.w  d3,d3
+        lsr.w   #1,d0                   /* low bit of the count */
+        KOS_NEXT_DESC
+        addx.w  d3,d3                   /* 2 to 5 bytes */
         moveq   #-1,d2
-        move.b  (a0)+,d2                /* calculate offset */
-        bra.b   Kos_Decomp_RLELoop
+        move.b  (a0)+,d2                /* from up to 256 bytes back */
+        lea     (a1,d2.w),a2
+
+| copies d3 + 2 bytes from a2, d3 in [0, 7]
+Kos_Decomp_Short:
+        add.w   d3,d3
+        neg.w   d3
+        jmp     Kos_Decomp_Copy2(pc,d3.w)
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+Kos_Decomp_Copy2:
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        bra.w   Kos_Decomp_Loop
 
 | ---------------------------------------------------------------------------
 
-Kos_Decomp_SeparateRLE:
-        move.b  (a0)+,d0                /* get first byte */
-        move.b  (a0)+,d1                /* get second byte */
+Kos_Decomp_Full:
+        KOS_NEXT_DESC
+        move.b  (a0)+,d4                /* get first byte */
+        move.b  (a0)+,d3                /* get second byte */
         moveq   #-1,d2
-        move.b  d1,d2
+        move.b  d3,d2
         lsl.w   #5,d2
-        move.b  d0,d2                   /* calculate offset */
-        andi.w  #7,d1                   /* does a third byte need to be read? */
-        beq.b   Kos_Decomp_SeparateRLE2 /* if it does, branch */
-        move.b  d1,d3                   /* copy repeat count */
-        addq.w  #1,d3                   /* and increment it */
+        move.b  d4,d2                   /* calculate offset */
+        lea     (a1,d2.w),a2
+        andi.w  #7,d3                   /* does a third byte need to be read? */
+        bne.b   Kos_Decomp_Short        /* if not, 3 to 9 bytes */
 
-Kos_Decomp_RLELoop:
-        move.b  (a1,d2.w),d0
-        move.b  d0,(a1)+                /* copy appropriate byte */
-        dbra    d3,Kos_Decomp_RLELoop   /* and repeat the copying */
-        bra.b   Kos_Decomp_Loop
-
-| ---------------------------------------------------------------------------
-
-Kos_Decomp_SeparateRLE2:
-        move.b  (a0)+,d1
+        move.b  (a0)+,d3
         beq.b   Kos_Decomp_Done         /* 0 indicates end of compressed data */
-        cmpi.b  #1,d1
+        subq.b  #1,d3
         beq.w   Kos_Decomp_Loop         /* 1 indicates a new description needs to be read */
-        move.b  d1,d3                   /* otherwise, copy repeat count */
-        bra.b   Kos_Decomp_RLELoop
+        addq.w  #2,d3                   /* otherwise, copy count + 1 bytes */
+        moveq   #0,d4
+        move.w  d3,d4
+        add.l   a1,d4
+        cmp.l   a3,d4
+        bhi.b   Kos_Decomp_Overrun
+        moveq   #7,d4
+        and.w   d3,d4
+        lsr.w   #3,d3                   /* in runs of 8 */
+        add.w   d4,d4
+        neg.w   d4
+        jmp     Kos_Decomp_Long(pc,d4.w) /* after the odd bytes */
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+Kos_Decomp_Long:
+        bra.b   2f
+1:
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+        move.b  (a2)+,(a1)+
+2:
+        dbra    d3,1b
+        bra.w   Kos_Decomp_Loop
 
 | ---------------------------------------------------------------------------
 
 Kos_Decomp_Done:
+        cmpa.l  a3,a1
+        bls.b   1f
+Kos_Decomp_Overrun:
+        suba.l  a1,a1                   /* the output doesn't fit */
+1:
+        move.l  a1,d0
         addq.l  #2,sp                   /* restore stack pointer to original state */
-        movem.l (sp)+,d2-d6
+        movem.l (sp)+,d2-d4/a2-a3
         rts
 
 | End of function Kos_Decomp
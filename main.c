@@ -23,7 +23,7 @@ extern uint32_t Sub_End;
 
 extern volatile uint32_t gTicks;             /* incremented every vblank */
 
-extern void Kos_Decomp(uint8_t *src, uint8_t *dst);
+extern uint8_t *Kos_Decomp(uint8_t *src, uint8_t *dst, uint8_t *dst_end);
 
 extern uint8_t stereo_test_u8_wav;
 extern int stereo_test_u8_wav_len;
@@ -33,6 +33,68 @@ extern int macabre_ima_wav_len;
 extern uint8_t macabre_sb4_wav;
 extern int macabre_sb4_wav_len;
 
+// the configurations checked by the decoder verification pass
+static const struct
+{
+    const char *name;
+    uint8_t codec;
+    uint8_t channels;
+} verify_runs[] = {
+    { "IMA",    SCD_ADPCM_CODEC_IMA, 1 },
+    { "SB4",    SCD_ADPCM_CODEC_SB4, 1 },
+    { "IML",    SCD_ADPCM_CODEC_IML, 1 },
+    { "SB3",    SCD_ADPCM_CODEC_SB3, 1 },
+    { "SB2",    SCD_ADPCM_CODEC_SB2, 1 },
+    { "DP4",    SCD_ADPCM_CODEC_DP4, 1 },
+    { "IMA st", SCD_ADPCM_CODEC_IMA, 2 },
+    { "SB4 st", SCD_ADPCM_CODEC_SB4, 2 },
+    { "IML st", SCD_ADPCM_CODEC_IML, 2 },
+};
+
+#define VERIFY_STREAMS 8
+#define VERIFY_SEED    1
+
+static void put_verify_stats(const char *name, const scd_verify_stats_t *st, int y)
+{
+    char text[44];
+    uint32_t cycles = st->samples ? st->ticks * 3840 / st->samples : 0; // tenths of a cycle
+
+    sprintf(text, "%-7s %7d %5d %3d.%d", name, (int)st->samples, (int)st->errors,
+        (int)(cycles / 10), (int)(cycles % 10));
+    put_str(text, st->errors ? RED_TEXT : WHITE_TEXT, 2, y);
+}
+
+/*
+ * Runs the checks of a driver built with "make VERIFY=1" over the uploaded
+ * samples and seeded random streams of every codec, printing the samples,
+ * mismatched chunks and CPU cycles per sample of the asm decoders - drivers
+ * built without the checks decode nothing, which skips the pass
+ */
+static void verify_decoders(void)
+{
+    scd_verify_stats_t st;
+    int i;
+
+    scd_verify_bufs(&st);
+    if (!st.samples)
+        return;
+
+    clear_screen();
+    put_str("ADPCM decoder check", WHITE_TEXT, 20-9, 2);
+    put_str("        samples  errs cycles", GREEN_TEXT, 2, 4);
+    put_verify_stats("samples", &st, 5);
+
+    for (i = 0; i < sizeof(verify_runs) / sizeof(verify_runs[0]); i++)
+    {
+        scd_verify_random(verify_runs[i].codec, verify_runs[i].channels, VERIFY_STREAMS, VERIFY_SEED, &st);
+        put_verify_stats(verify_runs[i].name, &st, 6 + i);
+    }
+
+    put_str("Press START", WHITE_TEXT, 20-5, 24);
+    while (!(get_pad(0) & SEGA_CTRL_START)) ;
+    while (get_pad(0) & SEGA_CTRL_START) ;
+}
+
 int main(void)
 {
     uint16_t buttons = 0, previous = 0;
@@ -40,7 +102,10 @@ int main(void)
     char text[44];
     uint8_t last_src = 0;
     int16_t pan = 128, vol = 255;
-    uint8_t src_paused[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    int16_t last_pan = pan, last_vol = vol;
+    uint8_t src_paused[SCD_MAX_SOURCES+1] = { 0 };
+    int frames = 0;
+    scd_load_stats_t load;
 
     clear_screen();
 
@@ -94,7 +159,7 @@ int main(void)
     put_str("Decompressing Sub-CPU BIOS", GREEN_TEXT, 2, 3);
     write_word(0xA12002, 0x0002); // no write-protection, bank 0, 2M mode, Word RAM assigned to Sub-CPU
     memset((void *)0x420000, 0, 0x20000); // clear program ram first bank - needed for the LaserActive
-    Kos_Decomp(bios, (uint8_t *)0x420000);
+    Kos_Decomp(bios, (uint8_t *)0x420000, (uint8_t *)0x440000);
 
     /*
      * Copy Sub-CPU program to Program RAM at 0x06000
@@ -141,7 +206,9 @@ int main(void)
     }
 
     /*
-     * Wait for Sub-CPU to indicate it is ready to receive commands
+     * Wait for Sub-CPU to indicate it is ready to receive commands - the drive
+     * is still being initialized at this point, the Sub-CPU finishes that in
+     * between commands, so the samples can be uploaded right away
      */
     while (read_byte(0xA1200F) != 0x00) ;
     put_str("CD initialized and ready to go!", WHITE_TEXT, 20-15, 12);
@@ -160,6 +227,8 @@ int main(void)
     scd_upload_buf(2, &macabre_sb4_wav, macabre_sb4_wav_len);
     scd_upload_buf(3, &stereo_test_u8_wav, stereo_test_u8_wav_len);
 
+    verify_decoders();
+
     clear_screen();
 
     put_str("Mode 1 PCM Player", WHITE_TEXT, 20-8, 2);
@@ -247,7 +316,12 @@ int main(void)
             scd_clear_pcm();
         }
 
-        scd_update_src(last_src, 0, pan, vol, 0);
+        if (pan != last_pan || vol != last_vol)
+        {
+            scd_update_src(last_src, 0, pan, vol, 0);
+            last_pan = pan;
+            last_vol = vol;
+        }
 
         sprintf(text, "%d", last_src);
         put_str("Last Source:   ", GREEN_TEXT, 2, 6);
@@ -263,6 +337,18 @@ int main(void)
         put_str("Volume:        ", GREEN_TEXT, 2, 10);
         put_str(text, WHITE_TEXT, 15, 10);
 
+        // about once a second, show the SegaCD load over the last second
+        if (++frames >= 30)
+        {
+            scd_get_load_stats(&load, 1);
+            frames = 0;
+
+            sprintf(text, "%3d%% %5d %5d", load.elapsed ? (int)(load.busy * 100 / load.elapsed) : 0,
+                (int)load.min_slack, (int)load.underruns);
+            put_str("Load/Slack/Und:", GREEN_TEXT, 2, 12);
+            put_str(text, WHITE_TEXT, 18, 12);
+        }
+
         previous = buttons;
     }
 
@@ -7,7 +7,7 @@
 typedef struct
 {
     uint32_t cmd;
-    uint16_t arg[6];
+    uint16_t arg[7];
 } scd_cmd_t;
 
 #define MAX_SCD_CMDS    16
@@ -25,6 +25,7 @@ static int16_t num_scd_cmds;
 static void scd_delay(void) SCD_CODE_ATTR;
 static char wait_cmd_ack(void) SCD_CODE_ATTR;
 static void wait_do_cmd(char cmd) SCD_CODE_ATTR;
+static void scd_verify_decoders(uint8_t what, uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed, scd_verify_stats_t *stats) SCD_CODE_ATTR;
 
 static char wait_cmd_ack(void)
 {
@@ -56,25 +57,157 @@ void scd_init_pcm(void)
     write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
 }
 
-void scd_upload_buf(uint16_t buf_id, const uint8_t *data, uint32_t data_len)
+uint16_t scd_get_protocol_version(void)
 {
+    uint16_t version = 0;
+
+    wait_do_cmd('Q'); // SfxGetVersion command
+    if (wait_cmd_ack() != 'E') {
+        version = read_long(0xA12020);
+    }
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+    return version;
+}
+
+uint8_t scd_upload_buf(uint16_t buf_id, const uint8_t *data, uint32_t data_len)
+{
+    return scd_upload_buf_rate(buf_id, data, data_len, 0);
+}
+
+uint8_t scd_upload_buf_rate(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate)
+{
+    uint8_t res;
     uint8_t *scdWordRam = (uint8_t *)0x600000;
 
     memcpy(scdWordRam, data, data_len);
 
-    write_word(0xA12010, buf_id); /* buf_id */
+    write_long(0xA12010, ((unsigned)buf_id<<16)|rate); /* buf_id|rate */
     write_long(0xA12014, 0x0C0000); /* word ram on CD side (in 1M mode) */
     write_long(0xA12018, data_len); /* sample length */
     wait_do_cmd('B'); // SfxCopyBuffer command
     wait_cmd_ack();
+    res = read_byte(0xA12020);
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+    return res;
+}
+
+uint8_t scd_upload_buf_kos(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint32_t unpacked_len, uint16_t rate)
+{
+    uint8_t res;
+    uint8_t *scdWordRam = (uint8_t *)0x600000;
+
+    memcpy(scdWordRam, data, data_len);
+
+    write_long(0xA12010, ((unsigned)buf_id<<16)|rate); /* buf_id|rate */
+    write_long(0xA12014, 0x0C0000); /* word ram on CD side (in 1M mode) */
+    write_long(0xA12018, unpacked_len); /* decompressed length */
+    wait_do_cmd('J'); // SfxCopyKosBuffer command
+    wait_cmd_ack();
+    res = read_byte(0xA12020);
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+    return res;
+}
+
+void scd_get_mem_free(uint32_t *free_bytes, uint32_t *largest_free)
+{
+    write_long(0xA12014, 0); /* no inventory */
+    wait_do_cmd('m'); // SfxGetMemInfo command
+    wait_cmd_ack();
+    if (free_bytes) {
+        *free_bytes = read_long(0xA12020);
+    }
+    if (largest_free) {
+        *largest_free = read_long(0xA12024);
+    }
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
+void scd_get_buf_info(scd_mem_stats_t *stats, scd_buf_info_t *bufs)
+{
+    const uint8_t *scdWordRam = (const uint8_t *)0x600000;
+
+    write_long(0xA12014, 0x0C0000); /* word ram on CD side (in 1M mode) */
+    wait_do_cmd('m'); // SfxGetMemInfo command
+    wait_cmd_ack();
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+
+    memcpy(stats, scdWordRam, sizeof(*stats));
+    if (bufs) {
+        memcpy(bufs, scdWordRam + sizeof(*stats), SCD_MAX_BUFFERS * sizeof(*bufs));
+    }
+}
+
+uint32_t scd_get_trace(const uint8_t **dump, int reset)
+{
+    uint32_t size;
+
+    write_long(0xA12010, (reset ? 1 : 0) << 16); /* reset|0 */
+    write_long(0xA12014, 0x0C0000); /* word ram on CD side (in 1M mode) */
+    wait_do_cmd('t'); // SfxGetTrace command
+    size = wait_cmd_ack() != 'E' ? read_long(0xA12020) : 0;
     write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+
+    *dump = (const uint8_t *)0x600000;
+    return size;
+}
+
+static void scd_verify_decoders(uint8_t what, uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed, scd_verify_stats_t *stats)
+{
+    write_long(0xA12010, ((uint32_t)what << 16) | codec); /* what|codec */
+    write_long(0xA12014, ((uint32_t)channels << 16) | streams); /* channels|streams */
+    write_long(0xA12018, seed); /* seed */
+    wait_do_cmd('v'); // SfxVerifyDecoders command
+    if (wait_cmd_ack() != 'E') {
+        stats->samples = read_long(0xA12020);
+        stats->ticks = read_long(0xA12024);
+    } else {
+        stats->samples = 0;
+        stats->ticks = 0;
+    }
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+
+    write_long(0xA12010, 1 << 16); /* errors|0 */
+    wait_do_cmd('v'); // SfxVerifyDecoders command
+    stats->errors = wait_cmd_ack() != 'E' ? read_long(0xA12020) : 0;
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
+void scd_get_verify_stats(scd_verify_stats_t *stats)
+{
+    scd_verify_decoders(0, 0, 0, 0, 0, stats);
+}
+
+void scd_verify_bufs(scd_verify_stats_t *stats)
+{
+    scd_verify_decoders(2, 0, 0, 0, 0, stats);
+}
+
+void scd_verify_random(uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed, scd_verify_stats_t *stats)
+{
+    scd_verify_decoders(3, codec, channels, streams, seed, stats);
 }
 
 uint8_t scd_play_src(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop)
+{
+    return scd_play_src_pri(src_id, buf_id, freq, pan, vol, autoloop, SCD_DEFAULT_PRIORITY);
+}
+
+uint8_t scd_play_src_pri(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority)
+{
+    return scd_play_src_at(src_id, buf_id, freq, pan, vol, autoloop, priority, 0);
+}
+
+uint8_t scd_play_src_at(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset)
+{
+    return scd_play_src_on_bus(src_id, buf_id, freq, pan, vol, autoloop, priority, offset, SCD_BUS_SFX);
+}
+
+uint8_t scd_play_src_on_bus(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset, uint8_t bus)
 {
     write_long(0xA12010, ((unsigned)src_id<<16)|buf_id); /* src|buf_id */
-    write_long(0xA12014, ((unsigned)freq<<16)|pan); /* freq|pan */
-    write_long(0xA12018, ((unsigned)vol<<16)|autoloop); /* vol|autoloop */
+    write_long(0xA12014, ((unsigned)freq<<16)|((unsigned)bus<<8)|pan); /* freq|bus|pan */
+    write_long(0xA12018, ((unsigned)vol<<16)|((unsigned)priority<<8)|autoloop); /* vol|priority|autoloop */
+    write_long(0xA1201C, offset); /* offset */
     wait_do_cmd('A'); // SfxPlaySource command
     wait_cmd_ack();
     src_id = read_byte(0xA12020);
@@ -91,6 +224,89 @@ uint8_t scd_punpause_src(uint8_t src_id, uint8_t paused)
     return src_id;
 }
 
+void scd_punpause_srcs(uint32_t mask, uint8_t paused)
+{
+    write_long(0xA12010, mask); /* mask */
+    write_long(0xA12014, ((unsigned)paused<<16)); /* paused|0 */
+    wait_do_cmd('n'); // SfxPUnPSourceSet command
+    wait_cmd_ack();
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
+void scd_set_buf_defaults(uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint8_t bus)
+{
+    write_long(0xA12010, buf_id); /* 0|buf_id */
+    write_long(0xA12014, ((unsigned)freq<<16)|((unsigned)bus<<8)|pan); /* freq|bus|pan */
+    write_long(0xA12018, ((unsigned)vol<<16)|((unsigned)priority<<8)|autoloop); /* vol|priority|autoloop */
+    wait_do_cmd('b'); // SfxSetBufferDefaults command
+    wait_cmd_ack();
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
+uint8_t scd_play_buf(uint8_t src_id, uint16_t buf_id)
+{
+    write_long(0xA12010, ((unsigned)src_id<<16)|buf_id); /* src|buf_id */
+    wait_do_cmd('a'); // SfxPlayBufferSource command
+    wait_cmd_ack();
+    src_id = read_byte(0xA12020);
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+    return src_id;
+}
+
+void scd_set_buses(uint8_t mask, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused)
+{
+    write_long(0xA12010, ((unsigned)mask<<16)|what); /* mask|what */
+    write_long(0xA12014, ((unsigned)vol<<16)|duck); /* vol|duck */
+    write_long(0xA12018, ((unsigned)paused<<16)); /* paused|0 */
+    wait_do_cmd('X'); // SfxSetBuses command
+    wait_cmd_ack();
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
+void scd_set_bus_vol(uint8_t bus, uint8_t vol)
+{
+    scd_set_buses(SCD_BUS_MASK(bus), SCD_BUS_SET_VOL, vol, 0, 0);
+}
+
+void scd_duck_buses(uint8_t mask, uint8_t duck)
+{
+    scd_set_buses(mask, SCD_BUS_SET_DUCK, 0, duck, 0);
+}
+
+void scd_pause_buses(uint8_t mask, uint8_t paused)
+{
+    scd_set_buses(mask, SCD_BUS_SET_PAUSE, 0, 0, paused);
+}
+
+uint8_t scd_play_module(uint16_t buf_id, uint8_t first_src, uint8_t priority, uint8_t loop)
+{
+    uint8_t res;
+
+    write_long(0xA12010, ((unsigned)buf_id<<16)|first_src); /* buf_id|first_src */
+    write_long(0xA12014, ((unsigned)priority<<16)|loop); /* priority|loop */
+    wait_do_cmd('R'); // SfxPlayModule command
+    wait_cmd_ack();
+    res = read_byte(0xA12020);
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+    return res;
+}
+
+void scd_stop_module(void)
+{
+    scd_play_module(0, 0, 0, 0);
+}
+
+uint16_t scd_get_module_position(void)
+{
+    uint16_t pos;
+
+    wait_do_cmd('r'); // SfxGetModulePosition command
+    wait_cmd_ack();
+    pos = read_word(0xA12020);
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+    return pos;
+}
+
 void scd_update_src(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop)
 {
     write_long(0xA12010, ((unsigned)src_id<<16)); /* src|0 */
@@ -101,6 +317,21 @@ void scd_update_src(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vol, uin
     write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
 }
 
+void scd_automate_src(uint8_t src_id, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags)
+{
+    write_long(0xA12010, ((unsigned)src_id<<16)|param); /* src|param */
+    write_long(0xA12014, ((unsigned)target<<16)|duration); /* target|duration */
+    write_long(0xA12018, ((unsigned)curve<<16)|flags); /* curve|flags */
+    wait_do_cmd('F'); // SfxAutomateSource command
+    wait_cmd_ack();
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
+void scd_fadeout_src(uint8_t src_id, uint16_t duration)
+{
+    scd_automate_src(src_id, SCD_AUTO_ENV, 0, duration, SCD_CURVE_EXP, SCD_AUTO_STOP);
+}
+
 uint16_t scd_getpos_for_src(uint8_t src_id)
 {
     uint16_t pos;
@@ -112,6 +343,17 @@ uint16_t scd_getpos_for_src(uint8_t src_id)
     return pos;
 }
 
+uint32_t scd_getsamplepos_for_src(uint8_t src_id)
+{
+    uint32_t pos;
+    write_long(0xA12010, src_id<<16);
+    wait_do_cmd('H'); // SfxGetSourceSamplePosition command
+    wait_cmd_ack();
+    pos = read_long(0xA12020);
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+    return pos;
+}
+
 void scd_stop_src(uint8_t src_id)
 {
     write_long(0xA12010, ((unsigned)src_id<<16)); /* src|0 */
@@ -120,6 +362,14 @@ void scd_stop_src(uint8_t src_id)
     write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
 }
 
+void scd_stop_srcs(uint32_t mask)
+{
+    write_long(0xA12010, mask); /* mask */
+    wait_do_cmd('o'); // SfxStopSourceSet command
+    wait_cmd_ack();
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
 void scd_rewind_src(uint8_t src_id)
 {
     write_long(0xA12010, ((unsigned)src_id<<16)); /* src|0 */
@@ -128,6 +378,15 @@ void scd_rewind_src(uint8_t src_id)
     write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
 }
 
+void scd_seek_src(uint8_t src_id, uint32_t pos)
+{
+    write_long(0xA12010, ((unsigned)src_id<<16)); /* src|0 */
+    write_long(0xA12014, pos); /* pos */
+    wait_do_cmd('K'); // SfxSeekSource command
+    wait_cmd_ack();
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+}
+
 void scd_clear_pcm(void)
 {
     wait_do_cmd('L'); // SfxClear command
@@ -135,12 +394,54 @@ void scd_clear_pcm(void)
     write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
 }
 
-int scd_get_playback_status(void)
+uint32_t scd_get_playback_status(void)
 {
-    return read_byte(0xA1202F);
+    return read_long(0xA1202C);
+}
+
+uint32_t scd_get_clock(void)
+{
+    uint32_t clock, prev;
+
+    // the SegaCD may update the clock between the two word reads
+    clock = read_long(0xA12028);
+    do {
+        prev = clock;
+        clock = read_long(0xA12028);
+    } while (clock != prev);
+    return clock;
+}
+
+void scd_get_load_stats(scd_load_stats_t *stats, int reset)
+{
+    uint32_t v;
+
+    // the first page takes a snapshot, the second one reads the rest of it
+    write_long(0xA12010, reset ? 1 : 0); /* 0|reset */
+    wait_do_cmd('M'); // SfxGetLoadStats command
+    wait_cmd_ack();
+    stats->elapsed = read_long(0xA12020);
+    stats->busy = read_long(0xA12024);
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
+
+    write_long(0xA12010, 1<<16); /* 1|0 */
+    wait_do_cmd('M'); // SfxGetLoadStats command
+    wait_cmd_ack();
+    v = read_long(0xA12020);
+    stats->refills = v >> 16;
+    stats->underruns = v & 0xFFFF;
+    v = read_long(0xA12024);
+    stats->min_slack = v >> 16;
+    stats->peak = v & 0xFFFF;
+    write_byte(0xA1200E, 0x00); // acknowledge receipt of command result
 }
 
 uint8_t scd_queue_play_src(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop)
+{
+    return scd_queue_play_src_pri(src_id, buf_id, freq, pan, vol, autoloop, SCD_DEFAULT_PRIORITY);
+}
+
+uint8_t scd_queue_play_src_pri(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority)
 {
     scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
     if (num_scd_cmds >= MAX_SCD_CMDS)
@@ -152,6 +453,19 @@ uint8_t scd_queue_play_src(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8
     cmd->arg[3] = pan;
     cmd->arg[4] = vol;
     cmd->arg[5] = autoloop;
+    cmd->arg[6] = priority;
+    num_scd_cmds++;
+    return 0;
+}
+
+uint8_t scd_queue_play_buf(uint8_t src_id, uint16_t buf_id)
+{
+    scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
+    if (num_scd_cmds >= MAX_SCD_CMDS)
+        return 0;
+    cmd->cmd = 'a';
+    cmd->arg[0] = src_id;
+    cmd->arg[1] = buf_id;
     num_scd_cmds++;
     return 0;
 }
@@ -170,6 +484,35 @@ void scd_queue_update_src(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vo
     num_scd_cmds++;
 }
 
+void scd_queue_automate_src(uint8_t src_id, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags)
+{
+    scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
+    if (num_scd_cmds >= MAX_SCD_CMDS)
+        return;
+    cmd->cmd = 'F';
+    cmd->arg[0] = src_id;
+    cmd->arg[1] = param;
+    cmd->arg[2] = target;
+    cmd->arg[3] = duration;
+    cmd->arg[4] = curve;
+    cmd->arg[5] = flags;
+    num_scd_cmds++;
+}
+
+void scd_queue_set_buses(uint8_t mask, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused)
+{
+    scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
+    if (num_scd_cmds >= MAX_SCD_CMDS)
+        return;
+    cmd->cmd = 'X';
+    cmd->arg[0] = mask;
+    cmd->arg[1] = what;
+    cmd->arg[2] = vol;
+    cmd->arg[3] = duck;
+    cmd->arg[4] = paused;
+    num_scd_cmds++;
+}
+
 void scd_queue_stop_src(uint8_t src_id)
 {
     scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
@@ -180,6 +523,29 @@ void scd_queue_stop_src(uint8_t src_id)
     num_scd_cmds++;
 }
 
+void scd_queue_stop_srcs(uint32_t mask)
+{
+    scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
+    if (num_scd_cmds >= MAX_SCD_CMDS)
+        return;
+    cmd->cmd = 'o';
+    cmd->arg[0] = mask >> 16;
+    cmd->arg[1] = mask & 0xFFFF;
+    num_scd_cmds++;
+}
+
+void scd_queue_punpause_srcs(uint32_t mask, uint8_t paused)
+{
+    scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
+    if (num_scd_cmds >= MAX_SCD_CMDS)
+        return;
+    cmd->cmd = 'n';
+    cmd->arg[0] = mask >> 16;
+    cmd->arg[1] = mask & 0xFFFF;
+    cmd->arg[2] = paused;
+    num_scd_cmds++;
+}
+
 void scd_queue_clear_pcm(void)
 {
     scd_cmd_t *cmd = scd_cmds + num_scd_cmds;
@@ -206,14 +572,29 @@ int scd_flush_cmd_queue(void)
     for (i = 0, cmd = scd_cmds; i < num_scd_cmds; i++, cmd++) {
         switch (cmd->cmd) {
             case 'A':
-                scd_play_src(cmd->arg[0], cmd->arg[1], cmd->arg[2], cmd->arg[3], cmd->arg[4], cmd->arg[5]);
+                scd_play_src_pri(cmd->arg[0], cmd->arg[1], cmd->arg[2], cmd->arg[3], cmd->arg[4], cmd->arg[5], cmd->arg[6]);
+                break;
+            case 'a':
+                scd_play_buf(cmd->arg[0], cmd->arg[1]);
                 break;
             case 'U':
                 scd_update_src(cmd->arg[0], cmd->arg[1], cmd->arg[2], cmd->arg[3], cmd->arg[4]);
                 break;
+            case 'F':
+                scd_automate_src(cmd->arg[0], cmd->arg[1], cmd->arg[2], cmd->arg[3], cmd->arg[4], cmd->arg[5]);
+                break;
+            case 'X':
+                scd_set_buses(cmd->arg[0], cmd->arg[1], cmd->arg[2], cmd->arg[3], cmd->arg[4]);
+                break;
             case 'S':
                 scd_stop_src(cmd->arg[0]);
                 break;
+            case 'o':
+                scd_stop_srcs(((uint32_t)cmd->arg[0] << 16) | cmd->arg[1]);
+                break;
+            case 'n':
+                scd_punpause_srcs(((uint32_t)cmd->arg[0] << 16) | cmd->arg[1], cmd->arg[2]);
+                break;
             case 'L':
                 scd_clear_pcm();
                 break;
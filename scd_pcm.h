@@ -6,30 +6,181 @@
 #define SCD_CODE_ATTR
 #endif
 
+#define SCD_MAX_SOURCES         32
+#define SCD_PROTOCOL_VERSION    5
+#define SCD_DEFAULT_PRIORITY    128
+
+// parameters for scd_automate_src
+#define SCD_AUTO_ENV            0
+#define SCD_AUTO_PAN            1
+#define SCD_AUTO_FREQ           2
+
+#define SCD_CURVE_LINEAR        0
+#define SCD_CURVE_EXP           1
+
+#define SCD_AUTO_STOP           1
+
+// source buses
+#define SCD_BUS_SFX             0
+#define SCD_BUS_MUSIC           1
+#define SCD_BUS_VOICE           2
+#define SCD_BUS_UI              3
+#define SCD_NUM_BUSES           4
+
+#define SCD_BUS_MASK(bus)       (1<<(bus))
+#define SCD_ALL_BUSES           ((1<<SCD_NUM_BUSES)-1)
+
+// what scd_set_buses changes
+#define SCD_BUS_SET_VOL         1
+#define SCD_BUS_SET_DUCK        2
+#define SCD_BUS_SET_PAUSE       4
+
+// bit for the source in the masks passed to scd_stop_srcs and scd_punpause_srcs
+#define SCD_SRC_MASK(src_id)    (1UL<<((src_id)-1))
+
+// results of the uploads
+#define SCD_UPLOAD_OK           0
+#define SCD_UPLOAD_BAD_ID       1
+#define SCD_UPLOAD_NO_MEMORY    2
+#define SCD_UPLOAD_BAD_DATA     3
+
+// buffer formats, see scd_buf_info_t
+#define SCD_MAX_BUFFERS         128
+#define SCD_BUF_FORMAT_NONE     0
+#define SCD_BUF_FORMAT_PCM      1 // unsigned 8-bit PCM
+#define SCD_BUF_FORMAT_ADPCM    2
+#define SCD_BUF_FORMAT_PCM_SM   3 // sign/magnitude PCM from scdpack
+
+// ADPCM codecs, see scd_buf_info_t and scd_verify_random
+#define SCD_ADPCM_CODEC_NONE    0
+#define SCD_ADPCM_CODEC_IMA     1
+#define SCD_ADPCM_CODEC_SB4     2
+#define SCD_ADPCM_CODEC_IML     3
+#define SCD_ADPCM_CODEC_SB3     4
+#define SCD_ADPCM_CODEC_SB2     5
+#define SCD_ADPCM_CODEC_DP4     6
+
 // scd_init_pcm initializes the PCM driver
 void scd_init_pcm(void);
 
+// scd_get_protocol_version returns the version of the command set the SegaCD driver
+// understands, SCD_PROTOCOL_VERSION for a driver matching this file, 0 for drivers
+// built before the query was added
+uint16_t scd_get_protocol_version(void) SCD_CODE_ATTR;
+
 // scd_upload_buf copies data to word RAM and sends a request to the SegaCD
 // to copy it to an internal buffer in program RAM
 //
-// value range for buf_id: [1, 256]
+// value range for buf_id: [1, 128]
 // the sample must be under 128KiB due to word RAM limitations in 1M mode
-// the passed data can be a WAV file, for which unsigned 8-bit PCM, IMA ADPCM (codec id: 0x11) 
-// or SB4 ADPCM (codec id: 0x0200) formats are supported, otherwise raw unsigned 8-bit PCM 
-// data is assumed
+// the passed data can be a buffer produced by the scdpack tool, which needs no parsing,
+// or a WAV file, for which unsigned 8-bit PCM, IMA ADPCM (codec id: 0x11),
+// SB4 ADPCM (codec id: 0x0200), its mono-only 3 and 2-bit variants (codec id: 0x0200 with 3 or 2
+// bits per sample), IMA-lite ADPCM (codec id: 0x5C11) or mono DP4 DPCM (codec id: 0x5C04)
+// formats are supported,
+// otherwise raw unsigned 8-bit PCM data is assumed
+// 16-bit and 24-bit PCM WAV files are reduced to 8 bits by the SegaCD as they are copied,
+// so they take as much memory as their 8-bit counterparts
 //
 // replacing data in a previously initialized buffer of sufficient size is supported
 // otherwise a new memory block will be allocated from the available memory pool
 // once the driver runs out of memory, no further allocations will be possible and
 // the driver will have to be re-initialized by calling scd_init_pcm 
-void scd_upload_buf(uint16_t buf_id, const uint8_t *data, uint32_t data_len) SCD_CODE_ATTR;
+//
+// returned value: SCD_UPLOAD_OK, SCD_UPLOAD_NO_MEMORY if the data doesn't fit the memory
+// pool, in which case the buffer keeps its previous data, SCD_UPLOAD_BAD_DATA for broken
+// or unsupported WAV files and scdpack buffers or SCD_UPLOAD_BAD_ID, the SegaCD checks the
+// data before the call returns and copies it after that
+uint8_t scd_upload_buf(uint16_t buf_id, const uint8_t *data, uint32_t data_len) SCD_CODE_ATTR;
+
+// scd_upload_buf_rate is scd_upload_buf, which also resamples PCM WAV files down to the given rate
+// using linear interpolation, saving both memory and the SegaCD time spent on playback
+// ADPCM and raw data without a WAV header are stored as is
+//
+// values for rate: [0, 65535], value of 0 or a value above the rate of the WAV file means "keep the rate"
+uint8_t scd_upload_buf_rate(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint16_t rate) SCD_CODE_ATTR;
+
+// scd_upload_buf_kos is scd_upload_buf_rate for Kosinski compressed data, which the SegaCD
+// decompresses straight into its memory pool, so that samples take less space in the ROM
+// and less time to be copied to word RAM
+//
+// data_len is the size of the compressed data, which must be under 128KiB
+// unpacked_len is the size of the data once decompressed, which the buffer is allocated for
+//
+// returns SCD_UPLOAD_OK, SCD_UPLOAD_BAD_ID or SCD_UPLOAD_NO_MEMORY, broken compressed data or
+// unpacked data the SegaCD doesn't understand leaves the buffer with SCD_BUF_FORMAT_NONE, as
+// the data is only decompressed after the call returns, see scd_get_buf_info
+uint8_t scd_upload_buf_kos(uint16_t buf_id, const uint8_t *data, uint32_t data_len, uint32_t unpacked_len, uint16_t rate) SCD_CODE_ATTR;
+
+// scd_get_mem_free returns the number of free bytes in the memory pool of the SegaCD and
+// the size of the largest buffer that can still be allocated from it, either pointer
+// can be NULL
+void scd_get_mem_free(uint32_t *free_bytes, uint32_t *largest_free) SCD_CODE_ATTR;
+
+typedef struct
+{
+    uint32_t total;         // size of the memory pool in bytes
+    uint32_t free;
+    uint32_t largest_free;
+    uint16_t num_buffers;   // number of buffers holding data
+    uint16_t reserved;
+} scd_mem_stats_t;
+
+typedef struct
+{
+    uint32_t size;          // bytes allocated for the buffer, 0 if it never held data
+    uint32_t data_len;      // bytes of sample data
+    uint16_t freq;
+    uint8_t format;         // SCD_BUF_FORMAT_
+    uint8_t adpcm_codec;    // SCD_ADPCM_CODEC_
+    uint8_t num_channels;
+    uint8_t reserved[3];
+} scd_buf_info_t;
+
+// scd_get_buf_info fills stats and, unless it's NULL, bufs with SCD_MAX_BUFFERS records,
+// one per buffer with bufs[0] for buf_id 1, the records are passed through word RAM,
+// so the call can't be made while data for an upload is being prepared in it
+void scd_get_buf_info(scd_mem_stats_t *stats, scd_buf_info_t *bufs) SCD_CODE_ATTR;
+
+// scd_get_trace snapshots the ring of the last driver events into word RAM, points dump
+// to it and returns its size in bytes, the events are only recorded by a driver built with
+// "make TRACE=1", otherwise the size is 0, the dump stays valid until the next upload or
+// query through word RAM and can be saved to a file and converted with tools/scdtrace,
+// see cd/s_trace.h for the format, a non-zero reset clears the ring after the snapshot
+uint32_t scd_get_trace(const uint8_t **dump, int reset) SCD_CODE_ATTR;
+
+// the SegaCD checks its asm ADPCM decoders against the C ones when built with "make VERIFY=1",
+// samples is the number of samples the asm decoders produced, errors the number of chunks of
+// up to 192 samples that didn't match, ticks the SegaCD clock ticks spent in the asm decoders,
+// see scd_get_clock, at 384 CPU cycles each, ticks * 384 / samples is the cost of a sample
+// in cycles, the clock moves in steps of a timer period, so the figure needs many samples,
+// all the counters are 0 for drivers built without the checks
+typedef struct
+{
+    uint32_t samples;
+    uint32_t ticks;
+    uint32_t errors;
+} scd_verify_stats_t;
+
+// scd_get_verify_stats reads the counters as the playing sources left them
+void scd_get_verify_stats(scd_verify_stats_t *stats) SCD_CODE_ATTR;
+
+// scd_verify_bufs resets the counters and decodes every uploaded ADPCM buffer, the SegaCD
+// doesn't refill its sources while it does that, so nothing should be playing
+void scd_verify_bufs(scd_verify_stats_t *stats) SCD_CODE_ATTR;
+
+// scd_verify_random resets the counters and decodes streams of random blocks of a codec,
+// SCD_ADPCM_CODEC_, with 1 or 2 channels, stereo streams are only supported for IMA, SB4
+// and IML, the same seed produces the same streams, same as scd_verify_bufs nothing should
+// be playing
+void scd_verify_random(uint8_t codec, uint8_t channels, uint16_t streams, uint32_t seed, scd_verify_stats_t *stats) SCD_CODE_ATTR;
 
 // scd_upload_buf starts playback on source from the start of the buffer
 // source is a virtual playback channel, one or two hardware channels can be mapped
 // to a single source
 //
-// value range for src_id: [1, 8] and a special value of 255, which allocates a new free source id
-// value range for buf_id: [1, 256]
+// value range for src_id: [1, 32] and a special value of 255, which allocates a new free source id
+// value range for buf_id: [1, 128]
 // values for freq: [0, 32767] value of 0 means "use frequency derived from the WAVE file"
 // values for pan: [0, 255] value of 255 disables panning, 0 is full left, 128 is center, and 254 is full right
 // values for vol: [0, 255]
@@ -41,14 +192,98 @@ void scd_upload_buf(uint16_t buf_id, const uint8_t *data, uint32_t data_len) SCD
 // otherwise the originally passed value of src_id is returned
 uint8_t scd_play_src(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop) SCD_CODE_ATTR;
 
+// scd_play_src_pri is scd_play_src with an explicit priority, scd_play_src uses SCD_DEFAULT_PRIORITY
+//
+// there are more sources than hardware channels: when all channels are in use, the source
+// starts as a virtual one, its position keeps advancing, and it gets hardware channels either
+// once they are freed or by taking them over from a less audible source on a block boundary
+// sources with higher priority are considered more audible, ties are broken by volume
+//
+// values for priority: [0, 255]
+uint8_t scd_play_src_pri(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority) SCD_CODE_ATTR;
+
+// scd_play_src_at is scd_play_src_pri, which starts playback at the given sample of the buffer
+// instead of its start, e.g. to resume music where it was left off
+//
+// values for offset: [0, 2^32-1], playback ends right away for offsets past the end of the buffer
+uint8_t scd_play_src_at(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset) SCD_CODE_ATTR;
+
+// scd_play_src_on_bus is scd_play_src_at, which puts the source on the given bus,
+// the other scd_play_src calls use SCD_BUS_SFX
+//
+// values for bus: SCD_BUS_SFX, SCD_BUS_MUSIC, SCD_BUS_VOICE or SCD_BUS_UI
+uint8_t scd_play_src_on_bus(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint32_t offset, uint8_t bus) SCD_CODE_ATTR;
+
 // scd_punpause_src pauses or unpauses the source
 //
-// value range for src_id: [1, 8]
+// value range for src_id: [1, 32]
 uint8_t scd_punpause_src(uint8_t src_id, uint8_t paused) SCD_CODE_ATTR;
 
+// scd_punpause_srcs pauses or unpauses every source in the mask in a single command
+//
+// values for mask: a combination of SCD_SRC_MASK(src_id)
+void scd_punpause_srcs(uint32_t mask, uint8_t paused) SCD_CODE_ATTR;
+
+// scd_set_buf_defaults stores the playback parameters for the buffer on the SegaCD,
+// for scd_play_buf to use, the parameters are the same as for scd_play_src_on_bus,
+// until then, and after scd_init_pcm, the buffer plays at the frequency derived from
+// the WAVE file with no panning, full volume, no autoloop, SCD_DEFAULT_PRIORITY
+// and on SCD_BUS_SFX
+void scd_set_buf_defaults(uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority, uint8_t bus) SCD_CODE_ATTR;
+
+// scd_play_buf is scd_play_src_on_bus with the parameters set for the buffer by
+// scd_set_buf_defaults, which makes for a shorter command
+//
+// the returned value is the same as for scd_play_src
+uint8_t scd_play_buf(uint8_t src_id, uint16_t buf_id) SCD_CODE_ATTR;
+
+// scd_set_buses changes the volume, the ducking or the pause state of every bus in the mask
+// in a single command, which affects all sources playing on them, the volume of a source is
+// scaled by the bus volume and then reduced by the ducking, e.g. to keep sound effects down
+// while dialogue plays on SCD_BUS_VOICE, the state of the buses is kept by scd_clear_pcm
+//
+// values for mask: [1, SCD_ALL_BUSES], a combination of SCD_BUS_MASK(bus)
+// values for what: a combination of SCD_BUS_SET_VOL, SCD_BUS_SET_DUCK and SCD_BUS_SET_PAUSE,
+// the values of the fields not in it are ignored
+// values for vol: [0, 255], 255 by default
+// values for duck: [0, 255], 0 by default, leaves the volume unchanged, 255 mutes the bus
+// values for paused: [0, 255], a boolean, sources paused on their own stay paused
+// when their bus is unpaused
+void scd_set_buses(uint8_t mask, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused) SCD_CODE_ATTR;
+
+// shorthands for scd_set_buses
+void scd_set_bus_vol(uint8_t bus, uint8_t vol) SCD_CODE_ATTR;
+void scd_duck_buses(uint8_t mask, uint8_t duck) SCD_CODE_ATTR;
+void scd_pause_buses(uint8_t mask, uint8_t paused) SCD_CODE_ATTR;
+
+// scd_play_module starts playing a tracker module on the SegaCD, which then runs without
+// any further commands, the module is converted from a ProTracker MOD by the modconv tool,
+// which also writes out the instruments: the module and the instruments are uploaded as
+// buffers, the instruments to the buffer ids given to modconv
+//
+// the channels of the module play on consecutive sources starting from first_src, as many
+// as the module has channels, and on SCD_BUS_MUSIC, the module has to be stopped before
+// uploading another one to its buffer
+//
+// value range for buf_id: [1, 128], the buffer holding the module
+// value range for first_src: [1, 32]
+// values for priority: [0, 255], the priority of the sources
+// values for loop: [0, 255], a boolean: the module restarts from its restart position
+// after the end of the order list, otherwise it stops
+//
+// returned value: 1 if the module has started, 0 if it's broken or doesn't fit the sources
+uint8_t scd_play_module(uint16_t buf_id, uint8_t first_src, uint8_t priority, uint8_t loop) SCD_CODE_ATTR;
+
+// scd_stop_module stops the module and its sources
+void scd_stop_module(void) SCD_CODE_ATTR;
+
+// scd_get_module_position returns the order list entry the module is on in the high byte
+// and the row in the low byte, or 0xFFFF if no module is playing
+uint16_t scd_get_module_position(void) SCD_CODE_ATTR;
+
 // scd_update_src updates the frequency, panning, volume and autoloop property for the source
 //
-// value range for src_id: [1, 8] and a special value of 255, which allocates a new free source id
+// value range for src_id: [1, 32]
 // values for freq: [0, 32767] value of 0 means "use frequency derived from the WAVE file"
 // values for pan: [0, 255] value of 255 disables panning, 0 is full left, 128 is center, and 254 is full right
 // values for vol: [0, 255]
@@ -56,40 +291,131 @@ uint8_t scd_punpause_src(uint8_t src_id, uint8_t paused) SCD_CODE_ATTR;
 // reaching the end of the playback buffer
 void scd_update_src(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop) SCD_CODE_ATTR;
 
+// scd_automate_src moves a parameter of the source from its current value to the target value
+// over the given time, the curve is executed by the SegaCD and the values are applied on
+// every refill of the source's playback buffer, which happens every 512 samples
+// a call to scd_update_src cancels all running automation for the source
+//
+// value range for src_id: [1, 32]
+// values for param: SCD_AUTO_ENV, SCD_AUTO_PAN or SCD_AUTO_FREQ
+// values for target: [0, 255] for volume and panning, [0, 32767] for frequency with 0 meaning
+// "use frequency derived from the WAVE file"
+// values for duration: [0, 65535] in milliseconds
+// values for curve: SCD_CURVE_LINEAR or SCD_CURVE_EXP, the latter starts slowly when going
+// up and quickly when going down, which is better suited for volume fades and pitch glides
+// values for flags: 0 or SCD_AUTO_STOP, which stops the source once the target value is reached
+void scd_automate_src(uint8_t src_id, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags) SCD_CODE_ATTR;
+
+// scd_fadeout_src fades out the source over the given time in milliseconds and then stops it
+//
+// value range for src_id: [1, 32]
+void scd_fadeout_src(uint8_t src_id, uint16_t duration) SCD_CODE_ATTR;
+
 // scd_stop_src stops playback on the given source
 //
-// value range for src_id: [1, 8]
+// value range for src_id: [1, 32]
 void scd_stop_src(uint8_t src_id) SCD_CODE_ATTR;
 
+// scd_stop_srcs stops playback on every source in the mask in a single command
+//
+// values for mask: a combination of SCD_SRC_MASK(src_id)
+void scd_stop_srcs(uint32_t mask) SCD_CODE_ATTR;
+
 // scd_rewind_src sets position for the given source to the start of the playback buffer
 //
-// value range for src_id: [1, 8]
+// value range for src_id: [1, 32]
 void scd_rewind_src(uint8_t src_id) SCD_CODE_ATTR;
 
+// scd_seek_src sets position for the given source to the given sample of the playback buffer,
+// the new position is heard from the next refill of the source's playback buffer
+// for ADPCM buffers, the SegaCD jumps straight to the ADPCM block and decodes forward
+// up to the sample within it, so the cost doesn't depend on the position
+//
+// value range for src_id: [1, 32]
+void scd_seek_src(uint8_t src_id, uint32_t pos) SCD_CODE_ATTR;
+
 // scd_getpos_for_src returns playback position for the given source
 //
-// value range for src_id: [1, 8]
+// value range for src_id: [1, 32]
 //
-// returned value: current read position in PCM memory of the ricoh chip for the first channel of the source
+// returned value: current read position in PCM memory of the ricoh chip for the first channel of the source,
+// 0xFFFF for a virtual source
 uint16_t scd_getpos_for_src(uint8_t src_id) SCD_CODE_ATTR;
 
+// scd_getsamplepos_for_src returns the position of the source in the sound
+//
+// value range for src_id: [1, 32]
+//
+// returned value: the number of samples played since the start of playback, counting from the
+// start offset or the position of the last scd_seek_src call and continuing to count up when
+// the source loops, so it needs to be taken modulo the buffer length for a looping source
+// the value is exact to the sample for sources playing on hardware channels, virtual sources
+// advance in steps of the SegaCD timer
+uint32_t scd_getsamplepos_for_src(uint8_t src_id) SCD_CODE_ATTR;
+
 // scd_clear_pcm stops playback on all channels
 void scd_clear_pcm(void) SCD_CODE_ATTR;
 
 // returns playback status mask for all sources
 // if a source is active, it will have its bit set to 1 in the mask:
 // bit 0 for source id 1, bit 1 for source id 2, etc
-int scd_get_playback_status(void) SCD_CODE_ATTR;
+// virtual sources are active too
+uint32_t scd_get_playback_status(void) SCD_CODE_ATTR;
+
+// scd_get_clock returns the free-running SegaCD audio clock, which counts at 32552Hz,
+// the output rate of the PCM chip, and is updated about every 4ms
+// the value is read directly from the communication registers, without a command round trip
+uint32_t scd_get_clock(void) SCD_CODE_ATTR;
+
+// scd_get_load_stats reads the SegaCD load counters, accumulated since the driver was
+// started or since the last call with reset set to a non-zero value
+//
+// busy / elapsed is the share of the SegaCD CPU time spent decoding and painting samples,
+// averaged over the period, both are in SegaCD clock ticks, see scd_get_clock
+// refills counts the double buffer blocks painted for sources playing on hardware channels,
+// underruns counts the ones the PCM chip started playing before they were fully painted
+// or replayed because a refill came too late, which is heard as a glitch, min_slack is the fewest samples the chip had left to play
+// before reaching a block when it was done, the lower it is the closer the driver came
+// to an underrun, 0xFFFF if no block was refilled
+typedef struct
+{
+    uint32_t elapsed;
+    uint32_t busy;
+    uint16_t refills;
+    uint16_t underruns;
+    uint16_t min_slack;
+    uint16_t peak; // longest time spent on a single update of the sources, in steps of about 4ms
+} scd_load_stats_t;
+
+void scd_get_load_stats(scd_load_stats_t *stats, int reset) SCD_CODE_ATTR;
 
 // queues a scd_play_src call, always returns 0
 uint8_t scd_queue_play_src(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop) SCD_CODE_ATTR;
 
+// queues a scd_play_src_pri call, always returns 0
+uint8_t scd_queue_play_src_pri(uint8_t src_id, uint16_t buf_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop, uint8_t priority) SCD_CODE_ATTR;
+
+// queues a scd_play_buf call, always returns 0
+uint8_t scd_queue_play_buf(uint8_t src_id, uint16_t buf_id) SCD_CODE_ATTR;
+
 // queues a scd_update_src call
 void scd_queue_update_src(uint8_t src_id, uint16_t freq, uint8_t pan, uint8_t vol, uint8_t autoloop) SCD_CODE_ATTR;
 
+// queues a scd_automate_src call
+void scd_queue_automate_src(uint8_t src_id, uint8_t param, uint16_t target, uint16_t duration, uint8_t curve, uint8_t flags) SCD_CODE_ATTR;
+
+// queues a scd_set_buses call
+void scd_queue_set_buses(uint8_t mask, uint8_t what, uint8_t vol, uint8_t duck, uint8_t paused) SCD_CODE_ATTR;
+
 // queues a scd_stop_src call
 void scd_queue_stop_src(uint8_t src_id) SCD_CODE_ATTR;
 
+// queues a scd_stop_srcs call
+void scd_queue_stop_srcs(uint32_t mask) SCD_CODE_ATTR;
+
+// queues a scd_punpause_srcs call
+void scd_queue_punpause_srcs(uint32_t mask, uint8_t paused) SCD_CODE_ATTR;
+
 // queues a scd_clear_pcm call
 void scd_queue_clear_pcm(void) SCD_CODE_ATTR;
 
@@ -0,0 +1,197 @@
+// Encodes mono PCM WAV files to DP4, the fixed step DPCM format, see cd/adpcm_dp4.h
+//
+// the 16 deltas are fitted to each sound: starting from a generic set, the encoder
+// repeatedly moves every delta to the average of the changes it was used for
+//
+// usage: dp4enc [-b block_size] input.wav output.wav
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wav.h"
+#include "adpcm_dp4.h"
+
+#define DEFAULT_BLOCK_SIZE 256
+#define FIT_PASSES 12
+
+// level 0 is kept at zero, so there's always a pair of codes in range
+static const int8_t initial_levels[ADPCM_DP4_NUM_LEVELS] = {
+    0, 1, 3, 6, 11, 18, 28, 42, 64, -1, -3, -6, -11, -18, -28, -42
+};
+
+typedef struct
+{
+    double sum[ADPCM_DP4_NUM_LEVELS];
+    uint32_t count[ADPCM_DP4_NUM_LEVELS];
+} fit_t;
+
+// picks the pair of codes that gets the predictor closest to the next two targets,
+// without taking it outside of the range the decoder can't clamp
+static int dp4_encode_pair(const int8_t *levels, int *pred, int t0, int t1, fit_t *fit)
+{
+    int c0, c1, best = 0, best_err = 1 << 30;
+
+    for (c0 = 0; c0 < ADPCM_DP4_NUM_LEVELS; c0++) {
+        int p0 = *pred + levels[c0];
+        if (p0 < 0 || p0 > 255) {
+            continue;
+        }
+        for (c1 = 0; c1 < ADPCM_DP4_NUM_LEVELS; c1++) {
+            int p1 = p0 + levels[c1];
+            int err;
+            if (p1 < 0 || p1 > 255) {
+                continue;
+            }
+            err = (t0 - p0) * (t0 - p0) + (t1 - p1) * (t1 - p1);
+            if (err < best_err) {
+                best = c0 | (c1 << 4);
+                best_err = err;
+            }
+        }
+    }
+
+    c0 = best & 15;
+    c1 = best >> 4;
+    if (fit) {
+        fit->sum[c0] += t0 - *pred;
+        fit->count[c0]++;
+        fit->sum[c1] += t1 - (*pred + levels[c0]);
+        fit->count[c1]++;
+    }
+    *pred += levels[c0] + levels[c1];
+    return best;
+}
+
+// 3-byte header: 16-bit initial predictor and an unused byte, followed by two codes per byte
+static uint32_t dp4_encode(const wav_t *wav, const int8_t *levels, int block_size,
+    uint8_t *out, uint64_t *sqerr, fit_t *fit)
+{
+    uint32_t i = 0, len = 0;
+    int samples_per_block = 1 + (block_size - 3) * 2;
+
+    *sqerr = 0;
+    while (i < wav->frames) {
+        uint8_t *block = out + len;
+        int n = samples_per_block, j, pred;
+
+        if (n > wav->frames - i) {
+            n = wav->frames - i;
+        }
+
+        pred = wav_sample_u8(wav->samples[i++]);
+        block[0] = pred;
+        block[1] = 0;
+        block[2] = 0;
+        len += 3;
+
+        for (j = 1; j < n; j += 2) {
+            int t0 = wav_sample_u8(wav->samples[i]);
+            int t1 = j + 1 < n ? wav_sample_u8(wav->samples[i+1]) : t0;
+            int code, p0;
+
+            code = dp4_encode_pair(levels, &pred, t0, t1, fit);
+            p0 = pred - levels[code >> 4];
+            *sqerr += (t0 - p0) * (t0 - p0);
+            if (j + 1 < n) {
+                *sqerr += (t1 - pred) * (t1 - pred);
+            }
+            out[len++] = code;
+            i += j + 1 < n ? 2 : 1;
+        }
+    }
+
+    return len;
+}
+
+// moves every delta to the average of the changes it has been picked for
+static void dp4_refit(int8_t *levels, const fit_t *fit)
+{
+    int c;
+
+    for (c = 1; c < ADPCM_DP4_NUM_LEVELS; c++) {
+        long v;
+        if (!fit->count[c]) {
+            continue;
+        }
+        v = lround(fit->sum[c] / fit->count[c]);
+        if (v < -128) v = -128;
+        if (v > 127) v = 127;
+        levels[c] = v;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    wav_t wav;
+    FILE *f;
+    uint8_t *out, table[ADPCM_DP4_TABLE_SIZE];
+    int8_t levels[ADPCM_DP4_NUM_LEVELS], best_levels[ADPCM_DP4_NUM_LEVELS];
+    uint32_t len, n;
+    uint64_t sqerr, best_sqerr = UINT64_MAX;
+    int block_size = DEFAULT_BLOCK_SIZE;
+    int argi = 1, pass;
+
+    if (argi + 1 < argc && !strcmp(argv[argi], "-b")) {
+        block_size = atoi(argv[argi + 1]);
+        argi += 2;
+    }
+    if (argc - argi != 2) {
+        fprintf(stderr, "usage: %s [-b block_size] input.wav output.wav\n", argv[0]);
+        return 1;
+    }
+
+    if (block_size < 4) {
+        fprintf(stderr, "block size must be at least 4\n");
+        return 1;
+    }
+
+    if (wav_read(argv[argi], &wav) < 0) {
+        return 1;
+    }
+    if (wav.channels != 1) {
+        fprintf(stderr, "%s: only mono files are supported\n", argv[argi]);
+        return 1;
+    }
+
+    // the worst case is a full header for every sample
+    out = calloc(wav.frames + 1, 3);
+
+    memcpy(levels, initial_levels, sizeof(levels));
+    for (pass = 0; pass < FIT_PASSES; pass++) {
+        fit_t fit;
+
+        memset(&fit, 0, sizeof(fit));
+        dp4_encode(&wav, levels, block_size, out, &sqerr, &fit);
+        if (sqerr < best_sqerr) {
+            best_sqerr = sqerr;
+            memcpy(best_levels, levels, sizeof(levels));
+        }
+        dp4_refit(levels, &fit);
+    }
+
+    len = dp4_encode(&wav, best_levels, block_size, out, &sqerr, NULL);
+    adpcm_dp4_build_table(best_levels, table);
+
+    f = fopen(argv[argi + 1], "wb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open for writing\n", argv[argi + 1]);
+        return 1;
+    }
+    wav_write_adpcm_header(f, WAV_FORMAT_DP4, 1, wav.rate, 4,
+        block_size, 1 + (block_size - 3) * 2, ADPCM_DP4_TABLE_SIZE + len);
+    fwrite(table, 1, sizeof(table), f);
+    fwrite(out, 1, len, f);
+    if (len & 1) {
+        fputc(0, f);
+    }
+    fclose(f);
+
+    n = wav.frames;
+    printf("%u samples, %u bytes, rms error %.2f (8-bit units)\n",
+        n, ADPCM_DP4_TABLE_SIZE + len, n ? sqrt((double)sqerr / n) : 0.0);
+
+    free(out);
+    wav_free(&wav);
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Encodes PCM WAV files to IMA-lite ADPCM, see cd/adpcm_iml.h
+//
+// usage: imalite [-b block_size] input.wav output.wav
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wav.h"
+#include "adpcm_iml.h"
+
+#define DEFAULT_BLOCK_SIZE 256
+
+typedef struct
+{
+    int pred;
+    int index;
+} iml_state_t;
+
+// picks the code that gets the predictor closest to the target,
+// without taking it outside of the range the decoder can't clamp
+static int iml_encode_sample(iml_state_t *st, int target)
+{
+    int code, best = 0, best_err = 1 << 30;
+
+    for (code = 0; code < 16; code++) {
+        int pred = st->pred + adpcm_iml_delta(st->index, code);
+        int err = abs(target - pred);
+        if (pred < 0 || pred > 255) {
+            continue;
+        }
+        if (err < best_err) {
+            best = code;
+            best_err = err;
+        }
+    }
+
+    st->pred += adpcm_iml_delta(st->index, best);
+    st->index = adpcm_iml_next_index(st->index, best);
+    return best;
+}
+
+// 3-byte header: 16-bit initial predictor and step index, followed by two codes per byte
+static uint32_t iml_encode_mono(const wav_t *wav, int block_size, uint8_t *out, uint64_t *sqerr)
+{
+    iml_state_t st = { 0, 0 };
+    uint32_t i = 0, len = 0;
+    int samples_per_block = 1 + (block_size - 3) * 2;
+
+    while (i < wav->frames) {
+        uint8_t *block = out + len;
+        int n = samples_per_block, j;
+
+        if (n > wav->frames - i) {
+            n = wav->frames - i;
+        }
+
+        st.pred = wav_sample_u8(wav->samples[i++]);
+        block[0] = st.pred;
+        block[1] = 0;
+        block[2] = st.index;
+        len += 3;
+
+        for (j = 1; j < n; j += 2) {
+            int t0 = wav_sample_u8(wav->samples[i]);
+            int t1 = i + 1 < wav->frames ? wav_sample_u8(wav->samples[i+1]) : t0;
+            int c0, c1;
+
+            c0 = iml_encode_sample(&st, t0);
+            *sqerr += (t0 - st.pred) * (t0 - st.pred);
+            c1 = iml_encode_sample(&st, t1);
+            if (j + 1 < n) {
+                *sqerr += (t1 - st.pred) * (t1 - st.pred);
+            }
+            out[len++] = c0 | (c1 << 4);
+            i += j + 1 < n ? 2 : 1;
+        }
+    }
+
+    return len;
+}
+
+// a 4-byte header per channel, followed by groups of 4 bytes of left
+// channel data and 4 bytes of right channel data, 8 codes each
+static uint32_t iml_encode_stereo(const wav_t *wav, int block_size, uint8_t *out, uint64_t *sqerr)
+{
+    iml_state_t st[2] = { { 0, 0 }, { 0, 0 } };
+    uint32_t i = 0, len = 0;
+    int groups_per_block = (block_size - 8) / 8;
+
+    while (i < wav->frames) {
+        uint8_t *block = out + len;
+        int g, c;
+
+        for (c = 0; c < 2; c++) {
+            st[c].pred = wav_sample_u8(wav->samples[i*2+c]);
+            block[c*4+0] = st[c].pred;
+            block[c*4+1] = 0;
+            block[c*4+2] = st[c].index;
+            block[c*4+3] = 0;
+        }
+        len += 8;
+        i++;
+
+        for (g = 0; g < groups_per_block && i < wav->frames; g++) {
+            for (c = 0; c < 2; c++) {
+                int j;
+                for (j = 0; j < 8; j++) {
+                    // the trailing partial group is padded with the last sample
+                    uint32_t f = i + j < wav->frames ? i + j : wav->frames - 1;
+                    int t = wav_sample_u8(wav->samples[f*2+c]);
+                    int code = iml_encode_sample(&st[c], t);
+                    if (i + j < wav->frames) {
+                        *sqerr += (t - st[c].pred) * (t - st[c].pred);
+                    }
+                    if (j & 1) {
+                        out[len + c*4 + (j >> 1)] |= code << 4;
+                    } else {
+                        out[len + c*4 + (j >> 1)] = code;
+                    }
+                }
+            }
+            len += 8;
+            i += 8;
+        }
+    }
+
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    wav_t wav;
+    FILE *f;
+    uint8_t *out;
+    uint32_t len, samples_per_block, n;
+    uint64_t sqerr = 0;
+    int block_size = DEFAULT_BLOCK_SIZE;
+    int argi = 1;
+
+    if (argi + 1 < argc && !strcmp(argv[argi], "-b")) {
+        block_size = atoi(argv[argi + 1]);
+        argi += 2;
+    }
+    if (argc - argi != 2) {
+        fprintf(stderr, "usage: %s [-b block_size] input.wav output.wav\n", argv[0]);
+        return 1;
+    }
+
+    if (wav_read(argv[argi], &wav) < 0) {
+        return 1;
+    }
+
+    if (wav.channels == 2) {
+        if (block_size < 16 || block_size % 8) {
+            fprintf(stderr, "block size for stereo files must be a multiple of 8, at least 16\n");
+            return 1;
+        }
+        samples_per_block = 1 + (block_size - 8);
+    } else {
+        if (block_size < 4) {
+            fprintf(stderr, "block size must be at least 4\n");
+            return 1;
+        }
+        samples_per_block = 1 + (block_size - 3) * 2;
+    }
+
+    // the worst case is a full header for every sample
+    out = calloc(wav.frames + 1, 8 + 1);
+    if (wav.channels == 2) {
+        len = iml_encode_stereo(&wav, block_size, out, &sqerr);
+    } else {
+        len = iml_encode_mono(&wav, block_size, out, &sqerr);
+    }
+
+    f = fopen(argv[argi + 1], "wb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open for writing\n", argv[argi + 1]);
+        return 1;
+    }
+    wav_write_adpcm_header(f, WAV_FORMAT_IMA_LITE, wav.channels, wav.rate, 4,
+        block_size, samples_per_block, len);
+    fwrite(out, 1, len, f);
+    if (len & 1) {
+        fputc(0, f);
+    }
+    fclose(f);
+
+    n = wav.frames * wav.channels;
+    printf("%u samples, %u bytes, rms error %.2f (8-bit units)\n",
+        n, len, n ? sqrt((double)sqerr / n) : 0.0);
+
+    free(out);
+    wav_free(&wav);
+    return 0;
+}
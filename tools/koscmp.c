@@ -0,0 +1,199 @@
+// Compresses files to the Kosinski format, for scd_upload_buf_kos
+//
+// usage: koscmp input output
+//
+// prints the size of the input, which is to be passed as unpacked_len
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define WINDOW 8192         // the farthest back a match can start
+#define INLINE_WINDOW 256   // same for the short matches
+#define MAX_MATCH 256
+#define HASH_SIZE 65536
+#define MAX_CHAIN 512
+
+typedef struct
+{
+    uint8_t *out;
+    uint32_t len;
+    uint32_t desc_pos; // where the description field being filled goes
+    uint16_t desc;
+    int bits;
+} kos_writer_t;
+
+// description fields are read ahead by the decompressor: the next one is
+// needed as soon as the last bit of the previous one has been consumed
+static void kos_put_bit(kos_writer_t *w, int bit)
+{
+    w->desc |= bit << w->bits;
+    if (++w->bits == 16) {
+        w->out[w->desc_pos] = w->desc & 0xff;
+        w->out[w->desc_pos + 1] = w->desc >> 8;
+        w->desc_pos = w->len;
+        w->len += 2;
+        w->desc = 0;
+        w->bits = 0;
+    }
+}
+
+static void kos_put_byte(kos_writer_t *w, uint8_t b)
+{
+    w->out[w->len++] = b;
+}
+
+static void kos_finish(kos_writer_t *w)
+{
+    // the end marker
+    kos_put_bit(w, 0);
+    kos_put_bit(w, 1);
+    kos_put_byte(w, 0x00);
+    kos_put_byte(w, 0xF0);
+    kos_put_byte(w, 0x00);
+
+    w->out[w->desc_pos] = w->desc & 0xff;
+    w->out[w->desc_pos + 1] = w->desc >> 8;
+}
+
+static uint32_t kos_hash(const uint8_t *p)
+{
+    return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & (HASH_SIZE - 1);
+}
+
+// greedy parsing with hash chains over 3-byte sequences
+static uint32_t kos_compress(const uint8_t *in, uint32_t in_len, uint8_t *out)
+{
+    kos_writer_t w = { out, 2, 0, 0, 0 };
+    int32_t *head = malloc(HASH_SIZE * sizeof(int32_t));
+    int32_t *prev = malloc((in_len + 1) * sizeof(int32_t));
+    uint32_t i = 0, j;
+
+    for (j = 0; j < HASH_SIZE; j++) {
+        head[j] = -1;
+    }
+
+    while (i < in_len) {
+        uint32_t best_len = 0, best_dist = 0, step;
+        uint32_t max_len = in_len - i < MAX_MATCH ? in_len - i : MAX_MATCH;
+
+        if (i + 3 <= in_len) {
+            int32_t cand = head[kos_hash(in + i)];
+            int chain = 0;
+
+            while (cand >= 0 && i - cand <= WINDOW && chain++ < MAX_CHAIN) {
+                uint32_t l = 0;
+                while (l < max_len && in[cand + l] == in[i + l]) {
+                    l++;
+                }
+                if (l > best_len) {
+                    best_len = l;
+                    best_dist = i - cand;
+                    if (l == max_len) {
+                        break;
+                    }
+                }
+                cand = prev[cand];
+            }
+        }
+
+        // a 2-byte match only pays off when it's close enough to be stored inline
+        if (best_len < 3 && i >= 1) {
+            uint32_t d, lim = i < INLINE_WINDOW ? i : INLINE_WINDOW;
+            for (d = 1; d <= lim && best_len < 2; d++) {
+                if (max_len >= 2 && in[i - d] == in[i] && in[i - d + 1] == in[i + 1]) {
+                    best_len = 2;
+                    best_dist = d;
+                }
+            }
+        }
+
+        if (best_len >= 2 && best_len <= 5 && best_dist <= INLINE_WINDOW) {
+            int count = best_len - 2;
+            kos_put_bit(&w, 0);
+            kos_put_bit(&w, 0);
+            kos_put_bit(&w, (count >> 1) & 1);
+            kos_put_bit(&w, count & 1);
+            kos_put_byte(&w, (uint8_t)(-(int32_t)best_dist));
+            step = best_len;
+        } else if (best_len >= 3) {
+            uint16_t offset = (uint16_t)(-(int32_t)best_dist);
+            kos_put_bit(&w, 0);
+            kos_put_bit(&w, 1);
+            kos_put_byte(&w, offset & 0xff);
+            if (best_len <= 9) {
+                kos_put_byte(&w, ((offset >> 5) & 0xf8) | (best_len - 2));
+            } else {
+                kos_put_byte(&w, (offset >> 5) & 0xf8);
+                kos_put_byte(&w, best_len - 1);
+            }
+            step = best_len;
+        } else {
+            kos_put_bit(&w, 1);
+            kos_put_byte(&w, in[i]);
+            step = 1;
+        }
+
+        while (step--) {
+            if (i + 3 <= in_len) {
+                uint32_t h = kos_hash(in + i);
+                prev[i] = head[h];
+                head[h] = i;
+            }
+            i++;
+        }
+    }
+
+    kos_finish(&w);
+
+    free(head);
+    free(prev);
+    return w.len;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f;
+    uint8_t *in, *out;
+    long in_len;
+    uint32_t len;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s input output\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open for reading\n", argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    in_len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    in = malloc(in_len + 1);
+    if (fread(in, 1, in_len, f) != (size_t)in_len) {
+        fprintf(stderr, "%s: read error\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    // the worst case is 9 bits for every byte, plus the end marker
+    out = malloc(in_len + in_len / 8 + 16);
+    len = kos_compress(in, in_len, out);
+
+    f = fopen(argv[2], "wb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open for writing\n", argv[2]);
+        return 1;
+    }
+    fwrite(out, 1, len, f);
+    fclose(f);
+
+    printf("%ld bytes unpacked, %u bytes packed\n", in_len, len);
+
+    free(in);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,413 @@
+// Converts a ProTracker MOD into a module for the tracker of the SegaCD driver, see
+// cd/s_module.h for the format, along with an 8-bit WAV file for each of its samples
+//
+// usage: modconv [-b first_buf] input.mod output.scdm
+//
+// the samples are written next to the module as output_NN.wav, NN being the number of
+// the instrument, and get consecutive buffer ids starting from first_buf (1 by default),
+// in the order of the instruments, a "load" line for each of them is printed, which can
+// be used as is in an scdrender script
+//
+// the finetune of the instruments is applied to the periods of the notes, the Cxx
+// effect is turned into the volume of the cell, and the data of looping samples past
+// the end of their loop is dropped, effects the driver doesn't support are dropped too:
+// 7xy, E0x, E3x-E8x, EEx and EFx
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wav.h"
+#include "s_buffers.h"
+#include "s_module.h"
+
+#define MOD_HEADER_SIZE 1084
+#define MOD_INSTS 31
+#define MOD_ORDERS 128
+#define MOD_RATE 8287 // C-2 on a PAL Amiga
+#define MAX_NAME 4096
+#define MAX_PATH (MAX_NAME + 16)
+
+typedef struct
+{
+    const uint8_t *data;
+    uint32_t len;
+    uint32_t loop_start; // in samples
+    int loop;
+    int finetune;
+    int vol;
+    int buf_id;
+} mod_inst_t;
+
+typedef struct
+{
+    uint8_t *data;
+    uint32_t len, size;
+} out_t;
+
+static void put_byte(out_t *out, int b)
+{
+    if (out->len == out->size) {
+        out->size = out->size ? out->size * 2 : 4096;
+        out->data = realloc(out->data, out->size);
+    }
+    out->data[out->len++] = b;
+}
+
+static void put_word(out_t *out, int w)
+{
+    put_byte(out, w >> 8);
+    put_byte(out, w & 0xFF);
+}
+
+static void put_long(out_t *out, uint32_t l)
+{
+    put_word(out, l >> 16);
+    put_word(out, l & 0xFFFF);
+}
+
+static void set_long(out_t *out, uint32_t pos, uint32_t l)
+{
+    out->data[pos] = l >> 24;
+    out->data[pos + 1] = l >> 16;
+    out->data[pos + 2] = l >> 8;
+    out->data[pos + 3] = l;
+}
+
+static int get_word(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static int mod_channels(const uint8_t *tag)
+{
+    if (!memcmp(tag, "M.K.", 4) || !memcmp(tag, "M!K!", 4) || !memcmp(tag, "FLT4", 4) || !memcmp(tag, "4CHN", 4)) {
+        return 4;
+    }
+    if (!memcmp(tag, "6CHN", 4)) {
+        return 6;
+    }
+    if (!memcmp(tag, "8CHN", 4) || !memcmp(tag, "FLT8", 4) || !memcmp(tag, "CD81", 4) || !memcmp(tag, "OKTA", 4)) {
+        return 8;
+    }
+    return 0;
+}
+
+// each finetune step is an eighth of a semitone
+static int finetune_period(int period, int finetune)
+{
+    if (finetune == 0) {
+        return period;
+    }
+    return (int)(period * pow(2.0, -finetune / 96.0) + 0.5);
+}
+
+static int supported_effect(int fx, int param)
+{
+    if (fx == 0x7) {
+        return 0;
+    }
+    if (fx == 0xE) {
+        switch (param >> 4) {
+            case 0x1: case 0x2: case 0x9: case 0xA: case 0xB: case 0xC: case 0xD:
+                return 1;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+static int write_inst(const char *path, const mod_inst_t *inst)
+{
+    FILE *f = fopen(path, "wb");
+    uint8_t *u8;
+    uint32_t i;
+
+    if (!f) {
+        fprintf(stderr, "%s: can't create\n", path);
+        return -1;
+    }
+    u8 = malloc(inst->len);
+    for (i = 0; i < inst->len; i++) {
+        u8[i] = (uint8_t)((int8_t)inst->data[i] + 128);
+    }
+    wav_write_pcm8(f, 1, MOD_RATE, inst->len, u8);
+    free(u8);
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    mod_inst_t insts[MOD_INSTS];
+    uint8_t *mod;
+    const uint8_t *p, *sample;
+    uint32_t mod_len, patterns_pos;
+    int argi = 1, first_buf = 1, next_buf;
+    int num_channels, num_orders, restart, num_patterns, num_insts = 0;
+    int cur_inst[S_MOD_MAX_CHANNELS];
+    uint8_t converted[256];
+    int i, j, r, dropped = 0;
+    char base[MAX_NAME], path[MAX_PATH];
+    const char *dot;
+    out_t out = { 0 };
+    FILE *f;
+    long size;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (!strcmp(argv[argi], "-b") && argi + 1 < argc) {
+            first_buf = atoi(argv[++argi]);
+        } else {
+            break;
+        }
+        argi++;
+    }
+    if (argc - argi != 2) {
+        fprintf(stderr, "usage: %s [-b first_buf] input.mod output.scdm\n", argv[0]);
+        return 1;
+    }
+    if (first_buf < 1 || first_buf > S_MAX_BUFFERS) {
+        fprintf(stderr, "first_buf must be in [1, %d]\n", S_MAX_BUFFERS);
+        return 1;
+    }
+
+    f = fopen(argv[argi], "rb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open\n", argv[argi]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    mod = malloc(size > 0 ? size : 1);
+    if (fread(mod, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: can't read\n", argv[argi]);
+        return 1;
+    }
+    fclose(f);
+    mod_len = size;
+
+    if (mod_len < MOD_HEADER_SIZE || !(num_channels = mod_channels(mod + 1080))) {
+        fprintf(stderr, "%s: not a 31 instrument MOD with 4, 6 or 8 channels\n", argv[argi]);
+        return 1;
+    }
+
+    num_orders = mod[950];
+    restart = mod[951];
+    if (num_orders == 0 || num_orders > MOD_ORDERS) {
+        fprintf(stderr, "%s: bad song length\n", argv[argi]);
+        return 1;
+    }
+    if (restart >= num_orders || restart == 127) {
+        restart = 0;
+    }
+
+    num_patterns = 0;
+    for (i = 0; i < MOD_ORDERS; i++) {
+        if (mod[952 + i] + 1 > num_patterns) {
+            num_patterns = mod[952 + i] + 1;
+        }
+    }
+    if (num_patterns > 255) {
+        fprintf(stderr, "%s: too many patterns\n", argv[argi]);
+        return 1;
+    }
+
+    patterns_pos = MOD_HEADER_SIZE;
+    sample = mod + patterns_pos + num_patterns * S_MOD_ROWS * num_channels * 4;
+    if (sample > mod + mod_len) {
+        fprintf(stderr, "%s: truncated patterns\n", argv[argi]);
+        return 1;
+    }
+
+    snprintf(base, sizeof(base), "%s", argv[argi + 1]);
+    dot = strrchr(base, '.');
+    if (dot && !strchr(dot, '/')) {
+        base[dot - base] = '\0';
+    }
+
+    next_buf = first_buf;
+    for (i = 0; i < MOD_INSTS; i++) {
+        mod_inst_t *inst = &insts[i];
+        const uint8_t *h = mod + 20 + i * 30;
+        uint32_t len = get_word(h + 22) * 2;
+        uint32_t loop_start = get_word(h + 26) * 2;
+        uint32_t loop_len = get_word(h + 28) * 2;
+
+        memset(inst, 0, sizeof(*inst));
+        inst->finetune = (h[24] & 0x0F) < 8 ? (h[24] & 0x0F) : (h[24] & 0x0F) - 16;
+        inst->vol = h[25] > 64 ? 64 : h[25];
+
+        if (sample + len > mod + mod_len) {
+            len = mod + mod_len > sample ? mod + mod_len - sample : 0;
+        }
+        inst->data = sample;
+        inst->len = len;
+        sample += len;
+
+        if (loop_len > 2 && loop_start < len) {
+            inst->loop = 1;
+            inst->loop_start = loop_start;
+            if (loop_start + loop_len < len) {
+                inst->len = loop_start + loop_len;
+            }
+        }
+
+        if (inst->len == 0) {
+            continue;
+        }
+        if (next_buf > S_MAX_BUFFERS) {
+            fprintf(stderr, "%s: out of buffer ids\n", argv[argi]);
+            return 1;
+        }
+
+        inst->buf_id = next_buf++;
+        num_insts = i + 1;
+
+        snprintf(path, sizeof(path), "%s_%02d.wav", base, i + 1);
+        if (write_inst(path, inst) < 0) {
+            return 1;
+        }
+        printf("load %d %s\n", inst->buf_id, path);
+    }
+
+    // header
+    put_byte(&out, 'S');
+    put_byte(&out, 'C');
+    put_byte(&out, 'D');
+    put_byte(&out, 'M');
+    put_byte(&out, num_channels);
+    put_byte(&out, num_insts);
+    put_byte(&out, num_orders);
+    put_byte(&out, restart);
+    put_byte(&out, num_patterns);
+    put_byte(&out, 6);
+    put_byte(&out, 125);
+    put_byte(&out, 0);
+
+    for (i = 0; i < num_insts; i++) {
+        put_byte(&out, insts[i].buf_id);
+        put_byte(&out, insts[i].vol);
+        put_byte(&out, insts[i].loop ? S_MOD_INST_LOOP : 0);
+        put_byte(&out, 0);
+        put_long(&out, insts[i].loop_start);
+    }
+
+    for (i = 0; i < num_orders; i++) {
+        put_byte(&out, mod[952 + i]);
+    }
+    if (num_orders & 1) {
+        put_byte(&out, 0);
+    }
+
+    patterns_pos = out.len;
+    for (i = 0; i < num_patterns; i++) {
+        put_long(&out, 0);
+    }
+
+    // the patterns are converted in the order they're played in, so that the notes
+    // get the finetune of the instrument last set on their channel, an offset left
+    // at 0 marks a pattern not converted yet
+    memset(cur_inst, 0, sizeof(cur_inst));
+    memset(converted, 0, sizeof(converted));
+
+    for (j = 0; j < num_orders + num_patterns; j++) {
+        int pat = j < num_orders ? mod[952 + j] : j - num_orders;
+
+        if (converted[pat]) {
+            continue;
+        }
+        converted[pat] = 1;
+        set_long(&out, patterns_pos + pat * 4, out.len);
+
+        p = mod + MOD_HEADER_SIZE + pat * S_MOD_ROWS * num_channels * 4;
+        for (r = 0; r < S_MOD_ROWS; r++) {
+            out_t row = { 0 };
+            int mask = 0;
+
+            for (i = 0; i < num_channels; i++, p += 4) {
+                int inst = (p[0] & 0xF0) | (p[2] >> 4);
+                int period = ((p[0] & 0x0F) << 8) | p[1];
+                int fx = p[2] & 0x0F;
+                int param = p[3];
+                int vol = -1;
+                int fields = 0;
+
+                if (inst > MOD_INSTS) {
+                    inst = 0;
+                }
+                if (inst) {
+                    cur_inst[i] = inst;
+                }
+                if (fx == 0xC) {
+                    vol = param > 64 ? 64 : param;
+                    fx = param = 0;
+                }
+                if ((fx || param) && !supported_effect(fx, param)) {
+                    dropped++;
+                    fx = param = 0;
+                }
+
+                if (period) {
+                    fields |= S_MOD_CELL_NOTE;
+                    if (cur_inst[i]) {
+                        period = finetune_period(period, insts[cur_inst[i] - 1].finetune);
+                    }
+                }
+                if (inst) {
+                    fields |= S_MOD_CELL_INST;
+                }
+                if (vol >= 0) {
+                    fields |= S_MOD_CELL_VOL;
+                }
+                if (fx || param) {
+                    fields |= S_MOD_CELL_FX;
+                }
+                if (!fields) {
+                    continue;
+                }
+
+                mask |= 1 << i;
+                put_byte(&row, fields);
+                if (fields & S_MOD_CELL_NOTE) {
+                    put_word(&row, period);
+                }
+                if (fields & S_MOD_CELL_INST) {
+                    put_byte(&row, inst);
+                }
+                if (fields & S_MOD_CELL_VOL) {
+                    put_byte(&row, vol);
+                }
+                if (fields & S_MOD_CELL_FX) {
+                    put_byte(&row, fx);
+                    put_byte(&row, param);
+                }
+            }
+
+            put_byte(&out, mask);
+            for (i = 0; i < (int)row.len; i++) {
+                put_byte(&out, row.data[i]);
+            }
+            free(row.data);
+        }
+    }
+
+    if (dropped) {
+        fprintf(stderr, "%s: dropped %d unsupported effects\n", argv[argi], dropped);
+    }
+
+    f = fopen(argv[argi + 1], "wb");
+    if (!f) {
+        fprintf(stderr, "%s: can't create\n", argv[argi + 1]);
+        return 1;
+    }
+    fwrite(out.data, 1, out.len, f);
+    fclose(f);
+
+    fprintf(stderr, "%s: %d channels, %d orders, %d patterns, %u bytes\n", argv[argi + 1],
+        num_channels, num_orders, num_patterns, (unsigned)out.len);
+
+    free(out.data);
+    free(mod);
+    return 0;
+}
@@ -0,0 +1,442 @@
+// Encodes PCM WAV files to Creative style SB4, SB3 (2.6 bits per sample)
+// and SB2 (2 bits per sample) ADPCM, see cd/adpcm_sb.h
+//
+// usage: sbenc -4|-3|-2 [-t] [-j threads] [-b block_size] input.wav output.wav [input2.wav output2.wav ...]
+//
+// -t picks the codes with a trellis search, which finds the sequence with the least squared
+// error over a whole block, instead of the greedy sample by sample choice
+//
+// every block starts from a fresh predictor, so blocks of all files are encoded in parallel
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "wav.h"
+#include "adpcm_sb.h"
+
+#define DEFAULT_BLOCK_SIZE 256
+#define MAX_THREADS 64
+
+#define NUM_STATES (256 * (ADPCM_SB_MAX_STEP + 1)) // predictor * step
+
+typedef struct
+{
+    const char *in_path, *out_path;
+    wav_t wav;
+    uint32_t samples_per_block;
+    uint32_t num_blocks;
+    uint32_t len; // of the encoded data
+    uint8_t *out;
+    uint64_t sqerr;
+} sb_file_t;
+
+typedef struct
+{
+    int bits; // 4, 3 or 2
+    int trellis;
+    int block_size;
+    sb_file_t *files;
+    int num_files;
+
+    pthread_mutex_t lock;
+    int next_file;
+    uint32_t next_block;
+} sb_job_t;
+
+// code size and shift for the code at the given position within a block
+static void sb_code_kind(int bits, int pos, int *code_bits, int *shift)
+{
+    switch (bits) {
+        case 4:
+            *code_bits = ADPCM_SB4_BITS;
+            *shift = ADPCM_SB4_SHIFT;
+            break;
+        case 3:
+            *code_bits = pos % 3 == 2 ? ADPCM_SB3_LAST_BITS : ADPCM_SB3_BITS;
+            *shift = ADPCM_SB3_SHIFT;
+            break;
+        default:
+            *code_bits = ADPCM_SB2_BITS;
+            *shift = ADPCM_SB2_SHIFT;
+            break;
+    }
+}
+
+// the decoder clamps the predictor
+static int sb_next_pred(int pred, int code_bits, int shift, int step, int code)
+{
+    pred += adpcm_sb_delta(code_bits, shift, step, code);
+    if (pred < 0) pred = 0;
+    if (pred > 255) pred = 255;
+    return pred;
+}
+
+// picks the code that gets the predictor closest to each target in turn
+static int sb_encode_greedy(int bits, int pred, const uint8_t *targets, int n, uint8_t *codes)
+{
+    int i, step = 0;
+
+    for (i = 0; i < n; i++) {
+        int code_bits, shift, code, best = 0, best_err = 1 << 30;
+
+        sb_code_kind(bits, i, &code_bits, &shift);
+        for (code = 0; code < (1 << code_bits); code++) {
+            int err = abs(targets[i] - sb_next_pred(pred, code_bits, shift, step, code));
+            if (err < best_err) {
+                best = code;
+                best_err = err;
+            }
+        }
+
+        codes[i] = best;
+        pred = sb_next_pred(pred, code_bits, shift, step, best);
+        step = adpcm_sb_next_step(code_bits, step, best);
+    }
+
+    return 0;
+}
+
+// Viterbi search over all predictor and step combinations, the state space is small
+// enough for the result to be the best sequence of codes for the block, including
+// the choice of the initial step
+static int sb_encode_trellis(int bits, int pred, const uint8_t *targets, int n, uint8_t *codes)
+{
+    uint32_t *cost = malloc(NUM_STATES * sizeof(uint32_t));
+    uint32_t *next_cost = malloc(NUM_STATES * sizeof(uint32_t));
+    uint16_t *path = malloc((size_t)n * NUM_STATES * sizeof(uint16_t)); // prev state << 4 | code
+    int i, s, step, code, best = 0;
+    int delta[ADPCM_SB_MAX_STEP+1][16], next_step[ADPCM_SB_MAX_STEP+1][16];
+
+    for (s = 0; s < NUM_STATES; s++) {
+        cost[s] = (s >> 2) == pred ? 0 : UINT32_MAX;
+    }
+
+    for (i = 0; i < n; i++) {
+        int code_bits, shift, t = targets[i];
+        uint16_t *p = path + (size_t)i * NUM_STATES;
+
+        sb_code_kind(bits, i, &code_bits, &shift);
+        for (s = 0; s < NUM_STATES; s++) {
+            next_cost[s] = UINT32_MAX;
+        }
+
+        for (step = 0; step <= ADPCM_SB_MAX_STEP; step++) {
+            for (code = 0; code < (1 << code_bits); code++) {
+                delta[step][code] = adpcm_sb_delta(code_bits, shift, step, code);
+                next_step[step][code] = adpcm_sb_next_step(code_bits, step, code);
+            }
+        }
+
+        for (s = 0; s < NUM_STATES; s++) {
+            step = s & 3;
+            if (cost[s] == UINT32_MAX) {
+                continue;
+            }
+            for (code = 0; code < (1 << code_bits); code++) {
+                int np = (s >> 2) + delta[step][code];
+                int ns;
+                uint32_t c;
+
+                if (np < 0) np = 0;
+                if (np > 255) np = 255;
+                ns = (np << 2) | next_step[step][code];
+                c = cost[s] + (t - np) * (t - np);
+                if (c < next_cost[ns]) {
+                    next_cost[ns] = c;
+                    p[ns] = (s << 4) | code;
+                }
+            }
+        }
+
+        memcpy(cost, next_cost, NUM_STATES * sizeof(uint32_t));
+    }
+
+    for (s = 1; s < NUM_STATES; s++) {
+        if (cost[s] < cost[best]) {
+            best = s;
+        }
+    }
+    for (i = n - 1; i >= 0; i--) {
+        uint16_t p = path[(size_t)i * NUM_STATES + best];
+        codes[i] = p & 15;
+        best = p >> 4;
+    }
+
+    free(cost);
+    free(next_cost);
+    free(path);
+    return best & 3;
+}
+
+// decodes the codes the way the driver does, for the error stats
+static uint64_t sb_sqerr(int bits, int pred, int step, const uint8_t *targets, int n, const uint8_t *codes)
+{
+    uint64_t sqerr = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        int code_bits, shift;
+        sb_code_kind(bits, i, &code_bits, &shift);
+        pred = sb_next_pred(pred, code_bits, shift, step, codes[i]);
+        step = adpcm_sb_next_step(code_bits, step, codes[i]);
+        sqerr += (targets[i] - pred) * (targets[i] - pred);
+    }
+    return sqerr;
+}
+
+// encodes the given channel of a block, returns the initial step
+static int sb_encode_channel(const sb_job_t *job, const sb_file_t *file, uint32_t first, int n, int padded,
+    int c, uint8_t *codes, uint64_t *sqerr)
+{
+    const wav_t *wav = &file->wav;
+    uint8_t targets[65536];
+    int i, pred, step;
+
+    // a trailing partial byte or group is padded with the last sample
+    for (i = 0; i < padded; i++) {
+        uint32_t f = first + 1 + (i < n ? i : n - 1);
+        targets[i] = wav_sample_u8(wav->samples[f * wav->channels + c]);
+    }
+
+    pred = wav_sample_u8(wav->samples[first * wav->channels + c]);
+    if (job->trellis) {
+        step = sb_encode_trellis(job->bits, pred, targets, padded, codes);
+    } else {
+        step = sb_encode_greedy(job->bits, pred, targets, padded, codes);
+    }
+
+    *sqerr += sb_sqerr(job->bits, pred, step, targets, n, codes);
+    return step;
+}
+
+// mono blocks: 3-byte header with the 16-bit initial predictor and step,
+// followed by codes packed from the lowest bits of each byte up
+//
+// stereo blocks: a 4-byte header per channel, followed by groups of 4 bytes
+// of left channel data and 4 bytes of right channel data, 8 codes each
+static void sb_encode_block(const sb_job_t *job, sb_file_t *file, uint32_t b, uint64_t *sqerr)
+{
+    const wav_t *wav = &file->wav;
+    uint32_t first = b * file->samples_per_block;
+    uint8_t *block = file->out + (size_t)b * job->block_size;
+    uint8_t codes[2][65536];
+    int n, c, i;
+
+    n = file->samples_per_block;
+    if (n > wav->frames - first) {
+        n = wav->frames - first;
+    }
+    n--; // the initial predictor
+
+    if (wav->channels == 2) {
+        int padded = (n + 7) & ~7;
+
+        for (c = 0; c < 2; c++) {
+            block[c*4+0] = wav_sample_u8(wav->samples[first*2+c]);
+            block[c*4+1] = 0;
+            block[c*4+2] = sb_encode_channel(job, file, first, n, padded, c, codes[c], sqerr);
+            block[c*4+3] = 0;
+        }
+
+        for (i = 0; i < padded; i += 2) {
+            uint8_t *group = block + 8 + (i & ~7) + ((i & 7) >> 1);
+            group[0] = codes[0][i] | (codes[0][i+1] << 4);
+            group[4] = codes[1][i] | (codes[1][i+1] << 4);
+        }
+    } else {
+        int per_byte = job->bits == 4 ? 2 : job->bits == 3 ? 3 : 4;
+        int padded = (n + per_byte - 1) / per_byte * per_byte;
+
+        block[0] = wav_sample_u8(wav->samples[first]);
+        block[1] = 0;
+        block[2] = sb_encode_channel(job, file, first, n, padded, 0, codes[0], sqerr);
+
+        for (i = 0; i < padded; i += per_byte) {
+            uint8_t byte = 0;
+            if (job->bits == 4) {
+                byte = codes[0][i] | (codes[0][i+1] << 4);
+            } else if (job->bits == 3) {
+                byte = codes[0][i] | (codes[0][i+1] << 3) | (codes[0][i+2] << 6);
+            } else {
+                byte = codes[0][i] | (codes[0][i+1] << 2) | (codes[0][i+2] << 4) | (codes[0][i+3] << 6);
+            }
+            block[3 + i / per_byte] = byte;
+        }
+    }
+}
+
+static void *sb_worker(void *arg)
+{
+    sb_job_t *job = arg;
+
+    for (;;) {
+        sb_file_t *file;
+        uint32_t b;
+        uint64_t sqerr = 0;
+
+        pthread_mutex_lock(&job->lock);
+        while (job->next_file < job->num_files
+            && job->next_block >= job->files[job->next_file].num_blocks) {
+            job->next_file++;
+            job->next_block = 0;
+        }
+        if (job->next_file >= job->num_files) {
+            pthread_mutex_unlock(&job->lock);
+            return NULL;
+        }
+        file = &job->files[job->next_file];
+        b = job->next_block++;
+        pthread_mutex_unlock(&job->lock);
+
+        sb_encode_block(job, file, b, &sqerr);
+
+        pthread_mutex_lock(&job->lock);
+        file->sqerr += sqerr;
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+// sizes the output of a file, the last block may be shorter than the rest
+static int sb_prepare_file(sb_job_t *job, sb_file_t *file)
+{
+    wav_t *wav = &file->wav;
+    uint32_t last;
+
+    if (wav_read(file->in_path, wav) < 0) {
+        return -1;
+    }
+    if (wav->channels != 1 && (job->bits != 4 || wav->channels != 2)) {
+        fprintf(stderr, "%s: only mono files are supported by SB3 and SB2\n", file->in_path);
+        return -1;
+    }
+
+    if (wav->channels == 2) {
+        if (job->block_size < 16 || job->block_size % 8) {
+            fprintf(stderr, "%s: block size for stereo files must be a multiple of 8, at least 16\n", file->in_path);
+            return -1;
+        }
+        file->samples_per_block = 1 + (job->block_size - 8);
+    } else {
+        file->samples_per_block = 1 + (job->block_size - 3) * (job->bits == 4 ? 2 : job->bits == 3 ? 3 : 4);
+    }
+
+    file->num_blocks = (wav->frames + file->samples_per_block - 1) / file->samples_per_block;
+    file->len = 0;
+    if (file->num_blocks > 0) {
+        int per_byte = job->bits == 4 ? 2 : job->bits == 3 ? 3 : 4;
+
+        last = wav->frames - (file->num_blocks - 1) * file->samples_per_block - 1;
+        if (wav->channels == 2) {
+            last = 8 + (last + 7) / 8 * 8;
+        } else {
+            last = 3 + (last + per_byte - 1) / per_byte;
+        }
+        file->len = (file->num_blocks - 1) * job->block_size + last;
+    }
+
+    file->out = calloc(file->num_blocks + 1, job->block_size);
+    file->sqerr = 0;
+    return 0;
+}
+
+static int sb_write_file(sb_job_t *job, sb_file_t *file)
+{
+    const wav_t *wav = &file->wav;
+    FILE *f;
+    uint32_t n;
+
+    f = fopen(file->out_path, "wb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open for writing\n", file->out_path);
+        return -1;
+    }
+    wav_write_adpcm_header(f, WAV_FORMAT_SB4_ADPCM, wav->channels, wav->rate, job->bits,
+        job->block_size, file->samples_per_block, file->len);
+    fwrite(file->out, 1, file->len, f);
+    if (file->len & 1) {
+        fputc(0, f);
+    }
+    fclose(f);
+
+    n = wav->frames * wav->channels;
+    printf("%s: %u samples, %u bytes, rms error %.2f (8-bit units)\n", file->out_path,
+        n, file->len, n ? sqrt((double)file->sqerr / n) : 0.0);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    sb_job_t job;
+    pthread_t threads[MAX_THREADS];
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int argi = 1, i, ret = 0;
+
+    memset(&job, 0, sizeof(job));
+    job.block_size = DEFAULT_BLOCK_SIZE;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (!strcmp(argv[argi], "-4")) {
+            job.bits = 4;
+        } else if (!strcmp(argv[argi], "-3")) {
+            job.bits = 3;
+        } else if (!strcmp(argv[argi], "-2")) {
+            job.bits = 2;
+        } else if (!strcmp(argv[argi], "-t")) {
+            job.trellis = 1;
+        } else if (!strcmp(argv[argi], "-j") && argi + 1 < argc) {
+            num_threads = atoi(argv[++argi]);
+        } else if (!strcmp(argv[argi], "-b") && argi + 1 < argc) {
+            job.block_size = atoi(argv[++argi]);
+        } else {
+            break;
+        }
+        argi++;
+    }
+    if (!job.bits || argc - argi < 2 || (argc - argi) & 1) {
+        fprintf(stderr, "usage: %s -4|-3|-2 [-t] [-j threads] [-b block_size] "
+            "input.wav output.wav [input2.wav output2.wav ...]\n", argv[0]);
+        return 1;
+    }
+    if (job.block_size < 4 || job.block_size > 8192) {
+        fprintf(stderr, "block size must be in [4, 8192]\n");
+        return 1;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+
+    job.num_files = (argc - argi) / 2;
+    job.files = calloc(job.num_files, sizeof(sb_file_t));
+    for (i = 0; i < job.num_files; i++) {
+        job.files[i].in_path = argv[argi + i*2];
+        job.files[i].out_path = argv[argi + i*2 + 1];
+        if (sb_prepare_file(&job, &job.files[i]) < 0) {
+            return 1;
+        }
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    for (i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, sb_worker, &job);
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+
+    for (i = 0; i < job.num_files; i++) {
+        if (sb_write_file(&job, &job.files[i]) < 0) {
+            ret = 1;
+        }
+        free(job.files[i].out);
+        wav_free(&job.files[i].wav);
+    }
+    free(job.files);
+    return ret;
+}
@@ -0,0 +1,419 @@
+// Packs the WAV files listed in a manifest into a single ROM-ready blob of buffers,
+// which the driver uses as is, without parsing WAV headers on the SegaCD
+//
+// usage: scdpack [-j threads] [-p prefix] manifest.txt output.bin output.h
+//
+// each line of the manifest holds a name and the path to a WAV file, relative to the
+// manifest, empty lines and lines starting with '#' are skipped:
+//
+// EXPLOSION sfx/explosion.wav
+//
+// every buffer starts with the header described in cd/s_buffers.h and is padded to
+// a multiple of 4 bytes, PCM is converted to sign/magnitude 8-bit samples, ADPCM data
+// is stored as is
+//
+// the generated header defines, for every entry, its buffer id (starting at 1, in the
+// order of the manifest) and the offset and length of the buffer in the blob:
+//
+// scd_upload_buf(SND_EXPLOSION, &sounds_bin + SND_EXPLOSION_OFFSET, SND_EXPLOSION_LEN);
+//
+// converted buffers are cached next to the blob and only rebuilt when their WAV changes,
+// the outputs are only written when their contents change
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "wav.h"
+#include "pcm.h"
+#include "s_buffers.h"
+
+#define MAX_THREADS 64
+#define MAX_LINE 1024
+#define MAX_PATH (MAX_LINE * 2 + 64)
+#define ENTRY_ALIGN 4
+
+typedef struct
+{
+    char name[MAX_LINE];
+    char path[MAX_PATH];
+    char cache_path[MAX_PATH];
+    uint8_t *data; // the converted buffer, header included
+    uint32_t len;
+    int failed;
+} pack_entry_t;
+
+typedef struct
+{
+    pack_entry_t *entries;
+    int num_entries;
+    pthread_mutex_t lock;
+    int next;
+} pack_job_t;
+
+static void put_be16(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    put_be16(p, v >> 16);
+    put_be16(p + 2, v);
+}
+
+static int read_file(const char *path, uint8_t **data, uint32_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    long size;
+
+    if (!f) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    *data = malloc(size + 1);
+    if (fread(*data, 1, size, f) != (size_t)size) {
+        fclose(f);
+        free(*data);
+        return -1;
+    }
+    fclose(f);
+    *len = size;
+    return 0;
+}
+
+static int write_file(const char *path, const uint8_t *data, uint32_t len)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (!f) {
+        fprintf(stderr, "%s: can't open for writing\n", path);
+        return -1;
+    }
+    fwrite(data, 1, len, f);
+    fclose(f);
+    return 0;
+}
+
+// keeps the timestamp of unchanged outputs, so that the dependent files aren't rebuilt
+static int update_file(const char *path, const uint8_t *data, uint32_t len)
+{
+    uint8_t *old;
+    uint32_t old_len;
+
+    if (!read_file(path, &old, &old_len)) {
+        int same = old_len == len && !memcmp(old, data, len);
+        free(old);
+        if (same) {
+            return 0;
+        }
+    }
+    return write_file(path, data, len);
+}
+
+static int is_newer(const char *path, const char *than)
+{
+    struct stat a, b;
+
+    if (stat(path, &a) || stat(than, &b)) {
+        return 0;
+    }
+    return a.st_mtime > b.st_mtime;
+}
+
+// maps the WAV format to the driver's format and codec
+static int pack_codec(const wav_raw_t *raw, const char *path, int *format, int *codec)
+{
+    *format = S_FORMAT_WAV_ADPCM;
+
+    switch (raw->format) {
+        case WAV_FORMAT_PCM:
+            *format = S_FORMAT_RAW_SM;
+            *codec = ADPCM_CODEC_NONE;
+            return 0;
+        case WAV_FORMAT_IMA_ADPCM:
+            *codec = ADPCM_CODEC_IMA;
+            return 0;
+        case WAV_FORMAT_SB4_ADPCM:
+            *codec = raw->bits == 3 ? ADPCM_CODEC_SB3 : raw->bits == 2 ? ADPCM_CODEC_SB2 : ADPCM_CODEC_SB4;
+            if (*codec != ADPCM_CODEC_SB4 && raw->channels != 1) {
+                break;
+            }
+            return 0;
+        case WAV_FORMAT_IMA_LITE:
+            *codec = ADPCM_CODEC_IML;
+            return 0;
+        case WAV_FORMAT_DP4:
+            *codec = ADPCM_CODEC_DP4;
+            if (raw->channels != 1) {
+                break;
+            }
+            return 0;
+    }
+
+    fprintf(stderr, "%s: unsupported format 0x%04x with %d channels\n", path, raw->format, raw->channels);
+    return -1;
+}
+
+static int pack_convert(pack_entry_t *e)
+{
+    wav_raw_t raw;
+    wav_t wav;
+    uint32_t payload, i;
+    int format, codec;
+    uint8_t *p;
+
+    if (wav_read_raw(e->path, &raw) < 0) {
+        return -1;
+    }
+    if (pack_codec(&raw, e->path, &format, &codec) < 0) {
+        wav_raw_free(&raw);
+        return -1;
+    }
+    if (raw.channels < 1 || raw.channels > 2 || raw.rate < 1 || raw.rate > 65535) {
+        fprintf(stderr, "%s: only mono or stereo files of up to 65535Hz are supported\n", e->path);
+        wav_raw_free(&raw);
+        return -1;
+    }
+
+    if (format == S_FORMAT_RAW_SM) {
+        wav_raw_free(&raw);
+        if (wav_read(e->path, &wav) < 0) {
+            return -1;
+        }
+        payload = wav.frames * wav.channels;
+    } else {
+        payload = raw.data_len;
+    }
+
+    e->len = (S_BUF_HEADER_SIZE + payload + ENTRY_ALIGN - 1) & ~(ENTRY_ALIGN - 1);
+    e->data = calloc(1, e->len);
+
+    p = e->data;
+    memcpy(p, "SCDB", 4);
+    p[4] = format;
+    p[5] = codec;
+    p[6] = raw.channels;
+    p[7] = 0;
+    put_be16(p + 8, raw.rate);
+    put_be16(p + 10, format == S_FORMAT_RAW_SM ? 0 : raw.block_align);
+    put_be32(p + 12, payload);
+    p += S_BUF_HEADER_SIZE;
+
+    if (format == S_FORMAT_RAW_SM) {
+        // the same conversion as that of pcm_u8_to_sm_lut
+        for (i = 0; i < payload; i++) {
+            int s = wav_sample_u8(wav.samples[i]) - 128;
+            s *= PCM_U8_AMPLIFICATION;
+            p[i] = pcm_s8_to_sm(s);
+        }
+        wav_free(&wav);
+    } else {
+        memcpy(p, raw.data, payload);
+        wav_raw_free(&raw);
+    }
+
+    return 0;
+}
+
+static void *pack_worker(void *arg)
+{
+    pack_job_t *job = arg;
+
+    for (;;) {
+        pack_entry_t *e;
+
+        pthread_mutex_lock(&job->lock);
+        if (job->next >= job->num_entries) {
+            pthread_mutex_unlock(&job->lock);
+            return NULL;
+        }
+        e = &job->entries[job->next++];
+        pthread_mutex_unlock(&job->lock);
+
+        if (is_newer(e->cache_path, e->path) && !read_file(e->cache_path, &e->data, &e->len)) {
+            continue;
+        }
+
+        if (pack_convert(e) < 0) {
+            e->failed = 1;
+            continue;
+        }
+        write_file(e->cache_path, e->data, e->len);
+        printf("%s: %s, %u bytes\n", e->name, e->path, e->len);
+    }
+}
+
+// 32-bit FNV-1a, tells the cached buffers of the same name apart
+static uint32_t hash_path(const char *s)
+{
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    }
+    return h;
+}
+
+static int read_manifest(const char *path, const char *cache_dir, pack_job_t *job)
+{
+    FILE *f = fopen(path, "r");
+    char line[MAX_LINE], dir[MAX_LINE];
+    const char *slash = strrchr(path, '/');
+    int lineno = 0;
+
+    if (!f) {
+        fprintf(stderr, "%s: can't open\n", path);
+        return -1;
+    }
+
+    snprintf(dir, sizeof(dir), "%.*s", slash ? (int)(slash - path + 1) : 0, path);
+
+    while (fgets(line, sizeof(line), f)) {
+        char name[MAX_LINE], file[MAX_LINE];
+        pack_entry_t *e;
+        int i;
+
+        lineno++;
+        if (sscanf(line, "%s %s", name, file) != 2 || name[0] == '#') {
+            if (sscanf(line, "%s", name) == 1 && name[0] != '#') {
+                fprintf(stderr, "%s:%d: expected a name and a path\n", path, lineno);
+                fclose(f);
+                return -1;
+            }
+            continue;
+        }
+        for (i = 0; name[i]; i++) {
+            if (!isalnum((unsigned char)name[i]) && name[i] != '_') {
+                fprintf(stderr, "%s:%d: names may only contain letters, digits and underscores\n", path, lineno);
+                fclose(f);
+                return -1;
+            }
+        }
+
+        job->entries = realloc(job->entries, (job->num_entries + 1) * sizeof(pack_entry_t));
+        e = &job->entries[job->num_entries++];
+        memset(e, 0, sizeof(*e));
+        snprintf(e->name, sizeof(e->name), "%s", name);
+        if (file[0] == '/') {
+            snprintf(e->path, sizeof(e->path), "%s", file);
+        } else {
+            snprintf(e->path, sizeof(e->path), "%s%s", dir, file);
+        }
+        snprintf(e->cache_path, sizeof(e->cache_path), "%s/%s-%08x.scdb", cache_dir, name, hash_path(e->path));
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// an include guard from the name of the header
+static void guard_name(const char *path, char *guard, int size)
+{
+    const char *base = strrchr(path, '/');
+    int i = 0;
+
+    base = base ? base + 1 : path;
+    guard[i++] = '_';
+    for (; *base && i < size - 1; base++) {
+        guard[i++] = isalnum((unsigned char)*base) ? toupper((unsigned char)*base) : '_';
+    }
+    guard[i] = 0;
+}
+
+int main(int argc, char **argv)
+{
+    pack_job_t job;
+    pthread_t threads[MAX_THREADS];
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *prefix = "SND_";
+    char cache_dir[MAX_LINE], guard[MAX_LINE];
+    uint8_t *blob = NULL;
+    char *header = NULL;
+    size_t header_len = 0;
+    FILE *hf;
+    uint32_t blob_len = 0;
+    int argi = 1, i, ret = 0;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (!strcmp(argv[argi], "-j") && argi + 1 < argc) {
+            num_threads = atoi(argv[++argi]);
+        } else if (!strcmp(argv[argi], "-p") && argi + 1 < argc) {
+            prefix = argv[++argi];
+        } else {
+            break;
+        }
+        argi++;
+    }
+    if (argc - argi != 3) {
+        fprintf(stderr, "usage: %s [-j threads] [-p prefix] manifest.txt output.bin output.h\n", argv[0]);
+        return 1;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+
+    memset(&job, 0, sizeof(job));
+    snprintf(cache_dir, sizeof(cache_dir), "%s.cache", argv[argi + 1]);
+    mkdir(cache_dir, 0777);
+
+    if (read_manifest(argv[argi], cache_dir, &job) < 0) {
+        return 1;
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    for (i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, pack_worker, &job);
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+
+    for (i = 0; i < job.num_entries; i++) {
+        if (job.entries[i].failed) {
+            return 1;
+        }
+    }
+
+    hf = open_memstream(&header, &header_len);
+    guard_name(argv[argi + 2], guard, sizeof(guard));
+    fprintf(hf, "// generated by scdpack from %s, do not edit\n\n", argv[argi]);
+    fprintf(hf, "#ifndef %s\n#define %s\n\n", guard, guard);
+
+    for (i = 0; i < job.num_entries; i++) {
+        pack_entry_t *e = &job.entries[i];
+
+        blob = realloc(blob, blob_len + e->len);
+        memcpy(blob + blob_len, e->data, e->len);
+
+        fprintf(hf, "#define %s%s %d\n", prefix, e->name, i + 1);
+        fprintf(hf, "#define %s%s_OFFSET 0x%08x\n", prefix, e->name, blob_len);
+        fprintf(hf, "#define %s%s_LEN %u\n\n", prefix, e->name, e->len);
+
+        blob_len += e->len;
+        free(e->data);
+    }
+
+    fprintf(hf, "#define %sNUM_BUFFERS %d\n\n", prefix, job.num_entries);
+    fprintf(hf, "#endif\n");
+    fclose(hf);
+
+    if (update_file(argv[argi + 1], blob, blob_len) < 0
+        || update_file(argv[argi + 2], (uint8_t *)header, header_len) < 0) {
+        ret = 1;
+    }
+
+    free(header);
+    free(blob);
+    free(job.entries);
+    return ret;
+}
@@ -0,0 +1,335 @@
+// Renders a script of driver commands to a WAV file, running the SegaCD driver
+// natively against the simulated PCM chip in cd/host.c, much faster than real time
+//
+// usage: scdrender [-u updates] script.txt output.wav
+//
+// each line of the script holds a command and its arguments, the same ones the
+// main CPU passes through scd_pcm.c, empty lines and lines starting with '#' are
+// skipped, paths are relative to the script, numbers can also be given in hex
+// with a 0x prefix:
+//
+// load buf_id path [rate]          upload a file, as scd_upload_buf_rate
+// loadkos buf_id path unpacked_len [rate]
+//                                  upload a Kosinski compressed file, as scd_upload_buf_kos
+// play src_id buf_id freq pan vol autoloop [priority [offset [bus]]]
+// playbuf src_id buf_id             as scd_play_buf
+// bufdefaults buf_id freq pan vol autoloop priority bus
+//                                  as scd_set_buf_defaults
+// update src_id freq pan vol autoloop
+// automate src_id param target duration curve flags
+// pause src_id paused
+// buses mask what vol duck paused  as scd_set_buses
+// seek src_id pos
+// rewind src_id
+// stop src_id
+// stopsrcs mask                    as scd_stop_srcs
+// pausesrcs mask paused            as scd_punpause_srcs
+// module buf_id first_src priority loop
+//                                  play a module converted with modconv, as scd_play_module
+// stopmodule                       as scd_stop_module
+// meminfo                          print the memory pool and the buffers, as scd_get_buf_info
+// trace path                       write a dump of the driver events, as scd_get_trace, for scdtrace
+// clear
+// wait ms                          render ms milliseconds of output
+//
+// the output is 16-bit stereo at the rate of the PCM chip, the driver gets
+// a number of S_Update calls (-u, 32 by default, each of them refills all
+// playing sources) per timer tick, fewer of them model a busier SegaCD
+//
+// the refill counters of the driver are printed at the end, as key=value pairs
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wav.h"
+#include "pcm.h"
+#include "s_main.h"
+#include "s_sources.h"
+#include "s_buffers.h"
+#include "s_trace.h"
+
+#define MAX_LINE 1024
+#define MAX_PATH (MAX_LINE * 2)
+
+typedef struct
+{
+    int16_t *samples;
+    uint32_t frames, size;
+    uint32_t pending; // samples left to render in the current timer tick
+    int updates;
+} render_t;
+
+static const char *upload_errors[] = { "ok", "bad buffer id", "out of memory", "bad data" };
+
+static void print_mem_info(void)
+{
+    static uint8_t dump[sizeof(sfx_mem_stats_t) + S_MAX_BUFFERS * sizeof(sfx_buffer_info_t)];
+    sfx_mem_stats_t *stats = (sfx_mem_stats_t *)dump;
+    sfx_buffer_info_t *info = (sfx_buffer_info_t *)(dump + sizeof(*stats));
+    int i;
+
+    S_GetMemInfo(dump);
+    printf("mem total=%u free=%u largest_free=%u buffers=%u\n",
+        stats->total, stats->free, stats->largest_free, stats->num_buffers);
+    for (i = 0; i < S_MAX_BUFFERS; i++) {
+        if (!info[i].size) {
+            continue;
+        }
+        printf("buf %d size=%u len=%u freq=%u format=%u channels=%u\n", i + 1,
+            info[i].size, info[i].data_len, info[i].freq, info[i].format, info[i].num_channels);
+    }
+}
+
+static uint8_t *read_file(const char *path, uint32_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data;
+    long size;
+
+    if (!f) {
+        fprintf(stderr, "%s: can't open\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(size + 1);
+    if (fread(data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: can't read\n", path);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *len = size;
+    return data;
+}
+
+// runs the driver and the chip for the given number of output samples
+static void render(render_t *r, uint32_t len)
+{
+    while (len > 0) {
+        uint32_t n;
+        int i;
+
+        if (r->pending == 0) {
+            // the driver paints between timer interrupts
+            for (i = 0; i < r->updates; i++) {
+                S_Update();
+            }
+            r->pending = pcm_host_timer_period();
+        }
+
+        n = len < r->pending ? len : r->pending;
+        if (r->frames + n > r->size) {
+            r->size = (r->frames + n) * 2;
+            r->samples = realloc(r->samples, r->size * 2 * sizeof(int16_t));
+        }
+        pcm_host_render(r->samples + r->frames * 2, n);
+        r->frames += n;
+        r->pending -= n;
+        len -= n;
+
+        if (r->pending == 0) {
+            pcm_host_tick();
+        }
+    }
+}
+
+static int run_script(const char *path, render_t *r)
+{
+    FILE *f = fopen(path, "r");
+    char line[MAX_LINE], dir[MAX_LINE];
+    const char *slash = strrchr(path, '/');
+    int lineno = 0;
+    uint64_t ms_total = 0, rendered = 0;
+
+    if (!f) {
+        fprintf(stderr, "%s: can't open\n", path);
+        return -1;
+    }
+
+    snprintf(dir, sizeof(dir), "%.*s", slash ? (int)(slash - path + 1) : 0, path);
+
+    while (fgets(line, sizeof(line), f)) {
+        char cmd[MAX_LINE], file[MAX_LINE], full[MAX_PATH];
+        long a[9];
+        int n;
+
+        lineno++;
+        if (sscanf(line, "%s", cmd) != 1 || cmd[0] == '#') {
+            continue;
+        }
+
+        if (!strcmp(cmd, "trace")) {
+            static uint8_t dump[S_TRACE_DUMP_SIZE];
+            uint32_t len;
+            FILE *out;
+
+            if (sscanf(line, "%*s %s", file) != 1) {
+                fprintf(stderr, "%s:%d: expected a path\n", path, lineno);
+                break;
+            }
+            if (file[0] == '/') {
+                snprintf(full, sizeof(full), "%s", file);
+            } else {
+                snprintf(full, sizeof(full), "%s%s", dir, file);
+            }
+            len = S_Trace_Dump(dump, 1);
+            out = fopen(full, "wb");
+            if (!out || fwrite(dump, 1, len, out) != len) {
+                fprintf(stderr, "%s: can't write\n", full);
+                if (out) {
+                    fclose(out);
+                }
+                break;
+            }
+            fclose(out);
+            continue;
+        }
+
+        if (!strcmp(cmd, "load") || !strcmp(cmd, "loadkos")) {
+            int kos = !strcmp(cmd, "loadkos");
+            uint8_t *data;
+            uint32_t len;
+            uint8_t res;
+
+            a[2] = a[3] = 0;
+            n = sscanf(line, "%*s %li %s %li %li", &a[0], file, &a[2], &a[3]);
+            if (n < (kos ? 3 : 2)) {
+                fprintf(stderr, "%s:%d: expected a buffer id and a path\n", path, lineno);
+                break;
+            }
+            if (file[0] == '/') {
+                snprintf(full, sizeof(full), "%s", file);
+            } else {
+                snprintf(full, sizeof(full), "%s%s", dir, file);
+            }
+            data = read_file(full, &len);
+            if (!data) {
+                break;
+            }
+            // reserved before the command is acknowledged and copied after, as in crt.s
+            if (kos) {
+                res = S_ReserveKosBufferData(a[0], a[2]);
+                if (res == S_UPLOAD_OK) {
+                    res = S_CopyKosBufferData(a[0], data, a[2], a[3]);
+                }
+            } else {
+                res = S_ReserveBufferData(a[0], data, len, a[2]);
+                if (res == S_UPLOAD_OK) {
+                    res = S_CopyBufferData(a[0], data, len, a[2]);
+                }
+            }
+            free(data);
+            if (res != S_UPLOAD_OK) {
+                fprintf(stderr, "%s:%d: upload failed: %s\n", path, lineno, upload_errors[res]);
+            }
+            continue;
+        }
+
+        memset(a, 0, sizeof(a));
+        n = sscanf(line, "%*s %li %li %li %li %li %li %li %li %li",
+            &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &a[6], &a[7], &a[8]);
+
+        if (!strcmp(cmd, "play") && n >= 6) {
+            if (n < 7) {
+                a[6] = S_DEFAULT_PRIORITY;
+            }
+            S_PlaySource(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+        } else if (!strcmp(cmd, "playbuf") && n == 2) {
+            S_PlayBufferSource(a[0], a[1]);
+        } else if (!strcmp(cmd, "bufdefaults") && n == 7) {
+            S_SetBufferDefaults(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+        } else if (!strcmp(cmd, "update") && n == 5) {
+            S_UpdateSource(a[0], a[1], a[2], a[3], a[4]);
+        } else if (!strcmp(cmd, "automate") && n == 6) {
+            S_AutomateSource(a[0], a[1], a[2], a[3], a[4], a[5]);
+        } else if (!strcmp(cmd, "pause") && n == 2) {
+            S_PUnPSource(a[0], a[1]);
+        } else if (!strcmp(cmd, "buses") && n == 5) {
+            S_SetBuses(a[0], a[1], a[2], a[3], a[4]);
+        } else if (!strcmp(cmd, "seek") && n == 2) {
+            S_SeekSource(a[0], a[1]);
+        } else if (!strcmp(cmd, "rewind") && n == 1) {
+            S_RewindSource(a[0]);
+        } else if (!strcmp(cmd, "stop") && n == 1) {
+            S_StopSource(a[0]);
+        } else if (!strcmp(cmd, "stopsrcs") && n == 1) {
+            S_StopSourceSet(a[0]);
+        } else if (!strcmp(cmd, "pausesrcs") && n == 2) {
+            S_PUnPSourceSet(a[0], a[1]);
+        } else if (!strcmp(cmd, "module") && n == 4) {
+            if (!S_PlayModule(a[0], a[1], a[2], a[3])) {
+                fprintf(stderr, "%s:%d: buffer %ld doesn't hold a module\n", path, lineno, a[0]);
+            }
+        } else if (!strcmp(cmd, "stopmodule") && n <= 0) {
+            S_PlayModule(0, 0, 0, 0);
+        } else if (!strcmp(cmd, "meminfo") && n <= 0) {
+            print_mem_info();
+        } else if (!strcmp(cmd, "clear") && n <= 0) {
+            S_Clear();
+        } else if (!strcmp(cmd, "wait") && n == 1) {
+            uint64_t end;
+
+            // keep rounding errors from piling up over many waits
+            ms_total += a[0];
+            end = ms_total * PCM_CLOCK_RATE / 1000;
+            render(r, end - rendered);
+            rendered = end;
+        } else {
+            fprintf(stderr, "%s:%d: bad command or arguments\n", path, lineno);
+            break;
+        }
+    }
+
+    if (!feof(f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    render_t r;
+    FILE *f;
+    int argi = 1;
+
+    memset(&r, 0, sizeof(r));
+    r.updates = S_MAX_SOURCES;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (!strcmp(argv[argi], "-u") && argi + 1 < argc) {
+            r.updates = atoi(argv[++argi]);
+        } else {
+            break;
+        }
+        argi++;
+    }
+    if (argc - argi != 2) {
+        fprintf(stderr, "usage: %s [-u updates] script.txt output.wav\n", argv[0]);
+        return 1;
+    }
+
+    S_Init();
+
+    if (run_script(argv[argi], &r) < 0) {
+        return 1;
+    }
+
+    f = fopen(argv[argi + 1], "wb");
+    if (!f) {
+        fprintf(stderr, "%s: can't create\n", argv[argi + 1]);
+        return 1;
+    }
+    wav_write_pcm16(f, 2, PCM_CLOCK_RATE, r.frames, r.samples);
+    fclose(f);
+
+    printf("frames=%u refills=%u underruns=%u min_slack=%u\n", (unsigned)r.frames,
+        (unsigned)s_load.refills, (unsigned)s_load.underruns, (unsigned)s_load.min_slack);
+
+    free(r.samples);
+    return 0;
+}
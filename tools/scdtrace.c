@@ -0,0 +1,252 @@
+// Converts a dump of the driver events, from scd_get_trace or the trace command
+// of scdrender, to the Chrome trace JSON format, for chrome://tracing or Perfetto
+//
+// usage: scdtrace dump.bin output.json
+//
+// commands, uploads and the timer get a track each, every source gets one of its
+// own with the painting of its blocks, flips, underruns and playback starts and stops,
+// the timestamps only move on timer interrupts, so events between two of them share one
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "s_sources.h"
+#include "s_trace.h"
+
+#define TID_CMDS    0
+#define TID_UPLOADS (S_MAX_SOURCES + 1)
+#define TID_TIMER   (S_MAX_SOURCES + 2)
+#define NUM_TIDS    (S_MAX_SOURCES + 3)
+
+typedef struct
+{
+    FILE *f;
+    uint32_t rate;
+    uint32_t base;
+    int first;
+    int open[ NUM_TIDS ];
+} trace_writer_t;
+
+static uint32_t get_long(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint16_t get_short(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static int source_tid(uint8_t id)
+{
+    return id <= S_MAX_SOURCES ? id : TID_CMDS;
+}
+
+// starts an event object up to its args, which the caller fills in and closes
+static void put_event(trace_writer_t *w, const char *ph, const char *name, int tid, uint32_t clock)
+{
+    double ts = (double)(uint32_t)(clock - w->base) * 1000000.0 / w->rate;
+
+    fprintf(w->f, "%s\n{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.1f",
+        w->first ? "" : ",", ph, name, tid, ts);
+    w->first = 0;
+}
+
+static void put_begin(trace_writer_t *w, const char *name, int tid, uint32_t clock)
+{
+    put_event(w, "B", name, tid, clock);
+    w->open[ tid ] = 1;
+}
+
+// ends the open event on the track, args is NULL or the members of the args object,
+// the ends of the events whose start was overwritten are dropped
+static void put_end(trace_writer_t *w, int tid, uint32_t clock, const char *args)
+{
+    if (!w->open[ tid ]) {
+        return;
+    }
+    put_event(w, "E", "", tid, clock);
+    if (args) {
+        fprintf(w->f, ",\"args\":{%s}", args);
+    }
+    fprintf(w->f, "}");
+    w->open[ tid ] = 0;
+}
+
+static void put_thread_name(trace_writer_t *w, int tid, const char *name)
+{
+    fprintf(w->f, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+        w->first ? "" : ",", tid, name);
+    w->first = 0;
+}
+
+static const char *upload_result(uint8_t res)
+{
+    static const char *results[] = { "ok", "bad buffer id", "out of memory", "bad data" };
+    return res < sizeof(results) / sizeof(results[0]) ? results[res] : "?";
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f;
+    uint8_t *dump;
+    long len;
+    uint16_t version, count;
+    uint32_t now;
+    const uint8_t *ev;
+    trace_writer_t w;
+    int i, n = 0, underruns = 0;
+    char name[64], args[64];
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s dump.bin output.json\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open for reading\n", argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    dump = malloc(len + 1);
+    if (fread(dump, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "%s: read error\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    if (len < S_TRACE_HEADER_SIZE || memcmp(dump, "SCDT", 4)) {
+        fprintf(stderr, "%s: not a trace dump, or the driver was built without TRACE=1\n", argv[1]);
+        return 1;
+    }
+    version = get_short(dump + 4);
+    count = get_short(dump + 6);
+    if (version != S_TRACE_VERSION) {
+        fprintf(stderr, "%s: unsupported version %d\n", argv[1], version);
+        return 1;
+    }
+    if (len < S_TRACE_HEADER_SIZE + (long)count * S_TRACE_EVENT_SIZE) {
+        fprintf(stderr, "%s: truncated\n", argv[1]);
+        return 1;
+    }
+
+    memset(&w, 0, sizeof(w));
+    w.rate = get_long(dump + 8);
+    now = get_long(dump + 12);
+    w.first = 1;
+    if (!w.rate) {
+        fprintf(stderr, "%s: bad clock rate\n", argv[1]);
+        return 1;
+    }
+
+    // timestamps start from the oldest event
+    w.base = now;
+    ev = dump + S_TRACE_HEADER_SIZE;
+    for (i = 0; i < count; i++, ev += S_TRACE_EVENT_SIZE) {
+        if (ev[4] != S_TRACE_NONE) {
+            w.base = get_long(ev);
+            break;
+        }
+    }
+
+    w.f = fopen(argv[2], "w");
+    if (!w.f) {
+        fprintf(stderr, "%s: can't open for writing\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(w.f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    put_thread_name(&w, TID_CMDS, "commands");
+    for (i = 1; i <= S_MAX_SOURCES; i++) {
+        snprintf(name, sizeof(name), "source %d", i);
+        put_thread_name(&w, i, name);
+    }
+    put_thread_name(&w, TID_UPLOADS, "uploads");
+    put_thread_name(&w, TID_TIMER, "timer");
+
+    ev = dump + S_TRACE_HEADER_SIZE;
+    for (i = 0; i < count; i++, ev += S_TRACE_EVENT_SIZE) {
+        uint32_t clock = get_long(ev);
+        uint8_t type = ev[4], id = ev[5];
+        uint16_t val = get_short(ev + 6);
+        int tid = source_tid(id);
+
+        switch (type) {
+            case S_TRACE_NONE:
+                continue;
+            case S_TRACE_CMD:
+                put_end(&w, TID_CMDS, clock, NULL);
+                snprintf(name, sizeof(name), "cmd %c", id >= 0x20 && id < 0x7F ? id : '?');
+                put_begin(&w, name, TID_CMDS, clock);
+                fprintf(w.f, "}");
+                break;
+            case S_TRACE_ACK:
+                snprintf(args, sizeof(args), "\"ack\":\"%c\"", id == 'E' ? 'E' : 'D');
+                put_end(&w, TID_CMDS, clock, args);
+                break;
+            case S_TRACE_PLAY:
+                put_event(&w, "i", "play", tid, clock);
+                fprintf(w.f, ",\"s\":\"t\",\"args\":{\"freq\":%u}}", val);
+                break;
+            case S_TRACE_STOP:
+                put_end(&w, tid, clock, NULL);
+                put_event(&w, "i", "stop", tid, clock);
+                fprintf(w.f, ",\"s\":\"t\"}");
+                break;
+            case S_TRACE_FLIP:
+                put_event(&w, "i", "flip", tid, clock);
+                fprintf(w.f, ",\"s\":\"t\",\"args\":{\"back_buffer\":%u}}", val);
+                break;
+            case S_TRACE_PAINT_BEGIN:
+                put_end(&w, tid, clock, NULL);
+                put_begin(&w, "paint", tid, clock);
+                fprintf(w.f, ",\"args\":{\"samples_left\":%u}}", val);
+                break;
+            case S_TRACE_PAINT_END:
+                snprintf(args, sizeof(args), "\"painted\":%u", val);
+                put_end(&w, tid, clock, args);
+                break;
+            case S_TRACE_UNDERRUN:
+                put_event(&w, "i", "underrun", tid, clock);
+                fprintf(w.f, ",\"s\":\"p\",\"cname\":\"terrible\",\"args\":{\"cause\":\"%s\"}}",
+                    val == S_TRACE_UNDERRUN_STALE ? "stale block replayed" : "block played before it was painted");
+                underruns++;
+                break;
+            case S_TRACE_UPLOAD_BEGIN:
+                put_end(&w, TID_UPLOADS, clock, NULL);
+                snprintf(name, sizeof(name), "upload %u", val);
+                put_begin(&w, name, TID_UPLOADS, clock);
+                fprintf(w.f, ",\"args\":{\"kosinski\":%u}}", id);
+                break;
+            case S_TRACE_UPLOAD_END:
+                snprintf(args, sizeof(args), "\"result\":\"%s\"", upload_result(id));
+                put_end(&w, TID_UPLOADS, clock, args);
+                break;
+            case S_TRACE_TICK:
+                // the gap between the clock moves the main loop saw, wider ones mean it was held up
+                put_event(&w, "C", "clock step (us)", TID_TIMER, clock);
+                fprintf(w.f, ",\"args\":{\"step\":%.0f}}", val * 1000000.0 / w.rate);
+                break;
+            default:
+                fprintf(stderr, "%s: unknown event type %d\n", argv[1], type);
+                continue;
+        }
+        n++;
+    }
+
+    // close whatever was still running at the time of the dump
+    for (i = 0; i < NUM_TIDS; i++) {
+        put_end(&w, i, now, NULL);
+    }
+
+    fprintf(w.f, "\n]}\n");
+    fclose(w.f);
+
+    printf("%d events, %d underruns, %.1f ms\n", n, underruns,
+        (double)(uint32_t)(now - w.base) * 1000.0 / w.rate);
+    return 0;
+}
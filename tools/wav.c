@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+#include "wav.h"
+
+#define LE_SHORT(p) ((p)[0] | ((p)[1] << 8))
+#define LE_LONG(p) ((uint32_t)LE_SHORT(p) | ((uint32_t)LE_SHORT((p)+2) << 16))
+
+static void put_short(FILE *f, int v)
+{
+    fputc(v & 0xFF, f);
+    fputc((v >> 8) & 0xFF, f);
+}
+
+static void put_long(FILE *f, uint32_t v)
+{
+    put_short(f, v & 0xFFFF);
+    put_short(f, v >> 16);
+}
+
+int wav_read_raw(const char *path, wav_raw_t *raw)
+{
+    FILE *f;
+    long size;
+    uint8_t *chunk, *end;
+
+    memset(raw, 0, sizeof(*raw));
+
+    f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: can't open\n", path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    raw->file = malloc(size);
+    if (!raw->file || fread(raw->file, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: read error\n", path);
+        fclose(f);
+        wav_raw_free(raw);
+        return -1;
+    }
+    fclose(f);
+
+    if (size < 12 || memcmp(raw->file, "RIFF", 4) || memcmp(raw->file + 8, "WAVE", 4)) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        wav_raw_free(raw);
+        return -1;
+    }
+
+    // walk the chunks
+    chunk = raw->file + 12;
+    end = raw->file + size;
+    while (chunk + 8 <= end) {
+        uint32_t length = LE_LONG(&chunk[4]);
+        if (length > (uint32_t)(end - chunk - 8)) {
+            length = end - chunk - 8;
+        }
+
+        if (!memcmp(chunk, "fmt ", 4) && length >= 16) {
+            raw->format = LE_SHORT(&chunk[8]);
+            raw->channels = LE_SHORT(&chunk[10]);
+            raw->rate = LE_LONG(&chunk[12]);
+            raw->block_align = LE_SHORT(&chunk[20]);
+            raw->bits = LE_SHORT(&chunk[22]);
+            if (raw->format == WAV_FORMAT_EXTENSIBLE && length >= 40) {
+                raw->format = LE_SHORT(&chunk[32]); // sub-format
+            }
+        } else if (!memcmp(chunk, "data", 4)) {
+            raw->data = chunk + 8;
+            raw->data_len = length;
+        }
+
+        chunk += 8 + length + (length & 1);
+    }
+
+    if (!raw->format || !raw->data) {
+        fprintf(stderr, "%s: no format or data chunk\n", path);
+        wav_raw_free(raw);
+        return -1;
+    }
+    return 0;
+}
+
+void wav_raw_free(wav_raw_t *raw)
+{
+    free(raw->file);
+    raw->file = NULL;
+    raw->data = NULL;
+}
+
+int wav_read(const char *path, wav_t *wav)
+{
+    wav_raw_t raw;
+    uint32_t i, n;
+    int width;
+
+    memset(wav, 0, sizeof(*wav));
+
+    if (wav_read_raw(path, &raw) < 0) {
+        return -1;
+    }
+
+    if (raw.format != WAV_FORMAT_PCM || (raw.bits != 8 && raw.bits != 16 && raw.bits != 24)
+        || raw.channels < 1 || raw.channels > 2) {
+        fprintf(stderr, "%s: only 8, 16 and 24-bit mono or stereo PCM WAV files are supported\n", path);
+        wav_raw_free(&raw);
+        return -1;
+    }
+
+    wav->channels = raw.channels;
+    wav->rate = raw.rate;
+    width = raw.bits >> 3;
+    wav->frames = raw.data_len / (width * wav->channels);
+    n = wav->frames * wav->channels;
+    wav->samples = malloc(n * sizeof(int16_t) + 1);
+    for (i = 0; i < n; i++) {
+        uint8_t *p = raw.data + i * width;
+        switch (width) {
+            case 1:
+                wav->samples[i] = (p[0] - 128) * 256;
+                break;
+            default:
+                // the most significant bytes of a little endian sample
+                wav->samples[i] = (int16_t)((p[width-1] << 8) | p[width-2]);
+                break;
+        }
+    }
+
+    wav_raw_free(&raw);
+    return 0;
+}
+
+void wav_free(wav_t *wav)
+{
+    free(wav->samples);
+    wav->samples = NULL;
+}
+
+void wav_write_adpcm_header(FILE *f, int format, int channels, int rate, int bits,
+    int block_size, int samples_per_block, uint32_t data_len)
+{
+    fwrite("RIFF", 1, 4, f);
+    put_long(f, 4 + 8 + 20 + 8 + data_len + (data_len & 1));
+    fwrite("WAVE", 1, 4, f);
+
+    fwrite("fmt ", 1, 4, f);
+    put_long(f, 20);
+    put_short(f, format);
+    put_short(f, channels);
+    put_long(f, rate);
+    put_long(f, (uint32_t)((uint64_t)rate * block_size / samples_per_block));
+    put_short(f, block_size);
+    put_short(f, bits);
+    put_short(f, 2); // size of the extension
+    put_short(f, samples_per_block);
+
+    fwrite("data", 1, 4, f);
+    put_long(f, data_len);
+}
+
+void wav_write_pcm16(FILE *f, int channels, int rate, uint32_t frames, const int16_t *samples)
+{
+    uint32_t i, data_len = frames * channels * 2;
+
+    fwrite("RIFF", 1, 4, f);
+    put_long(f, 4 + 8 + 16 + 8 + data_len);
+    fwrite("WAVE", 1, 4, f);
+
+    fwrite("fmt ", 1, 4, f);
+    put_long(f, 16);
+    put_short(f, WAV_FORMAT_PCM);
+    put_short(f, channels);
+    put_long(f, rate);
+    put_long(f, rate * channels * 2);
+    put_short(f, channels * 2);
+    put_short(f, 16);
+
+    fwrite("data", 1, 4, f);
+    put_long(f, data_len);
+    for (i = 0; i < frames * channels; i++) {
+        put_short(f, samples[i]);
+    }
+}
+
+void wav_write_pcm8(FILE *f, int channels, int rate, uint32_t frames, const uint8_t *samples)
+{
+    uint32_t data_len = frames * channels;
+
+    fwrite("RIFF", 1, 4, f);
+    put_long(f, 4 + 8 + 16 + 8 + data_len + (data_len & 1));
+    fwrite("WAVE", 1, 4, f);
+
+    fwrite("fmt ", 1, 4, f);
+    put_long(f, 16);
+    put_short(f, WAV_FORMAT_PCM);
+    put_short(f, channels);
+    put_long(f, rate);
+    put_long(f, rate * channels);
+    put_short(f, channels);
+    put_short(f, 8);
+
+    fwrite("data", 1, 4, f);
+    put_long(f, data_len);
+    fwrite(samples, 1, data_len, f);
+    if (data_len & 1) {
+        fputc(0x80, f);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef _WAV_H
+#define _WAV_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define WAV_FORMAT_PCM          0x0001
+#define WAV_FORMAT_IMA_ADPCM    0x0011
+#define WAV_FORMAT_SB4_ADPCM    0x0200
+#define WAV_FORMAT_IMA_LITE     0x5C11 // private to the driver, see cd/adpcm_iml.h
+#define WAV_FORMAT_DP4          0x5C04 // private to the driver, see cd/adpcm_dp4.h
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+
+typedef struct
+{
+    int channels;
+    int rate;
+    uint32_t frames;
+    int16_t *samples; // interleaved
+} wav_t;
+
+// a WAV file of any format, with the data left as is
+typedef struct
+{
+    int format;
+    int channels;
+    int rate;
+    int bits;
+    int block_align;
+    uint8_t *data;
+    uint32_t data_len;
+    uint8_t *file;
+} wav_raw_t;
+
+// reads a WAV file of any format, walking all of its chunks
+// returns 0 on success, otherwise prints the error and returns -1
+int wav_read_raw(const char *path, wav_raw_t *raw);
+
+void wav_raw_free(wav_raw_t *raw);
+
+// reads a PCM WAV file of 8, 16 or 24 bits per sample
+// returns 0 on success, otherwise prints the error and returns -1
+int wav_read(const char *path, wav_t *wav);
+
+void wav_free(wav_t *wav);
+
+// writes the header of an ADPCM WAV file with the given amount of data
+// that is to follow, in the layout the SegaCD driver expects
+// odd amounts of data are to be followed by a padding byte
+void wav_write_adpcm_header(FILE *f, int format, int channels, int rate, int bits,
+    int block_size, int samples_per_block, uint32_t data_len);
+
+// writes a 16-bit PCM WAV file
+void wav_write_pcm16(FILE *f, int channels, int rate, uint32_t frames, const int16_t *samples);
+
+// writes an unsigned 8-bit PCM WAV file
+void wav_write_pcm8(FILE *f, int channels, int rate, uint32_t frames, const uint8_t *samples);
+
+// converts a sample to the unsigned 8-bit range of the driver
+static inline int wav_sample_u8(int16_t s)
+{
+    int v = (s + 32768 + 128) >> 8;
+    return v > 255 ? 255 : v;
+}
+
+#endif